@@ -6,24 +6,46 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <glob.h>
 
 #include "utils.h"
 #include "argparse.h"
 
-using namespace std;
+extern char ** environ;
 
 /* Class Argument: Member functions */
-Argument :: Argument(const string t_argName,
+ARGPARSE_INLINE Argument :: Argument(const std::string t_argName,
 		     const valueType_t t_valType,
-		     const string t_help, 
+		     const std::string t_help, 
 		     const action_t t_action, 
-		     const vector<string> & altOptSwitches, 
-		     const int t_nargs) :
+		     const std::vector<std::string> & altOptSwitches, 
+		     const int t_nargs,
+		     const ValueType * t_customType) :
   argName(t_argName), 
   nargs(t_nargs), 
+  bRemainder(false), 
+  remArgv(0), 
+  remArgc(0), 
   help(t_help), 
+  customType((t_valType == VAL_TYPE_CUSTOM) ? t_customType : 0), 
+  validator(0), 
+  validatorCtx(0), 
+  pathOpts(0), 
+  bAppended(false), 
+  bRawAppend(false), 
   valType(t_valType), 
-  action(t_action)
+  action(t_action), 
+  dupKeyPolicy(DUP_KEY_LAST)
 {
   // cout << "Argument: action = " << action << endl; /* DEBUG */
 
@@ -31,6 +53,9 @@ Argument :: Argument(const string t_argName,
   if ( argName == "-" || argName == "--" )
     throw illegalArgName();
 
+  if ( valType == VAL_TYPE_CUSTOM && customType == 0 )
+    throw valTypeErr();
+
   /* Test if this is an optional argument */
   if ( (argName.size() >= 2 && argName[0] == '-'
 	&& argName.find_first_not_of("-") == 1) 
@@ -55,6 +80,16 @@ Argument :: Argument(const string t_argName,
     throw illegalNArgs();
 
   /* Process nargs */
+  if ( nargs == NARGS_REMAINDER ) {
+    if ( bOpt || !strType() )
+      /* Only string- or path-type positional arguments can take the 
+	 remainder */
+      throw illegalNArgs();
+
+    bRemainder = true;
+    nargs = 1;
+  }
+
   if ( !bOpt && (nargs > 1) )
     /* Positional arguments cannot have >1 argument values */
     throw illegalNArgs();
@@ -62,6 +97,10 @@ Argument :: Argument(const string t_argName,
   if ( nargs <= 0 )
     throw illegalNArgs();
 
+  if ( valType == VAL_TYPE_MAP && nargs != 1 )
+    /* A single token holds all the key=value pairs */
+    throw illegalNArgs();
+
   /* Reserve space for values */
   if ( valType == VAL_TYPE_BOOL )
     v_b.reserve(nargs);
@@ -69,15 +108,17 @@ Argument :: Argument(const string t_argName,
     v_i.reserve(nargs);
   else if ( valType == VAL_TYPE_FLOAT )
     v_f.reserve(nargs);
-    else if ( valType == VAL_TYPE_STRING )
+    else if ( strType() )
     v_s.reserve(nargs);
+  else if ( valType == VAL_TYPE_CUSTOM )
+    v_c.reserve(nargs * customType->size);
 
   /* Process bSet */
   if ( action == STORE_TRUE || action == STORE_FALSE ) {
     bSet = true;
 
     for (int i = 0; i < nargs; i++)
-      v_i.push_back(action == STORE_FALSE);
+      v_b.push_back(action == STORE_FALSE);
   }
   else {
     bSet = false;
@@ -94,44 +135,607 @@ Argument :: Argument(const string t_argName,
 }
 
 /* Default constructor */
-Argument :: Argument() : 
+ARGPARSE_INLINE Argument :: Argument() : 
   bSet(false), 
   argName(""), 
   nargs(1), 
+  bRemainder(false), 
+  remArgv(0), 
+  remArgc(0), 
   bOpt(false), 
-  optSwitches(vector<string>()), 
+  optSwitches(std::vector<std::string>()), 
   help(""), 
+  customType(0), 
+  validator(0), 
+  validatorCtx(0), 
+  pathOpts(0), 
+  bAppended(false), 
+  bRawAppend(false), 
   valType(VAL_TYPE_STRING), 
-  action(DEFAULT_ACTION) {
+  action(DEFAULT_ACTION), 
+  dupKeyPolicy(DUP_KEY_LAST) {
+}
+
+/* Registry of the custom value types, by name */
+ARGPARSE_STATIC std::map<std::string, ValueType> & value_types() {
+  static std::map<std::string, ValueType> types;
+  return types;
+}
+
+ARGPARSE_INLINE
+const ValueType * Argument :: registerValueType(const ValueType & vt) {
+  if ( vt.name == 0 || vt.name[0] == '\0' || vt.size == 0 || 
+       vt.parse == 0 || vt.format == 0 )
+    throw illegalValueTypeErr();
+
+  std::map<std::string, ValueType> & types = value_types();
+  std::map<std::string, ValueType>::iterator it = types.find(vt.name);
+  if ( it != types.end() ) {
+    const ValueType & rt = (*it).second;
+    if ( rt.size != vt.size || rt.parse != vt.parse || 
+	 rt.accept != vt.accept || rt.format != vt.format )
+      throw duplicateValueTypeErr();
+    return &rt;
+  }
+
+  it = types.insert(std::make_pair(std::string(vt.name), vt)).first;
+  /* The name is held by the registry */
+  (*it).second.name = (*it).first.c_str();
+  return &(*it).second;
+}
+
+ARGPARSE_INLINE
+const ValueType * Argument :: findValueType(const std::string & name) {
+  std::map<std::string, ValueType> & types = value_types();
+  std::map<std::string, ValueType>::const_iterator it = types.find(name);
+
+  return (it == types.end()) ? 0 : &(*it).second;
 }
 
 /* Set the acceptance set (acceptSet) */
 /* If nargs > 1 and only one aSet is supplied (as in this case), then 
    copies of aSet will copied into all positions of acceptSet, i.e., 
    all arguments will have the same acceptance set. */
-void Argument :: setAcceptSet(const string aSet) {
+ARGPARSE_INLINE void Argument :: setAcceptSet(const std::string aSet) {
 
   if ( !acceptSet.empty() ) acceptSet.clear();
   acceptSet.reserve(nargs);
   for (int i = 0; i < nargs; ++i)
     acceptSet.push_back(aSet);
+
+  compileAcceptSets();
 }
 
-void Argument :: setAcceptSet(const vector<string> aSets) {
+ARGPARSE_INLINE
+void Argument :: setAcceptSet(const std::vector<std::string> aSets) {
   if ( aSets.size() != static_cast<unsigned int>(nargs) )
     throw unexpectedAcceptSetSizeErr();
 
   if ( !acceptSet.empty() ) acceptSet.clear();
   acceptSet = aSets;
 
+  compileAcceptSets();
+}
+
+/* Load the acceptance set of a string-type argument from a file, 
+   one member per line */
+ARGPARSE_INLINE
+void Argument :: setAcceptSetFromFile(const std::string fileName) {
+  if ( !strType() && valType != VAL_TYPE_MAP )
+    throw valTypeErr();
+
+  size_t n = 0;
+  const char * p = map_file(fileName, n);
+  if ( p == 0 )
+    throw acceptSetFileErr();
+
+  std::string aSet;
+  aSet.reserve(n);
+  size_t b = 0;
+  while ( b < n ) {
+    const char * nl = static_cast<const char *>(memchr(p + b, '\n', n - b));
+    size_t e = (nl == 0) ? n : nl - p;
+    size_t len = e - b;
+    if ( len > 0 && p[b + len - 1] == '\r' )
+      len--;
+
+    if ( len > 0 ) {
+      if ( memchr(p + b, ',', len) != 0 ) {
+	/* Commas separate the members in acceptSet */
+	unmap_file(p, n);
+	throw acceptSetFileErr();
+      }
+
+      if ( !aSet.empty() )
+	aSet += ',';
+      aSet.append(p + b, len);
+    }
+
+    b = e + 1;
+  }
+  unmap_file(p, n);
+
+  setAcceptSet(aSet);
+}
+
+/* Build the hash tables of the members of the acceptance sets of 
+   string values (and map keys), or the DFAs of their "re:" / "glob:" 
+   patterns. Identical sets in several positions are compiled only once. */
+ARGPARSE_INLINE void Argument :: compileAcceptSets() {
+  acceptTables.clear();
+  acceptPatterns.clear();
+  acceptTests.clear();
+
+  if ( valType == VAL_TYPE_INT || valType == VAL_TYPE_FLOAT ) {
+    acceptTests.resize(acceptSet.size());
+    for (unsigned int i = 0; i < acceptSet.size(); ++i) {
+      if ( i > 0 && acceptSet[i] == acceptSet[i - 1] )
+	acceptTests[i] = acceptTests[i - 1];
+      else if ( !compileNumTests(acceptSet[i], acceptTests[i]) )
+	acceptTests[i].clear();
+    }
+    return;
+  }
+
+  if ( !strType() && valType != VAL_TYPE_MAP )
+    return;
+
+  acceptTables.resize(acceptSet.size());
+  for (unsigned int i = 0; i < acceptSet.size(); ++i) {
+    if ( i > 0 && acceptSet[i] == acceptSet[i - 1] ) {
+      acceptTables[i] = acceptTables[i - 1];
+      if ( !acceptPatterns.empty() )
+	acceptPatterns[i] = acceptPatterns[i - 1];
+      continue;
+    }
+
+    const std::string & as = acceptSet[i];
+    const bool bRe = (as.compare(0, 3, "re:") == 0);
+    const bool bGlob = (as.compare(0, 5, "glob:") == 0);
+    if ( !bRe && !bGlob ) {
+      StringSplitter sp(as, ',');
+      const char * t;
+      size_t tl;
+      while ( sp.next(t, tl) )
+	/* A trailing comma adds no empty member */
+	if ( tl > 0 || t < as.data() + as.size() )
+	  acceptTables[i].insert(t, tl, "", 0);
+      continue;
+    }
+
+    /* Pattern tables are only allocated when patterns are used */
+    if ( acceptPatterns.empty() )
+      acceptPatterns.resize(acceptSet.size());
+    try {
+      if ( bRe )
+	acceptPatterns[i].compile_regex(as.substr(3));
+      else
+	acceptPatterns[i].compile_glob(as.substr(5));
+    }
+    catch (Pattern::patternErr) {
+      acceptSet.clear();
+      acceptTables.clear();
+      acceptPatterns.clear();
+      throw acceptPatternErr();
+    }
+  }
+}
+
+
+/* Compile a numeric acceptance set, such as "0,>10<=20,>=100", into 
+   comparisons. The predicates are split in the same way as check_number() 
+   does. Returns false (leaving the set to be checked from the strings) 
+   for anything it cannot interpret. */
+ARGPARSE_INLINE bool Argument :: compileNumTests(const std::string & as, 
+				 std::vector<numTest_t> & tests) const {
+  static const char * ops[] = {"==", "!=", "<=", ">=", "<", ">"};
+  static const numOp_t opCodes[] = {NUM_EQ, NUM_NE, NUM_LE, NUM_GE, 
+				    NUM_LT, NUM_GT};
+  const unsigned int nOps = 6;
+
+  tests.clear();
+  if ( as.empty() )
+    return false;
+
+  StringSplitter sp(as, ',');
+  const char * mp;
+  size_t ml;
+  while ( sp.next(mp, ml) ) {
+    if ( ml == 0 )
+      return false;
+    const std::string member(mp, ml);
+
+    numTest_t t;
+    t.bEnd = false;
+    if ( is_string_numeric(member) ) {
+      t.op = NUM_IS;
+      t.val = (valType == VAL_TYPE_INT) ? atoi(member.c_str()) 
+	: atof(member.c_str());
+      tests.push_back(t);
+    }
+    else {
+      std::string cs = member;
+      while ( !cs.empty() ) {
+	int opn = -1;
+	size_t bi = 0;
+	for (unsigned int k = 0; k < nOps; ++k) {
+	  const size_t ol = strlen(ops[k]);
+	  if ( cs.size() > ol && cs.compare(0, ol, ops[k]) == 0 ) {
+	    opn = k;
+	    bi = ol;
+	    break;
+	  }
+	}
+	if ( opn == -1 )
+	  return false;
+
+	const std::string subcs = cs.substr(bi);
+	size_t ci = std::string::npos;
+	for (unsigned int k = 0; k < nOps; ++k) {
+	  ci = subcs.find(ops[k]);
+	  if ( ci != std::string::npos )
+	    break;
+	}
+
+	const std::string ps = (ci == std::string::npos) ? cs : cs.substr(0, bi + ci);
+	const std::string ns = ps.substr(bi);
+	if ( !is_string_numeric(ns) )
+	  return false;
+
+	t.op = opCodes[opn];
+	t.val = atof(ns.c_str());
+	tests.push_back(t);
+
+	cs = cs.substr(ps.size());
+      }
+    }
+    tests.back().bEnd = true;
+  }
+
+  return true;
+}
+
+/* Test a number against compiled tests: true if all comparisons of any 
+   member pass */
+template<class NT> 
+bool Argument :: numTestsPass(const std::vector<numTest_t> & tests, 
+			      const NT n) {
+  bool bPass = true;
+  for (size_t k = 0; k < tests.size(); ++k) {
+    const numTest_t & t = tests[k];
+    if ( bPass ) {
+      const NT v = static_cast<NT>(t.val);
+      switch (t.op) {
+      case NUM_EQ: bPass = (n == v); break;
+      case NUM_NE: bPass = (n != v); break;
+      case NUM_LE: bPass = (n <= v); break;
+      case NUM_GE: bPass = (n >= v); break;
+      case NUM_LT: bPass = (n < v); break;
+      case NUM_GT: bPass = (n > v); break;
+      case NUM_IS: bPass = (static_cast<double>(n) == t.val); break;
+      }
+    }
+
+    if ( t.bEnd ) {
+      if ( bPass )
+	return true;
+      bPass = true;
+    }
+  }
+
+  return false;
+}
+
+/* Set the handling of repeated keys in VAL_TYPE_MAP values */
+ARGPARSE_INLINE void Argument :: setDupKeyPolicy(const dupKeyPolicy_t policy) {
+  if ( valType != VAL_TYPE_MAP )
+    throw valTypeErr();
+
+  dupKeyPolicy = policy;
+}
+
+/* Set the environment variable from which the value is taken when the 
+   argument is absent from argv */
+ARGPARSE_INLINE void Argument :: setEnvVar(const std::string t_envVar) {
+  if ( t_envVar.find('=') != std::string::npos )
+    throw illegalArgName();
+
+  envVar = t_envVar;
+}
+
+/* Message of an errno value. Validators run concurrently, and strerror()
+   may share a static buffer across threads, so the GNU strerror_r() 
+   (g++ defines _GNU_SOURCE) is used: it returns the message, in buf or 
+   in static storage. */
+ARGPARSE_STATIC std::string errno_string(const int err) {
+  char buf[256];
+  return strerror_r(err, buf, sizeof(buf));
+}
+
+ARGPARSE_INLINE void Argument :: setValidator(argValidator_t v, void * ctx) {
+  validator = v;
+  validatorCtx = ctx;
+}
+
+ARGPARSE_INLINE
+bool Argument :: validateVal(const unsigned int i, std::string & msg) const {
+  char buf[256];
+  const char * val = getValText(i, buf, sizeof(buf));
+
+  if ( (pathOpts & (PATH_EXISTS | PATH_FILE | PATH_DIR)) != 0 ) {
+    struct stat st;
+    if ( stat(val, &st) != 0 ) {
+      msg = errno_string(errno);
+      return false;
+    }
+    if ( (pathOpts & PATH_FILE) && !S_ISREG(st.st_mode) ) {
+      msg = "Not a regular file";
+      return false;
+    }
+    if ( (pathOpts & PATH_DIR) && !S_ISDIR(st.st_mode) ) {
+      msg = "Not a directory";
+      return false;
+    }
+  }
+
+  if ( validator == 0 )
+    return true;
+
+  try {
+    return validator(val, msg, validatorCtx);
+  }
+  catch (...) {
+    msg = "exception in validator";
+    return false;
+  }
+}
+
+ARGPARSE_INLINE const char * Argument :: getValText(const unsigned int i, 
+						    char * buf, 
+						    const size_t n) const {
+  buf[0] = '\0';
+  if ( strType() )
+    return (remArgv != 0) ? remArgv[i] : v_s[i].c_str();
+  else if ( valType == VAL_TYPE_BOOL )
+    return v_b[i] ? "true" : "false";
+  else if ( valType == VAL_TYPE_INT )
+    snprintf(buf, n, "%d", v_i[i]);
+  else if ( valType == VAL_TYPE_FLOAT )
+    snprintf(buf, n, "%.9g", v_f[i]);
+  else if ( valType == VAL_TYPE_CUSTOM )
+    buf[customType->format(&v_c[i * customType->size], buf, n - 1)] = '\0';
+  else if ( valType == VAL_TYPE_MAP ) {
+    const char * k;
+    const char * v;
+    size_t kl, vl;
+    v_m.entry(i, k, kl, v, vl);
+    snprintf(buf, n, "%.*s=%.*s", static_cast<int>(kl), k, 
+	     static_cast<int>(vl), v);
+  }
+  return buf;
+}
+
+ARGPARSE_INLINE void Argument :: setPathOptions(const unsigned int opts) {
+  if ( valType != VAL_TYPE_PATH )
+    throw valTypeErr();
+
+  if ( (opts & PATH_GLOB) && (action != APPEND || nargs != 1) )
+    throw illegalActionType();
+
+  pathOpts = opts;
+}
+
+/* A glob(3) call of expandPaths(), with its matches */
+struct globTask_t {
+  std::string pattern;
+  int flags;
+  unsigned int iVal; /* Index of the value */
+  std::vector<std::string> paths;
+};
+
+ARGPARSE_STATIC void glob_task(const size_t k, void * ctx) {
+  globTask_t & t = (*static_cast<std::vector<globTask_t> *>(ctx))[k];
+
+  glob_t g;
+  if ( glob(t.pattern.c_str(), t.flags, 0, &g) == 0 )
+    t.paths.assign(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+  globfree(&g);
+}
+
+/* Escape the wildcards of a path for glob(3) */
+ARGPARSE_STATIC std::string glob_escape(const std::string & path) {
+  std::string e;
+  e.reserve(path.size());
+  for (size_t i = 0; i < path.size(); ++i) {
+    if ( strchr("*?[]\\", path[i]) != 0 )
+      e += '\\';
+    e += path[i];
+  }
+  return e;
+}
+
+ARGPARSE_INLINE 
+void Argument :: expandPaths(const unsigned int nThreads, 
+			     std::vector<std::string> & unmatched,
+			     const unsigned int first) {
+  if ( (pathOpts & PATH_GLOB) == 0 || !bSet )
+    return;
+  convertRaw();
+
+  /* 1st round: the patterns, or, for those with wildcards in more than one
+     component, their leading components up to the first with wildcards 
+     (e.g., /data/2026-0[1-6]), which are matched to directories */
+  std::vector<globTask_t> heads;
+  std::vector<std::string> tails(v_s.size());
+  for (unsigned int i = first; i < v_s.size(); ++i) {
+    const size_t w = v_s[i].find_first_of("*?[");
+    if ( w == std::string::npos )
+      continue;
+
+    globTask_t t;
+    t.iVal = i;
+    t.flags = 0;
+    t.pattern = v_s[i];
+    const size_t sl = v_s[i].find('/', w);
+    if ( sl != std::string::npos && 
+	 v_s[i].find_first_of("*?[", sl) != std::string::npos ) {
+      t.pattern = v_s[i].substr(0, sl);
+      t.flags = GLOB_ONLYDIR;
+      tails[i] = v_s[i].substr(sl);
+    }
+    heads.push_back(t);
+  }
+  if ( heads.empty() )
+    return;
+  parallel_for(heads.size(), glob_task, &heads, nThreads);
+
+  /* 2nd round: the rest of the patterns, directory by directory */
+  std::vector<globTask_t> dirs;
+  for (unsigned int k = 0; k < heads.size(); ++k) {
+    const globTask_t & h = heads[k];
+    if ( h.flags == 0 )
+      continue;
+
+    for (unsigned int j = 0; j < h.paths.size(); ++j) {
+      globTask_t t;
+      t.iVal = h.iVal;
+      t.flags = 0;
+      t.pattern = glob_escape(h.paths[j]) + tails[h.iVal];
+      dirs.push_back(t);
+    }
+  }
+  parallel_for(dirs.size(), glob_task, &dirs, nThreads);
+
+  /* The matches replace the patterns, in order */
+  std::vector<std::string> vals;
+  vals.reserve(v_s.size());
+  unsigned int kh = 0, kd = 0;
+  for (unsigned int i = 0; i < v_s.size(); ++i) {
+    if ( kh >= heads.size() || heads[kh].iVal != i ) {
+      vals.push_back(v_s[i]);
+      continue;
+    }
+
+    const size_t nv0 = vals.size();
+    if ( heads[kh].flags == 0 ) {
+      vals.insert(vals.end(), heads[kh].paths.begin(), heads[kh].paths.end());
+    }
+    else {
+      for ( ; kd < dirs.size() && dirs[kd].iVal == i; ++kd)
+	vals.insert(vals.end(), dirs[kd].paths.begin(), dirs[kd].paths.end());
+    }
+    if ( vals.size() == nv0 )
+      unmatched.push_back(v_s[i]);
+    kh++;
+  }
+  v_s.swap(vals);
+}
+
+/* Stock validators */
+ARGPARSE_INLINE bool Argument :: checkPathExists(const char * val, 
+						 std::string & msg, void *) {
+  struct stat st;
+  if ( stat(val, &st) == 0 )
+    return true;
+
+  msg = errno_string(errno);
+  return false;
+}
+
+ARGPARSE_INLINE bool Argument :: checkDirWritable(const char * val, 
+						  std::string & msg, void *) {
+  struct stat st;
+  if ( stat(val, &st) != 0 ) {
+    msg = errno_string(errno);
+    return false;
+  }
+  if ( !S_ISDIR(st.st_mode) ) {
+    msg = "Not a directory";
+    return false;
+  }
+  if ( access(val, W_OK | X_OK) != 0 ) {
+    msg = errno_string(errno);
+    return false;
+  }
+  return true;
+}
+
+ARGPARSE_INLINE bool Argument :: checkHostResolves(const char * val, 
+						   std::string & msg, void *) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo * res = 0;
+  const int rc = getaddrinfo(val, 0, &hints, &res);
+  if ( rc != 0 ) {
+    msg = gai_strerror(rc);
+    return false;
+  }
+  freeaddrinfo(res);
+  return true;
+}
+
+/* Whether the TCP port can be bound on the wildcard address of family 
+   (AF_INET or AF_INET6, the latter without IPv4-mapped addresses). 
+   Families the system does not support count as free. */
+ARGPARSE_STATIC bool port_bindable(const int family, const unsigned short port,
+				   std::string & msg) {
+  const int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ( fd < 0 ) {
+    if ( errno == EAFNOSUPPORT )
+      return true;
+    msg = errno_string(errno);
+    return false;
+  }
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_storage addr;
+  socklen_t addrLen;
+  memset(&addr, 0, sizeof(addr));
+  if ( family == AF_INET6 ) {
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+    struct sockaddr_in6 & a6 = reinterpret_cast<struct sockaddr_in6 &>(addr);
+    a6.sin6_family = AF_INET6;
+    a6.sin6_addr = in6addr_any;
+    a6.sin6_port = htons(port);
+    addrLen = sizeof(a6);
+  }
+  else {
+    struct sockaddr_in & a4 = reinterpret_cast<struct sockaddr_in &>(addr);
+    a4.sin_family = AF_INET;
+    a4.sin_addr.s_addr = htonl(INADDR_ANY);
+    a4.sin_port = htons(port);
+    addrLen = sizeof(a4);
+  }
+
+  const bool bFree = 
+    (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) == 0);
+  if ( !bFree )
+    msg = errno_string(errno);
+  close(fd);
+  return bFree;
 }
 
+ARGPARSE_INLINE bool Argument :: checkPortFree(const char * val, 
+					       std::string & msg, void *) {
+  char * end;
+  const long port = strtol(val, &end, 10);
+  if ( *val == '\0' || *end != '\0' || port < 0 || port > 65535 ) {
+    msg = "Not a port number";
+    return false;
+  }
 
+  const unsigned short p = static_cast<unsigned short>(port);
+  return port_bindable(AF_INET, p, msg) && port_bindable(AF_INET6, p, msg);
+}
 
 /* Overloaded functions for setting default values.
    Checks on valType will be performed. */
 /* 1. Boolean. For nargs == 1 only. */
-void Argument :: setDefaultVal(const bool b) {
+ARGPARSE_INLINE void Argument :: setDefaultVal(const bool b) {
   if ( nargs != 1 )
     throw setDefaultValFailure();
 
@@ -156,7 +760,7 @@ void Argument :: setDefaultVal(const bool b) {
 }
 
 /* 1. Boolean. For all nargs >= 1 */
-void Argument :: setDefaultVals(const vector<bool> bs) {
+ARGPARSE_INLINE void Argument :: setDefaultVals(const std::vector<bool> bs) {
   if ( !bOpt )
     /* Positional arguments cannot have default values */
     throw setDefaultValFailure();
@@ -180,7 +784,7 @@ void Argument :: setDefaultVals(const vector<bool> bs) {
 }
 
 /* 2. Integer */
-void Argument :: setDefaultVal(const int i) {
+ARGPARSE_INLINE void Argument :: setDefaultVal(const int i) {
   if ( !bOpt )
     throw setDefaultValFailure();
 
@@ -200,7 +804,7 @@ void Argument :: setDefaultVal(const int i) {
 }
 
 /* 2. Integer. For all nargs >= 1 */
-void Argument :: setDefaultVals(const vector<int> is) {
+ARGPARSE_INLINE void Argument :: setDefaultVals(const std::vector<int> is) {
   if ( !bOpt )
     /* Positional arguments cannot have default values */
     throw setDefaultValFailure();
@@ -222,7 +826,7 @@ void Argument :: setDefaultVals(const vector<int> is) {
 }
 
 /* 3. Float */
-void Argument :: setDefaultVal(const float f) {
+ARGPARSE_INLINE void Argument :: setDefaultVal(const float f) {
   if ( !bOpt )
     throw setDefaultValFailure();
 
@@ -242,12 +846,12 @@ void Argument :: setDefaultVal(const float f) {
 
 }
 
-void Argument :: setDefaultVal(const double d) {
+ARGPARSE_INLINE void Argument :: setDefaultVal(const double d) {
   setDefaultVal(static_cast<float>(d));
 }
 
 /* 3. Float. For all nargs >= 1 */
-void Argument :: setDefaultVals(const vector<float> fs) {
+ARGPARSE_INLINE void Argument :: setDefaultVals(const std::vector<float> fs) {
   if ( !bOpt )
     /* Positional arguments cannot have default values */
     throw setDefaultValFailure();
@@ -269,11 +873,29 @@ void Argument :: setDefaultVals(const vector<float> fs) {
 }
 
 /* 4. String */
-void Argument :: setDefaultVal(const std::string s) {
+ARGPARSE_INLINE void Argument :: setDefaultVal(const std::string s) {
   if ( !bOpt )
     throw setDefaultValFailure();
 
-  if ( valType != VAL_TYPE_STRING )
+  if ( valType == VAL_TYPE_MAP ) {
+    /* Map: s holds the default key=value pairs */
+    if ( !dv_s.empty() ) dv_s.clear();
+    dv_s.push_back(s);
+
+    if ( !bSet ) {
+      v_m.clear();
+      addPairs(s);
+      bSet = true;
+    }
+    return;
+  }
+
+  if ( valType == VAL_TYPE_CUSTOM ) {
+    setDefaultVals(std::vector<std::string>(1, s));
+    return;
+  }
+
+  if ( !strType() )
     throw valTypeErr();
 
   if ( !dv_s.empty() ) dv_s.clear();
@@ -289,12 +911,29 @@ void Argument :: setDefaultVal(const std::string s) {
 }
 
 /* 4. String. For all nargs >= 1 */
-void Argument :: setDefaultVals(const vector<string> ss) {
+ARGPARSE_INLINE
+void Argument :: setDefaultVals(const std::vector<std::string> ss) {
   if ( !bOpt )
     /* Positional arguments cannot have default values */
     throw setDefaultValFailure();
 
-  if ( valType != VAL_TYPE_STRING )
+  if ( valType == VAL_TYPE_CUSTOM ) {
+    /* Converted as tokens are */
+    std::vector<char> dvs;
+    for (unsigned int i = 0; i < ss.size(); ++i)
+      pushCustom(dvs, ss[i].data(), ss[i].size());
+    dv_c.swap(dvs);
+
+    if ( !bSet ) {
+      v_c = dv_c;
+      bSet = true;
+
+      if ( !valAccept() ) throw valOutsideAcceptanceSet();
+    }
+    return;
+  }
+
+  if ( !strType() )
     throw valTypeErr();
 
   if ( !dv_s.empty() ) dv_s.clear();
@@ -315,7 +954,7 @@ void Argument :: setDefaultVals(const vector<string> ss) {
 /* Test if the set values are all in the acceptance set.
  Return value: true: all arguments accepted. 
                false: one or more of the arguments are not accepted. */
-bool Argument :: valAccept() const {
+ARGPARSE_INLINE bool Argument :: valAccept() const {
   if ( !bSet )
     return false; /* Undefined behavior */
 
@@ -325,119 +964,257 @@ bool Argument :: valAccept() const {
   if ( acceptSet.size() != static_cast<unsigned int>(nargs) )
     throw unexpectedAcceptSetSizeErr();
 
-  bool bAccept = true;
-  for (int i = 0; i < nargs; ++i) {
-    if ( acceptSet[i].empty() )
-      /* Null acceptance set for this arg position --> Accept all values */
-      continue; 
+  const unsigned int nv = nVals();
+  for (unsigned int i = 0; i < nv; ++i)
+    if ( !elemAccept(i) )
+      return false;
 
-    vector<string> vas = split_string(acceptSet[i], string(","));
-    
-    /* TODO: VAL_TYPE_BOOL */
-    bool bFound = false;
-    for (vector<string>::iterator ivas = vas.begin(); 
-	 ivas != vas.end(); ++ivas) {
-      if ( valType == VAL_TYPE_BOOL ) {
-	bool inSetVal;
-	if ( interpret_bool_string(*ivas) == 0 )
-	  inSetVal = false;
-	else if ( interpret_bool_string(*ivas) == 1 )
-	  inSetVal = true;
-	else
-	  throw valLogicalErr();
+  return true;
+}
+
+/* Test if a string value (or map key) is accepted at position pos, 
+   by the compiled pattern or hash table */
+ARGPARSE_INLINE bool Argument :: strAccept(const unsigned int pos, 
+			   const char * s, const size_t n) const {
+  if ( !acceptPatterns.empty() && !acceptPatterns[pos].empty() )
+    return acceptPatterns[pos].match(s, n);
+
+  return acceptTables[pos].contains(s, n);
+}
+
+/* Members of the acceptance set of a string value at position pos */
+ARGPARSE_INLINE
+std::vector<std::string> 
+Argument :: getAcceptMembers(const unsigned int pos) const {
+  std::vector<std::string> members;
+  if ( !strType() || pos >= acceptTables.size() )
+    return members;
+  if ( !acceptPatterns.empty() && !acceptPatterns[pos].empty() )
+    return members;
+
+  const StringTable & tab = acceptTables[pos];
+  members.reserve(tab.size());
+  for (size_t k = 0; k < tab.size(); ++k)
+    members.push_back(tab.key(k));
+  return members;
+}
+
+/* Test if the i-th value is in the acceptance set of its position. 
+   Under APPEND, value i is at position i % nargs. */
+ARGPARSE_INLINE bool Argument :: elemAccept(const unsigned int i) const {
+  if ( acceptSet.empty() ) /* Null acceptance set --> Accept all values. */
+    return true;
+
+  if ( valType == VAL_TYPE_MAP ) /* Keys are checked in addPairs() */
+    return true;
+
+  const std::string & as = acceptSet[i % nargs];
+  if ( as.empty() )
+    /* Null acceptance set for this arg position --> Accept all values */
+    return true; 
+
+  if ( strType() ) /* Compiled acceptance set */
+    return strAccept(i % nargs, v_s[i].data(), v_s[i].size());
+
+  if ( valType == VAL_TYPE_CUSTOM )
+    return customType->accept == 0 || 
+      customType->accept(&v_c[i * customType->size], as.data(), as.size());
+
+  if ( !acceptTests.empty() && !acceptTests[i % nargs].empty() ) {
+    /* Compiled numeric acceptance set */
+    if ( valType == VAL_TYPE_INT )
+      return numTestsPass(acceptTests[i % nargs], v_i[i]);
+    else
+      return numTestsPass(acceptTests[i % nargs], v_f[i]);
+  }
+
+  /* Members are scanned in place and copied one at a time */
+  StringSplitter sp(as, ',');
+  const char * t;
+  size_t tl;
+  bool bFound = false;
+  while ( sp.next(t, tl) ) {
+    const std::string member(t, tl);
+    if ( valType == VAL_TYPE_BOOL ) {
+      bool inSetVal;
+      if ( interpret_bool_string(member) == 0 )
+	inSetVal = false;
+      else if ( interpret_bool_string(member) == 1 )
+	inSetVal = true;
+      else
+	throw valLogicalErr();
 	    
-	if ( inSetVal == v_b[i] ) {
+      if ( inSetVal == v_b[i] ) {
+	bFound = true;
+	break;
+      }
+    }
+    else if ( valType == VAL_TYPE_INT ) {	
+      //cout << "Set member: " << atoi(member.c_str()) << endl; // DEBUG
+      if ( is_string_numeric(member) ) {
+	if ( atoi(member.c_str()) == v_i[i] ) {
+	  // cout << "Match found: " << endl; // DEBUG
 	  bFound = true;
 	  break;
-	}
+	} 
       }
-      else if ( valType == VAL_TYPE_INT ) {	
-	//cout << "Set member: " << atoi((*ivas).c_str()) << endl; // DEBUG
-	if ( is_string_numeric(*ivas) ) {
-	  if ( atoi((*ivas).c_str()) == v_i[i] ) {
-	    // cout << "Match found: " << endl; // DEBUG
+      else {
+	try {
+	  /* Ranges such as >10<=20,>30<=40 */
+	  if ( check_number<int>(v_i[i], member) ) {
+	    // cout << "Match found: " << member << endl; // DEBUG
 	    bFound = true;
 	    break;
-	  } 
-	}
-	else {
-	  try {
-	    /* Ranges such as >10<=20,>30<=40 */
-	    if ( check_number<int>(v_i[i], *ivas) ) {
-	      // cout << "Match found: " << *ivas << endl; // DEBUG
-	      bFound = true;
-	      break;
-	    }
-	  }
-	  catch (checkNumberErr) {
-	    cerr << "ERROR: Unrecognized predicate string: " << *ivas;
-	    throw valLogicalErr();
 	  }
-	  
 	}
+	catch (checkNumberErr) {
+	  std::cerr << "ERROR: Unrecognized predicate string: " << member;
+	  throw valLogicalErr();
+	}
+	  
+      }
 
+    }
+    else if ( valType == VAL_TYPE_FLOAT ) {
+      if ( is_string_numeric(member) ) {
+	if ( atof(member.c_str()) == v_f[i] ) {
+	  bFound = true;
+	  break;
+	}
       }
-      else if ( valType == VAL_TYPE_FLOAT ) {
-	if ( is_string_numeric(*ivas) ) {
-	  if ( atof((*ivas).c_str()) == v_f[i] ) {
+      else {
+	try {
+	  /* Ranges such as >1.5<=2.5,>-2.5<=-1.5 */
+	  if ( check_number<float>(v_f[i], member) ) {
+	    // cout << "Match found: " << member << endl; //DEBUG
 	    bFound = true;
 	    break;
 	  }
 	}
-	else {
-	  try {
-	    /* Ranges such as >1.5<=2.5,>-2.5<=-1.5 */
-	    if ( check_number<float>(v_f[i], *ivas) ) {
-	      // cout << "Match found: " << *ivas << endl; //DEBUG
-	      bFound = true;
-	      break;
-	    }
-	  }
-	  catch (checkNumberErr) {
-	    cerr << "ERROR: Unrecognized predicate string: " << *ivas;
-	    throw valLogicalErr();
-	  }
-
+	catch (checkNumberErr) {
+	  std::cerr << "ERROR: Unrecognized predicate string: " << member;
+	  throw valLogicalErr();
 	}
 
       }
-      else if ( valType == VAL_TYPE_STRING ) {
-	// cout << "\tvalAccept(): *ivas = " << *ivas << endl; // DEBUG
-	if ( *ivas == v_s[i] ) {
-	  bFound = true;
-	  break;
-	}
+
+    }
+    else if ( strType() ) {
+      // cout << "\telemAccept(): member = " << member << endl; // DEBUG
+      if ( member == v_s[i] ) {
+	bFound = true;
+	break;
       }
-      
     }
+      
+  }
 
-    // if ( valType == VAL_TYPE_STRING ) // DEBUG
-    //   cout << "\tvalAccept(): bFound = " << bFound << endl;
-    
-    if ( !bFound ) {
-      bAccept = false;
-      break;
-    }
-    
+  return bFound;
+}
+
+/* Number of values currently held */
+ARGPARSE_INLINE unsigned int Argument :: nVals() const {
+  if ( valType == VAL_TYPE_BOOL )
+    return v_b.size();
+  else if ( valType == VAL_TYPE_INT )
+    return v_i.size();
+  else if ( valType == VAL_TYPE_FLOAT )
+    return v_f.size();
+  else if ( strType() )
+    return v_s.size();
+  else if ( valType == VAL_TYPE_MAP )
+    return v_m.size();
+  else if ( valType == VAL_TYPE_CUSTOM )
+    return v_c.size() / customType->size;
+  else
+    return 0;
+}
+
+/* Convert a token into a custom value, through the table of the type */
+ARGPARSE_INLINE void Argument :: pushCustom(std::vector<char> & vals, 
+					    const char * s, 
+					    const size_t n) const {
+  const size_t off = vals.size();
+  vals.resize(off + customType->size);
+  if ( !customType->parse(s, n, &vals[off]) ) {
+    vals.resize(off);
+    throw unrecognizedCustomValErr();
   }
+}
 
-  return bAccept;
-  
+/* Convert a string and append it to the values */
+ARGPARSE_INLINE void Argument :: pushVal(const std::string & inStr) {
+  if ( valType == VAL_TYPE_BOOL ) {
+    if ( interpret_bool_string(inStr) == 1 )
+      v_b.push_back(true);
+    else if ( interpret_bool_string(inStr) == 0 )
+      v_b.push_back(false);
+    else
+      throw unrecognizedBooleanValErr();
+
+  }
+  else if ( valType == VAL_TYPE_INT ) {
+    if ( !is_string_numeric(inStr) )
+      throw unrecognizedNumberErr();
+
+    v_i.push_back(atoi(inStr.c_str()));
+  }
+  else if ( valType == VAL_TYPE_FLOAT) {
+    if ( !is_string_numeric(inStr) )
+      throw unrecognizedNumberErr();
+
+    v_f.push_back(atof(inStr.c_str()));
+  }
+  else if ( strType() ) {
+    v_s.push_back(inStr);
+  }
+  else if ( valType == VAL_TYPE_MAP ) {
+    addPairs(inStr);
+  }
+  else if ( valType == VAL_TYPE_CUSTOM ) {
+    pushCustom(v_c, inStr.data(), inStr.size());
+  }
 }
 
+/* Add the key=value pairs in a string such as "a=1,b=2" to the map value. 
+   The pairs are scanned in place; keys and values are copied only into the
+   map. */
+ARGPARSE_INLINE void Argument :: addPairs(const std::string & inStr) {
+  StringSplitter sp(inStr, ',');
+  const char * k;
+  size_t pl;
+  while ( sp.next(k, pl) ) {
+    const char * q = static_cast<const char *>(memchr(k, '=', pl));
+    if ( q == 0 || q == k )
+      throw unrecognizedMapPairErr();
+
+    const size_t kl = q - k;
+
+    if ( !acceptSet.empty() && !acceptSet[0].empty() && 
+	 !strAccept(0, k, kl) )
+      throw valOutsideAcceptanceSet();
+
+    if ( dupKeyPolicy == DUP_KEY_ERROR && v_m.contains(k, kl) )
+      throw duplicateKeyErr();
+
+    v_m.insert(k, kl, q + 1, pl - kl - 1, dupKeyPolicy == DUP_KEY_LAST);
+  }
+}
 
 /* Set argument value, through string. This is applicable to nargs == 1 only */
-void Argument :: setVal(const string inStr) {
+ARGPARSE_INLINE void Argument :: setVal(const std::string & inStr) {
   if ( nargs > 1 )
     /* setVal(string) should be used only for nargs == 1. 
        For nargs > 1, use setVal(vector<string>) (see below) */
     throw setValFailure();
+
+  rawVals.clear(); /* Replaced by the new value */
   
   if ( valType == VAL_TYPE_BOOL ) {
     if ( !v_b.empty() ) v_b.clear();
     if ( interpret_bool_string(inStr) == 1 )
       v_b.push_back(true);
-    else if ( interpret_bool_string(inStr) == 1 )
+    else if ( interpret_bool_string(inStr) == 0 )
       v_b.push_back(false);
     else
       throw unrecognizedBooleanValErr();
@@ -457,10 +1234,20 @@ void Argument :: setVal(const string inStr) {
     if ( !v_f.empty() ) v_f.clear();
     v_f.push_back(atof(inStr.c_str()));
   }
-  else if ( valType == VAL_TYPE_STRING ) {
+  else if ( strType() ) {
     if ( !v_s.empty() ) v_s.clear();
     v_s.push_back(inStr);
   }
+  else if ( valType == VAL_TYPE_MAP ) {
+    v_m.clear();
+    addPairs(inStr);
+  }
+  else if ( valType == VAL_TYPE_CUSTOM ) {
+    std::vector<char> vals;
+    vals.reserve(customType->size);
+    pushCustom(vals, inStr.data(), inStr.size());
+    v_c.swap(vals);
+  }
 
   bSet = true;
 
@@ -479,7 +1266,8 @@ void Argument :: setVal(const string inStr) {
 
 /* Set value, through a vector of strings. This applies to both narg == 1 and 
    narg > 1 */
-void Argument :: setVal(const vector<string> inStrs) {
+ARGPARSE_INLINE
+void Argument :: setVal(const std::vector<std::string> & inStrs) {
   // cout << "\tIn setVal(vector<string>): inStrs.size() = " 
   //      << inStrs.size() << endl; // DEBUG
   
@@ -487,8 +1275,12 @@ void Argument :: setVal(const vector<string> inStrs) {
   if ( inStrs.size() != static_cast<unsigned int>(nargs) )
     throw setValFailure();
 
-  if ( nargs == 1)
+  rawVals.clear(); /* Replaced by the new values */
+
+  if ( nargs == 1 ) {
     setVal(inStrs[0]);
+    return;
+  }
 
   /* Clear arg value */
   if ( valType == VAL_TYPE_BOOL ) {
@@ -500,51 +1292,267 @@ void Argument :: setVal(const vector<string> inStrs) {
   else if ( valType == VAL_TYPE_FLOAT ) {
     if ( !v_f.empty() ) v_f.clear();
   }
-  else if ( valType == VAL_TYPE_STRING ) {
+  else if ( strType() ) {
     if ( !v_s.empty() ) v_s.clear();
   }
+  else if ( valType == VAL_TYPE_CUSTOM ) {
+    v_c.clear();
+  }
 	
   /* Set values */
-  for (unsigned int i = 0; i < inStrs.size(); ++i) {
-    // cout << "\tSetting " << i + 1 << " of " 
-    // 	 << inStrs.size() << " argument values" << endl; // DEBUG
+  for (unsigned int i = 0; i < inStrs.size(); ++i)
+    pushVal(inStrs[i]);
 
-    string inStr = inStrs[i];
+  bSet = true;
 
-    if ( valType == VAL_TYPE_BOOL ) {
-      if ( interpret_bool_string(inStr) == 1 )
-    	v_b.push_back(true);
-      else if ( interpret_bool_string(inStr) == 0 )
-    	v_b.push_back(false);
-      else
-    	throw unrecognizedBooleanValErr();
+  if ( !valAccept() ) throw valOutsideAcceptanceSet();
+}
 
-    }
-    else if ( valType == VAL_TYPE_INT ) {
-      if ( !is_string_numeric(inStr) )
-	throw unrecognizedNumberErr();
-
-      v_i.push_back(atoi(inStr.c_str()));
-    }
-    else if ( valType == VAL_TYPE_FLOAT) {
-      if ( !is_string_numeric(inStr) )
-	throw unrecognizedNumberErr();
+/* Set values, from n C strings (e.g., a span of argv). Unlike the vector 
+   version, this constructs no vector of strings. */
+ARGPARSE_INLINE void Argument :: setVal(char ** inStrs, const int n) {
+  if ( n != nargs )
+    throw setValFailure();
 
-      v_f.push_back(atof(inStr.c_str()));
-    }
-    else if ( valType == VAL_TYPE_STRING ) {
-      v_s.push_back(inStr);
-    }
+  if ( nargs == 1 ) {
+    setVal(std::string(inStrs[0]));
+    return;
   }
 
+  rawVals.clear(); /* Replaced by the new values */
+  v_b.clear();
+  v_i.clear();
+  v_f.clear();
+  v_s.clear();
+  v_m.clear();
+  v_c.clear();
+
+  for (int i = 0; i < n; ++i)
+    pushVal(std::string(inStrs[i]));
+
   bSet = true;
 
   if ( !valAccept() ) throw valOutsideAcceptanceSet();
 }
 
+/* Set the remaining tokens: a span of argv, in O(1) */
+ARGPARSE_INLINE
+void Argument :: setRemainder(char ** t_argv, const int t_argc) {
+  if ( !bRemainder )
+    throw setValFailure();
+
+  remArgv = t_argv;
+  remArgc = t_argc;
+  v_s.clear();
+  bSet = true;
+}
+
+/* Append values, through strings. This applies to APPEND only. 
+   Only the newly appended values are checked against the acceptance set, 
+   so that repeated appending takes linear time overall. */
+ARGPARSE_INLINE void Argument :: appendVal(const std::string & inStr) {
+  if ( action != APPEND )
+    throw illegalActionType();
+
+  if ( nargs != 1 )
+    throw setValFailure();
+
+  convertRaw(); /* Earlier values come first */
+
+  if ( !bAppended ) {
+    /* The first appended value replaces the default values */
+    v_b.clear();
+    v_i.clear();
+    v_f.clear();
+    v_s.clear();
+    v_m.clear();
+    v_c.clear();
+    bAppended = true;
+  }
+
+  pushVal(inStr);
+  bSet = true;
+
+  if ( !elemAccept(nVals() - 1) ) throw valOutsideAcceptanceSet();
+}
+
+ARGPARSE_INLINE
+void Argument :: appendVal(const std::vector<std::string> & inStrs) {
+  if ( action != APPEND )
+    throw illegalActionType();
+
+  if ( inStrs.empty() || inStrs.size() % nargs != 0 )
+    throw setValFailure();
+
+  convertRaw(); /* Earlier values come first */
+
+  if ( !bAppended ) {
+    /* The first appended values replace the default values */
+    v_b.clear();
+    v_i.clear();
+    v_f.clear();
+    v_s.clear();
+    v_m.clear();
+    v_c.clear();
+    bAppended = true;
+  }
+
+  const unsigned int nv0 = nVals();
+  for (unsigned int i = 0; i < inStrs.size(); ++i)
+    pushVal(inStrs[i]);
+
+  bSet = true;
+
+  for (unsigned int i = nv0; i < nVals(); ++i)
+    if ( !elemAccept(i) ) throw valOutsideAcceptanceSet();
+}
+
+ARGPARSE_INLINE void Argument :: appendVal(char ** inStrs, const int n) {
+  if ( action != APPEND )
+    throw illegalActionType();
+
+  if ( n <= 0 || n % nargs != 0 )
+    throw setValFailure();
+
+  convertRaw(); /* Earlier values come first */
+
+  if ( !bAppended ) {
+    /* The first appended values replace the default values */
+    v_b.clear();
+    v_i.clear();
+    v_f.clear();
+    v_s.clear();
+    v_m.clear();
+    v_c.clear();
+    bAppended = true;
+  }
+
+  const unsigned int nv0 = nVals();
+  for (int i = 0; i < n; ++i)
+    pushVal(std::string(inStrs[i]));
+
+  bSet = true;
+
+  for (unsigned int i = nv0; i < nVals(); ++i)
+    if ( !elemAccept(i) ) throw valOutsideAcceptanceSet();
+}
+
+/* Lazy conversion: store the tokens of the values */
+ARGPARSE_INLINE void Argument :: setValRaw(char ** inStrs, const int n) {
+  if ( valType == VAL_TYPE_MAP ) {
+    setVal(inStrs, n);
+    return;
+  }
+
+  if ( n != nargs )
+    throw setValFailure();
+
+  rawVals.assign(inStrs, inStrs + n);
+  bRawAppend = false;
+  bSet = true;
+}
+
+ARGPARSE_INLINE void Argument :: appendValRaw(char ** inStrs, const int n) {
+  if ( valType == VAL_TYPE_MAP ) {
+    appendVal(inStrs, n);
+    return;
+  }
+
+  if ( action != APPEND )
+    throw illegalActionType();
+
+  if ( n <= 0 || n % nargs != 0 )
+    throw setValFailure();
+
+  if ( !bAppended ) {
+    /* The first appended values replace the default values */
+    rawVals.clear();
+    v_b.clear();
+    v_i.clear();
+    v_f.clear();
+    v_s.clear();
+    v_c.clear();
+    bAppended = true;
+  }
+
+  if ( rawVals.empty() )
+    bRawAppend = true;
+  rawVals.insert(rawVals.end(), inStrs, inStrs + n);
+  bSet = true;
+}
+
+/* Convert the stored tokens. On failure, the values converted from them 
+   are dropped and the tokens are kept. */
+ARGPARSE_INLINE void Argument :: convertRawVals() {
+  std::vector<const char *> toks;
+  toks.swap(rawVals);
+
+  if ( !bRawAppend ) {
+    v_b.clear();
+    v_i.clear();
+    v_f.clear();
+    v_s.clear();
+    v_c.clear();
+  }
+
+  const unsigned int nv0 = nVals();
+  try {
+    for (unsigned int i = 0; i < toks.size(); ++i)
+      pushVal(std::string(toks[i]));
+
+    for (unsigned int i = nv0; i < nVals(); ++i)
+      if ( !elemAccept(i) ) throw valOutsideAcceptanceSet();
+  }
+  catch (...) {
+    v_b.resize(std::min<size_t>(v_b.size(), nv0));
+    v_i.resize(std::min<size_t>(v_i.size(), nv0));
+    v_f.resize(std::min<size_t>(v_f.size(), nv0));
+    v_s.resize(std::min<size_t>(v_s.size(), nv0));
+    if ( valType == VAL_TYPE_CUSTOM )
+      v_c.resize(std::min<size_t>(v_c.size(), nv0 * customType->size));
+    rawVals.swap(toks);
+    throw;
+  }
+}
+
+/* Set value(s) from a single string */
+ARGPARSE_INLINE bool Argument :: setValFromString(const std::string & val) {
+  if ( action == STORE_TRUE || action == STORE_FALSE ) {
+    int b = interpret_bool_string(val);
+    if ( b == -1 )
+      throw unrecognizedBooleanValErr();
+	
+    /* A true value means that the switch is given */
+    if ( b == 0 )
+      return false;
+    setVal(action == STORE_TRUE ? "true" : "false");
+  }
+  else if ( nargs == 1 && action != APPEND ) {
+    setVal(val);
+  }
+  else {
+    /* Multiple values are separated by white space */
+    std::vector<std::string> valStrs;
+    const char * p = val.data();
+    const char * w;
+    size_t wl;
+    while ( next_word(p, val.data() + val.size(), w, wl) )
+      valStrs.push_back(std::string(w, wl));
+
+    if ( action == APPEND )
+      appendVal(valStrs);
+    else
+      setVal(valStrs);
+  }
+
+  return true;
+}
+
 /* Get value */
-void * Argument :: getVal() const {
-  if ( nargs > 1 )
+ARGPARSE_INLINE void * Argument :: getVal() const {
+  convertRaw();
+
+  if ( nargs > 1 || action == APPEND || bRemainder )
     /* getVal() is usable only under nargs == 1. 
        For nargs > 1, use _TODO_ */
     throw getValFailure();
@@ -556,8 +1564,10 @@ void * Argument :: getVal() const {
     return (void *) &(v_i[0]);
   else if ( valType == VAL_TYPE_FLOAT )
     return (void *) &(v_f[0]);
-  else if ( valType == VAL_TYPE_STRING )
+  else if ( strType() )
     return (void *) &(v_s[0]);
+  else if ( valType == VAL_TYPE_CUSTOM )
+    return (void *) &(v_c[0]);
   else 
     return 0;
   // else if  ( 
@@ -568,8 +1578,10 @@ void * Argument :: getVal() const {
  These operators are for nargs == 1 only. */
 
 /* Boolean */
-Argument :: operator bool() const {
-  if ( nargs > 1 )
+ARGPARSE_INLINE Argument :: operator bool() const {
+  convertRaw();
+
+  if ( nargs > 1 || action == APPEND )
     throw getValFailure(); /* Should use getBoolVals instead */
 
   if ( !bSet ) throw valNotSetErr();
@@ -581,7 +1593,9 @@ Argument :: operator bool() const {
 }
 
 
-vector<bool> Argument :: getBoolVals() const {
+ARGPARSE_INLINE std::vector<bool> Argument :: getBoolVals() const {
+  convertRaw();
+
   if ( !bSet ) throw valNotSetErr();
 
   if ( valType != VAL_TYPE_BOOL )
@@ -591,8 +1605,10 @@ vector<bool> Argument :: getBoolVals() const {
 }
 
 /* Integer */
-Argument :: operator int() const {
-  if ( nargs > 1 )
+ARGPARSE_INLINE Argument :: operator int() const {
+  convertRaw();
+
+  if ( nargs > 1 || action == APPEND )
     throw getValFailure(); /* Should use operator vector<int> instead */
 
   if ( !bSet ) throw valNotSetErr();
@@ -603,7 +1619,9 @@ Argument :: operator int() const {
   return v_i[0];
 }
 
-vector<int> Argument :: getIntVals() const {
+ARGPARSE_INLINE std::vector<int> Argument :: getIntVals() const {
+  convertRaw();
+
   if ( !bSet ) throw valNotSetErr();
 
   if ( valType != VAL_TYPE_INT )
@@ -613,8 +1631,10 @@ vector<int> Argument :: getIntVals() const {
 }
 
 /* Float */
-Argument :: operator float() const {
-  if ( nargs > 1 )
+ARGPARSE_INLINE Argument :: operator float() const {
+  convertRaw();
+
+  if ( nargs > 1 || action == APPEND )
     throw getValFailure(); /* Should use operator vector<float> instead */
 
   if ( !bSet ) throw valNotSetErr();
@@ -625,7 +1645,9 @@ Argument :: operator float() const {
   return v_f[0];
 }
 
-vector<float> Argument :: getFloatVals() const {
+ARGPARSE_INLINE std::vector<float> Argument :: getFloatVals() const {
+  convertRaw();
+
   if ( !bSet ) throw valNotSetErr();
 
   if ( valType != VAL_TYPE_FLOAT )
@@ -635,110 +1657,659 @@ vector<float> Argument :: getFloatVals() const {
 }
 
 /* String */
-Argument :: operator string() const {
-  if ( nargs > 1 )
+ARGPARSE_INLINE Argument :: operator std::string() const {
+  convertRaw();
+
+  if ( nargs > 1 || action == APPEND || bRemainder )
     throw getValFailure(); /* Should use operator vector<string> instead */
 
   if ( !bSet ) throw valNotSetErr();
 
-  if ( valType != VAL_TYPE_STRING )
+  if ( !strType() )
     throw getValFailure();
 
   return v_s[0];
 }
 
-vector<string> Argument :: getStringVals() const {
+ARGPARSE_INLINE std::vector<std::string> Argument :: getStringVals() const {
+  convertRaw();
+
   if ( !bSet ) throw valNotSetErr();
 
-  if ( valType != VAL_TYPE_STRING )
+  if ( !strType() )
     throw getValFailure();
 
+  if ( remArgv != 0 )
+    return std::vector<std::string>(remArgv, remArgv + remArgc);
+
   return v_s;
 }
 
-/* Argument: generate help string */
-string Argument :: getHelpString(const int cw, 
-				 const int lw, 
-				 const std::string destName) const {
-  const int lPad = 2;
-  const int mPad = 1;
+/* Custom */
+ARGPARSE_INLINE const char * Argument :: customVals(const size_t size, 
+						    unsigned int & nv, 
+						    const bool bScalar) const {
+  convertRaw();
 
-  ostringstream oss;
-  if ( cw <= 0 || lw <= 0 || lw >= cw )
-    throw getHelpStringErr();
+  if ( bScalar && (nargs > 1 || action == APPEND) )
+    throw getValFailure(); /* Should use getCustomVals() instead */
 
-  /* Left padding */
-  for (int i = 0; i < lPad; ++i)
-    oss << " ";
+  if ( !bSet ) throw valNotSetErr();
 
-  if ( !bOpt ) { /* Positional argument */
-    oss << argName << " ";
-   
-    if ( static_cast<int>(argName.size()) + 1 >= lw )
-      oss << "\n";
-    else
-      oss << string(lw - argName.size() - 1 - lPad, ' ');
+  if ( valType != VAL_TYPE_CUSTOM || size != customType->size )
+    throw getValFailure();
+
+  nv = nVals();
+  return v_c.empty() ? 0 : &v_c[0];
+}
+
+/* Remainder */
+ARGPARSE_INLINE int Argument :: getRemainderArgc() const {
+  if ( !bRemainder )
+    throw getValFailure();
+
+  if ( !bSet ) throw valNotSetErr();
+
+  return (remArgv != 0) ? remArgc : v_s.size();
+}
+
+ARGPARSE_INLINE char ** Argument :: getRemainderArgv() const {
+  if ( !bRemainder )
+    throw getValFailure();
+
+  if ( !bSet ) throw valNotSetErr();
+
+  return remArgv;
+}
+
+/* Heap memory usage */
+ARGPARSE_INLINE Argument :: memUsage_t :: memUsage_t() : 
+  names(0), 
+  values(0), 
+  defaults(0), 
+  acceptSets(0), 
+  indices(0), 
+  lists(0) {
+}
+
+ARGPARSE_INLINE size_t Argument :: memUsage_t :: total() const {
+  return names + values + defaults + acceptSets + indices + lists;
+}
+
+ARGPARSE_INLINE Argument :: memUsage_t & 
+Argument :: memUsage_t :: operator+=(const memUsage_t & mu) {
+  names += mu.names;
+  values += mu.values;
+  defaults += mu.defaults;
+  acceptSets += mu.acceptSets;
+  indices += mu.indices;
+  lists += mu.lists;
 
+  return *this;
+}
+
+/* Heap memory used by containers (libstdc++ layouts) */
+template<class T>
+static size_t vector_heap_bytes(const std::vector<T> & v) {
+  return v.capacity() * sizeof(T);
+}
+
+ARGPARSE_STATIC size_t vector_heap_bytes(const std::vector<bool> & v) {
+  const size_t wordBits = 8 * sizeof(unsigned long);
+  return (v.capacity() + wordBits - 1) / wordBits * sizeof(unsigned long);
+}
+
+ARGPARSE_STATIC size_t vector_heap_bytes(const std::vector<std::string> & v) {
+  size_t n = v.capacity() * sizeof(std::string);
+  for (unsigned int i = 0; i < v.size(); ++i)
+    n += string_heap_bytes(v[i]);
+
+  return n;
+}
+
+ARGPARSE_STATIC size_t deque_heap_bytes(const std::deque<std::string> & d) {
+  const size_t nodeBytes = 512; /* Size of the deque buffers */
+  const size_t perNode = nodeBytes / sizeof(std::string);
+  const size_t nNodes = d.size() / perNode + 1;
+  const size_t mapSize = (nNodes + 2 > 8) ? nNodes + 2 : 8;
+
+  size_t n = nNodes * nodeBytes + mapSize * sizeof(void *);
+  for (std::deque<std::string>::const_iterator it = d.begin(); 
+       it != d.end(); ++it)
+    n += string_heap_bytes(*it);
+
+  return n;
+}
+
+/* Red-black tree nodes: colour and three links, followed by the value */
+static const size_t rbNodeHeader = 4 * sizeof(void *);
+
+/* Heap memory used by this argument */
+ARGPARSE_INLINE Argument :: memUsage_t Argument :: getMemUsage() const {
+  memUsage_t mu;
+
+  mu.names = string_heap_bytes(argName) + vector_heap_bytes(optSwitches) 
+    + string_heap_bytes(help) + string_heap_bytes(envVar);
+
+  mu.values = vector_heap_bytes(v_b) + vector_heap_bytes(v_i) 
+    + vector_heap_bytes(v_f) + vector_heap_bytes(v_s) + v_m.memUsage()
+    + vector_heap_bytes(v_c) + rawVals.capacity() * sizeof(const char *);
+
+  mu.defaults = vector_heap_bytes(dv_b) + vector_heap_bytes(dv_i) 
+    + vector_heap_bytes(dv_f) + vector_heap_bytes(dv_s) 
+    + vector_heap_bytes(dv_c);
+
+  mu.acceptSets = vector_heap_bytes(acceptSet) 
+    + acceptTables.capacity() * sizeof(StringTable);
+  for (unsigned int i = 0; i < acceptTables.size(); ++i)
+    mu.acceptSets += acceptTables[i].memUsage();
+  mu.acceptSets += acceptTests.capacity() * sizeof(std::vector<numTest_t>);
+  for (unsigned int i = 0; i < acceptTests.size(); ++i)
+    mu.acceptSets += acceptTests[i].capacity() * sizeof(numTest_t);
+  mu.acceptSets += acceptPatterns.capacity() * sizeof(Pattern);
+  for (unsigned int i = 0; i < acceptPatterns.size(); ++i)
+    mu.acceptSets += acceptPatterns[i].memUsage();
+
+  return mu;
+}
+
+/* Binary serialization of the values: 
+   set-flag, value type, number of values, values */
+ARGPARSE_INLINE void Argument :: packVals(std::string & buf) const {
+  convertRaw();
+
+  pack_uint32(buf, bSet ? 1 : 0);
+  pack_uint32(buf, valType);
+
+  if ( valType == VAL_TYPE_BOOL ) {
+    pack_uint32(buf, v_b.size());
+    for (unsigned int i = 0; i < v_b.size(); ++i)
+      buf += static_cast<char>(v_b[i] ? 1 : 0);
   }
-  else { /* Optional argument */
-    oss << argName;
-    for (int i = 0; i < nargs; ++i) {
-      oss << " " << destName;
-      if ( nargs > 1 )
-	oss << (i + 1);
-    }
-    /* Optional switches */
-    if ( optSwitches.size() > 0 ) {
-      oss << "   (";
-      for (unsigned int i = 0; i < optSwitches.size(); ++i) {
-      	oss << optSwitches[i];
-      	if (i < optSwitches.size() - 1)
-      	  oss << ", ";
-      	else 
-      	  oss << ")";
-      }
+  else if ( valType == VAL_TYPE_INT ) {
+    pack_uint32(buf, v_i.size());
+    for (unsigned int i = 0; i < v_i.size(); ++i)
+      pack_uint32(buf, static_cast<unsigned int>(v_i[i]));
+  }
+  else if ( valType == VAL_TYPE_FLOAT ) {
+    pack_uint32(buf, v_f.size());
+    for (unsigned int i = 0; i < v_f.size(); ++i)
+      pack_float(buf, v_f[i]);
+  }
+  else if ( strType() && remArgv != 0 ) {
+    pack_uint32(buf, remArgc);
+    for (int i = 0; i < remArgc; ++i)
+      pack_string(buf, std::string(remArgv[i]));
+  }
+  else if ( strType() ) {
+    pack_uint32(buf, v_s.size());
+    for (unsigned int i = 0; i < v_s.size(); ++i)
+      pack_string(buf, v_s[i]);
+  }
+  else if ( valType == VAL_TYPE_MAP ) {
+    pack_uint32(buf, v_m.size());
+    for (unsigned int i = 0; i < v_m.size(); ++i) {
+      pack_string(buf, v_m.key(i));
+      pack_string(buf, v_m.value(i));
     }
+  }
+  else if ( valType == VAL_TYPE_CUSTOM ) {
+    /* The objects, as they are in memory */
+    pack_uint32(buf, nVals());
+    buf.append(v_c.begin(), v_c.end());
+  }
+}
 
-    if ( oss.str().size() < static_cast<unsigned int>(lw) - mPad ) {
-      for (unsigned int i = 0; 
-	   i < static_cast<unsigned int>(lw) - mPad - oss.str().size(); ++i)
-	oss << " ";      
+/* Restore the values written by packVals(). The values were converted and 
+   validated when they were originally set, so this is not repeated here.
+   The values are decoded into temporaries, and the argument is changed 
+   only if they are all well-formed (bStore false: not at all). A set 
+   argument must have nargs values (a multiple of nargs under APPEND), 
+   except for maps and the variadic positional argument. */
+ARGPARSE_INLINE
+void Argument :: unpackVals(const char * buf, const size_t n, size_t & pos,
+			    const bool bStore) {
+  bool t_bSet = (unpack_uint32(buf, n, pos) != 0);
+  if ( unpack_uint32(buf, n, pos) != static_cast<unsigned int>(valType) )
+    throw valTypeErr();
+
+  unsigned int nv = unpack_uint32(buf, n, pos);
+  if ( nv > n - pos )
+    throw unpackErr(); /* Every value takes at least one byte */
+
+  if ( t_bSet && valType != VAL_TYPE_MAP && !bRemainder ) {
+    if ( action == APPEND ? (nv % nargs != 0) 
+	 : (nv != static_cast<unsigned int>(nargs)) )
+      throw unpackErr();
+  }
+
+  std::vector<bool> t_b;
+  std::vector<int> t_i;
+  std::vector<float> t_f;
+  std::vector<std::string> t_s;
+  StringTable t_m;
+  std::vector<char> t_c;
+
+  if ( valType == VAL_TYPE_BOOL ) {
+    for (unsigned int i = 0; i < nv; ++i) {
+      if ( pos >= n )
+	throw unpackErr();
+      t_b.push_back(buf[pos++] != 0);
     }
-    else {
-      oss << "\n";
-      for (int i = 0; i < lw; ++i)
-	oss << " ";
-      /* TODO */
+  }
+  else if ( valType == VAL_TYPE_INT ) {
+    for (unsigned int i = 0; i < nv; ++i)
+      t_i.push_back(static_cast<int>(unpack_uint32(buf, n, pos)));
+  }
+  else if ( valType == VAL_TYPE_FLOAT ) {
+    for (unsigned int i = 0; i < nv; ++i)
+      t_f.push_back(unpack_float(buf, n, pos));
+  }
+  else if ( strType() ) {
+    for (unsigned int i = 0; i < nv; ++i)
+      t_s.push_back(unpack_string(buf, n, pos));
+  }
+  else if ( valType == VAL_TYPE_MAP ) {
+    for (unsigned int i = 0; i < nv; ++i) {
+      std::string k = unpack_string(buf, n, pos);
+      t_m.insert(k, unpack_string(buf, n, pos));
     }
   }
+  else if ( valType == VAL_TYPE_CUSTOM ) {
+    if ( nv > (n - pos) / customType->size )
+      throw unpackErr();
+    t_c.assign(buf + pos, buf + pos + nv * customType->size);
+    pos += nv * customType->size;
+  }
 
+  if ( !bStore )
+    return;
 
-  /* Show type and number of arguments */
-  std::ostringstream ossType;
-  ossType << "[";
+  rawVals.clear();
   if ( valType == VAL_TYPE_BOOL )
-    ossType << "Boolean";
+    v_b.swap(t_b);
   else if ( valType == VAL_TYPE_INT )
-    ossType << "integer";
+    v_i.swap(t_i);
   else if ( valType == VAL_TYPE_FLOAT )
-    ossType << "float";
-  else if ( valType == VAL_TYPE_STRING )
-    ossType << "string";
-  
-  if ( nargs > 1 )
-    ossType << " x " << nargs;
-  
-  ossType << "] ";
-
-  /* Show help info */
-  std::string helpStr = ossType.str() + help;
-
-  /* Special case: STORE_TRUE and STORE_FALSE Boolean types */
-  if ( (valType == VAL_TYPE_BOOL) && 
-       ((action == STORE_TRUE) || (action == STORE_FALSE)) ) {
-    helpStr += " (Default: ";
-    helpStr += ((action == STORE_TRUE) ? "FALSE" : "TRUE");
-    helpStr += ")";
+    v_f.swap(t_f);
+  else if ( strType() ) {
+    v_s.swap(t_s);
+    remArgv = 0;
+    remArgc = 0;
+  }
+  else if ( valType == VAL_TYPE_MAP )
+    v_m = t_m;
+  else if ( valType == VAL_TYPE_CUSTOM )
+    v_c.swap(t_c);
+
+  bSet = t_bSet;
+}
+
+/* Text export of the values */
+ARGPARSE_INLINE void Argument :: exportVals(OutputSink & out, 
+					    const bool bJson) const {
+  convertRaw();
+
+  const unsigned int nv = !bSet ? 0 : 
+    (remArgv != 0) ? static_cast<unsigned int>(remArgc) : nVals();
+
+  if ( valType == VAL_TYPE_MAP ) {
+    if ( bJson && !bSet ) {
+      out.put("null", 4);
+      return;
+    }
+    if ( bJson )
+      out.put('{');
+
+    for (unsigned int i = 0; i < nv; ++i) {
+      const char * k;
+      const char * v;
+      size_t kl, vl;
+      v_m.entry(i, k, kl, v, vl);
+
+      if ( i > 0 )
+	out.put(',');
+      if ( bJson ) {
+	out.putJsonString(k, kl);
+	out.put(':');
+	out.putJsonString(v, vl);
+      }
+      else {
+	out.putEscaped(k, kl);
+	out.put('=');
+	out.putEscaped(v, vl);
+      }
+    }
+    if ( bJson )
+      out.put('}');
+    return;
+  }
+
+  const bool bArray = (nargs > 1 || action == APPEND || bRemainder);
+  if ( bJson && nv == 0 && !bArray ) {
+    out.put("null", 4);
+    return;
+  }
+  if ( bJson && bArray )
+    out.put('[');
+
+  for (unsigned int i = 0; i < nv; ++i) {
+    if ( i > 0 )
+      out.put(bJson ? ',' : ' ');
+
+    if ( valType == VAL_TYPE_BOOL ) {
+      if ( v_b[i] )
+	out.put("true", 4);
+      else
+	out.put("false", 5);
+    }
+    else if ( valType == VAL_TYPE_INT ) {
+      out.putInt(v_i[i]);
+    }
+    else if ( valType == VAL_TYPE_FLOAT ) {
+      /* JSON has no literals for non-finite numbers */
+      if ( bJson && (v_f[i] != v_f[i] || v_f[i] - v_f[i] != 0.0f) )
+	out.put("null", 4);
+      else
+	out.putFloat(v_f[i]);
+    }
+    else if ( valType == VAL_TYPE_CUSTOM ) {
+      /* As strings, in the form of the tokens */
+      char t[256];
+      const size_t tl = customType->format(&v_c[i * customType->size], 
+					   t, sizeof(t));
+      if ( bJson )
+	out.putJsonString(t, tl);
+      else
+	out.putEscaped(t, tl);
+    }
+    else {
+      const char * t = (remArgv != 0) ? remArgv[i] : v_s[i].data();
+      const size_t tl = (remArgv != 0) ? strlen(t) : v_s[i].size();
+      if ( bJson )
+	out.putJsonString(t, tl);
+      else
+	out.putEscaped(t, tl);
+    }
+  }
+
+  if ( bJson && bArray )
+    out.put(']');
+}
+
+ARGPARSE_INLINE const char * Argument :: getValTypeName() const {
+  if ( valType == VAL_TYPE_BOOL )
+    return "bool";
+  else if ( valType == VAL_TYPE_INT )
+    return "int";
+  else if ( valType == VAL_TYPE_FLOAT )
+    return "float";
+  else if ( valType == VAL_TYPE_STRING )
+    return "string";
+  else if ( valType == VAL_TYPE_PATH )
+    return "path";
+  else if ( valType == VAL_TYPE_MAP )
+    return "map";
+  else if ( valType == VAL_TYPE_CUSTOM )
+    return customType->name;
+  else
+    return "unknown";
+}
+
+/* Binary serialization of lists of strings */
+ARGPARSE_STATIC
+void pack_strings(std::string & buf, const std::vector<std::string> & ss) {
+  pack_uint32(buf, ss.size());
+  for (unsigned int i = 0; i < ss.size(); ++i)
+    pack_string(buf, ss[i]);
+}
+
+ARGPARSE_STATIC
+std::vector<std::string> unpack_strings(const char * buf, const size_t n, 
+				     size_t & pos) {
+  unsigned int ns = unpack_uint32(buf, n, pos);
+  if ( ns > n - pos )
+    throw unpackErr();
+
+  std::vector<std::string> ss;
+  ss.reserve(ns);
+  for (unsigned int i = 0; i < ns; ++i)
+    ss.push_back(unpack_string(buf, n, pos));
+
+  return ss;
+}
+
+/* Binary serialization of the whole argument definition */
+ARGPARSE_INLINE void Argument :: packSchema(std::string & buf) const {
+  pack_string(buf, argName);
+  pack_uint32(buf, nargs);
+  pack_uint32(buf, bRemainder ? 1 : 0);
+  pack_uint32(buf, bOpt ? 1 : 0);
+  pack_strings(buf, optSwitches);
+  pack_string(buf, help);
+  pack_string(buf, envVar);
+  pack_uint32(buf, action);
+  pack_uint32(buf, dupKeyPolicy);
+  pack_strings(buf, acceptSet);
+
+  /* Default values */
+  pack_uint32(buf, dv_b.size());
+  for (unsigned int i = 0; i < dv_b.size(); ++i)
+    buf += static_cast<char>(dv_b[i] ? 1 : 0);
+  pack_uint32(buf, dv_i.size());
+  for (unsigned int i = 0; i < dv_i.size(); ++i)
+    pack_uint32(buf, static_cast<unsigned int>(dv_i[i]));
+  pack_uint32(buf, dv_f.size());
+  for (unsigned int i = 0; i < dv_f.size(); ++i)
+    pack_float(buf, dv_f[i]);
+  pack_strings(buf, dv_s);
+
+  /* Custom value type: name, value size and default values */
+  pack_string(buf, (customType != 0) ? customType->name : "");
+  pack_uint32(buf, (customType != 0) ? customType->size : 0);
+  pack_string(buf, std::string(dv_c.begin(), dv_c.end()));
+
+  pack_uint32(buf, pathOpts);
+
+  /* Values (value type included) */
+  packVals(buf);
+}
+
+ARGPARSE_INLINE
+void Argument :: unpackSchema(const char * buf, const size_t n, size_t & pos) {
+  argName = unpack_string(buf, n, pos);
+  nargs = unpack_uint32(buf, n, pos);
+  bRemainder = (unpack_uint32(buf, n, pos) != 0);
+  bOpt = (unpack_uint32(buf, n, pos) != 0);
+  optSwitches = unpack_strings(buf, n, pos);
+  help = unpack_string(buf, n, pos);
+  envVar = unpack_string(buf, n, pos);
+  action = static_cast<action_t>(unpack_uint32(buf, n, pos));
+  dupKeyPolicy = static_cast<dupKeyPolicy_t>(unpack_uint32(buf, n, pos));
+  acceptSet = unpack_strings(buf, n, pos);
+
+  unsigned int nd = unpack_uint32(buf, n, pos);
+  if ( nd > n - pos )
+    throw unpackErr();
+  dv_b.clear();
+  for (unsigned int i = 0; i < nd; ++i)
+    dv_b.push_back(buf[pos++] != 0);
+
+  nd = unpack_uint32(buf, n, pos);
+  dv_i.clear();
+  for (unsigned int i = 0; i < nd; ++i)
+    dv_i.push_back(static_cast<int>(unpack_uint32(buf, n, pos)));
+
+  nd = unpack_uint32(buf, n, pos);
+  dv_f.clear();
+  for (unsigned int i = 0; i < nd; ++i)
+    dv_f.push_back(unpack_float(buf, n, pos));
+
+  dv_s = unpack_strings(buf, n, pos);
+
+  /* The custom value type must be registered, with the same value size */
+  const std::string typeName = unpack_string(buf, n, pos);
+  const unsigned int typeSize = unpack_uint32(buf, n, pos);
+  customType = 0;
+  if ( !typeName.empty() ) {
+    customType = findValueType(typeName);
+    if ( customType == 0 || customType->size != typeSize )
+      throw unpackErr();
+  }
+  const std::string dvc = unpack_string(buf, n, pos);
+  dv_c.assign(dvc.begin(), dvc.end());
+
+  pathOpts = unpack_uint32(buf, n, pos);
+
+  /* The value type precedes the values in the packed values */
+  size_t tpos = pos + 4;
+  valType = static_cast<valueType_t>(unpack_uint32(buf, n, tpos));
+  if ( (valType == VAL_TYPE_CUSTOM) != (customType != 0) )
+    throw unpackErr();
+  unpackVals(buf, n, pos);
+
+  compileAcceptSets();
+}
+
+/* Map */
+ARGPARSE_INLINE
+std::map<std::string, std::string> Argument :: getMapVals() const {
+  if ( !bSet ) throw valNotSetErr();
+
+  if ( valType != VAL_TYPE_MAP )
+    throw getValFailure();
+
+  std::map<std::string, std::string> m;
+  for (size_t i = 0; i < v_m.size(); ++i)
+    m[v_m.key(i)] = v_m.value(i);
+
+  return m;
+}
+
+ARGPARSE_INLINE const StringTable & Argument :: getMapTable() const {
+  if ( valType != VAL_TYPE_MAP )
+    throw getValFailure();
+
+  return v_m;
+}
+
+ARGPARSE_INLINE bool Argument :: hasKey(const std::string & key) const {
+  if ( valType != VAL_TYPE_MAP )
+    throw getValFailure();
+
+  return v_m.contains(key);
+}
+
+ARGPARSE_INLINE
+std::string Argument :: getMapVal(const std::string & key) const {
+  if ( !bSet ) throw valNotSetErr();
+
+  if ( valType != VAL_TYPE_MAP )
+    throw getValFailure();
+
+  const char * v;
+  size_t vl;
+  if ( !v_m.find(key.data(), key.size(), v, vl) )
+    throw keyNotFoundErr();
+
+  return std::string(v, vl);
+}
+
+/* Argument: generate help string */
+ARGPARSE_INLINE std::string Argument :: getHelpString(const int cw, 
+				 const int lw, 
+				 const std::string destName) const {
+  const int lPad = 2;
+  const int mPad = 1;
+
+  std::ostringstream oss;
+  if ( cw <= 0 || lw <= 0 || lw >= cw )
+    throw getHelpStringErr();
+
+  /* Left padding */
+  for (int i = 0; i < lPad; ++i)
+    oss << " ";
+
+  if ( !bOpt ) { /* Positional argument */
+    oss << argName << " ";
+   
+    if ( static_cast<int>(argName.size()) + 1 >= lw )
+      oss << "\n";
+    else
+      oss << std::string(lw - argName.size() - 1 - lPad, ' ');
+
+  }
+  else { /* Optional argument */
+    oss << argName;
+    for (int i = 0; i < nargs; ++i) {
+      oss << " " << destName;
+      if ( nargs > 1 )
+	oss << (i + 1);
+    }
+    /* Optional switches */
+    if ( optSwitches.size() > 0 ) {
+      oss << "   (";
+      for (unsigned int i = 0; i < optSwitches.size(); ++i) {
+      	oss << optSwitches[i];
+      	if (i < optSwitches.size() - 1)
+      	  oss << ", ";
+      	else 
+      	  oss << ")";
+      }
+    }
+
+    if ( oss.str().size() < static_cast<unsigned int>(lw) - mPad ) {
+      for (unsigned int i = 0; 
+	   i < static_cast<unsigned int>(lw) - mPad - oss.str().size(); ++i)
+	oss << " ";      
+    }
+    else {
+      oss << "\n";
+      for (int i = 0; i < lw; ++i)
+	oss << " ";
+      /* TODO */
+    }
+  }
+
+
+  /* Show type and number of arguments */
+  std::ostringstream ossType;
+  ossType << "[";
+  if ( valType == VAL_TYPE_BOOL )
+    ossType << "Boolean";
+  else if ( valType == VAL_TYPE_INT )
+    ossType << "integer";
+  else if ( valType == VAL_TYPE_FLOAT )
+    ossType << "float";
+  else if ( valType == VAL_TYPE_STRING )
+    ossType << "string";
+  else if ( valType == VAL_TYPE_PATH )
+    ossType << "path";
+  else if ( valType == VAL_TYPE_MAP )
+    ossType << "key=value,...";
+  else if ( valType == VAL_TYPE_CUSTOM )
+    ossType << customType->name;
+  
+  if ( nargs > 1 )
+    ossType << " x " << nargs;
+
+  if ( action == APPEND )
+    ossType << ", repeatable";
+
+  if ( bRemainder )
+    ossType << ", all remaining arguments";
+  
+  ossType << "] ";
+
+  /* Show help info */
+  std::string helpStr = ossType.str() + help;
+
+  /* Special case: STORE_TRUE and STORE_FALSE Boolean types */
+  if ( (valType == VAL_TYPE_BOOL) && 
+       ((action == STORE_TRUE) || (action == STORE_FALSE)) ) {
+    helpStr += " (Default: ";
+    helpStr += ((action == STORE_TRUE) ? "FALSE" : "TRUE");
+    helpStr += ")";
   }
 
   helpStr = lineFormat(helpStr, cw, lw);  
@@ -758,7 +2329,19 @@ string Argument :: getHelpString(const int cw,
       ossAcc << destName;
       if (nargs > 1)
 	ossAcc << i + 1;
-      ossAcc << ": " << acceptSet[i];
+      ossAcc << ": ";
+
+      const unsigned int maxListed = 16; 
+      if ( !acceptTables.empty() && acceptTables[i].size() > maxListed ) {
+	/* Large enumerations: summarize */
+	ossAcc << "one of " << acceptTables[i].size() << " values (e.g., ";
+	for (unsigned int k = 0; k < 3; ++k)
+	  ossAcc << acceptTables[i].key(k) << ", ";
+	ossAcc << "...)";
+      }
+      else {
+	ossAcc << acceptSet[i];
+      }
       oss << "\n" << lineFormat(ossAcc.str(), cw, lw + 2);
     }
   }
@@ -767,49 +2350,64 @@ string Argument :: getHelpString(const int cw,
     /* Default values */
     std::ostringstream ossDef;
     if ( valType == VAL_TYPE_BOOL && ! dv_b.empty() ) {
-      oss << "\n" << lineFormat(string("Default: "), cw, lw);
-      for (int i = 0; i < nargs; ++i) {
+      oss << "\n" << lineFormat(std::string("Default: "), cw, lw);
+      for (unsigned int i = 0; i < dv_b.size(); ++i) {
 	ossDef.clear();
 	ossDef << "  " << destName;
 	if ( nargs > 1 ) 
-	  ossDef << i + 1;
+	  ossDef << i % nargs + 1;
 	ossDef << " = " << dv_b[i];
 	oss << "\n" << lineFormat(ossDef.str(), cw + 2, lw);
       }
     }
     else if ( valType == VAL_TYPE_INT && ! dv_i.empty() ) {
-      oss << "\n" << lineFormat(string("Default: "), cw, lw);
-      for (int i = 0; i < nargs; ++i) {
+      oss << "\n" << lineFormat(std::string("Default: "), cw, lw);
+      for (unsigned int i = 0; i < dv_i.size(); ++i) {
 	ossDef.str("");
 	ossDef << "  " << destName;
 	if ( nargs > 1 ) 
-	  ossDef << i + 1;
+	  ossDef << i % nargs + 1;
 	ossDef << " = " << dv_i[i];
 	oss << "\n" << lineFormat(ossDef.str(), cw, lw + 2);
       }      
     }
     else if ( valType == VAL_TYPE_FLOAT && ! dv_f.empty() ) {
-      oss << "\n" << lineFormat(string("Default: "), cw, lw);
-      for (int i = 0; i < nargs; ++i) {
+      oss << "\n" << lineFormat(std::string("Default: "), cw, lw);
+      for (unsigned int i = 0; i < dv_f.size(); ++i) {
 	ossDef.str("");
 	ossDef << "  " << destName;
 	if ( nargs > 1 ) 
-	  ossDef << i + 1;
+	  ossDef << i % nargs + 1;
 	ossDef << " = " << dv_f[i];
 	oss << "\n" << lineFormat(ossDef.str(), cw, lw + 2);
       }      
     }
-    else if ( valType == VAL_TYPE_STRING && ! dv_s.empty() ) {
-      oss << "\n" << lineFormat(string("Default: "), cw, lw);
-      for (int i = 0; i < nargs; ++i) {
+    else if ( (strType() || valType == VAL_TYPE_MAP) 
+	      && ! dv_s.empty() ) {
+      oss << "\n" << lineFormat(std::string("Default: "), cw, lw);
+      for (unsigned int i = 0; i < dv_s.size(); ++i) {
 	ossDef.str("");
 	ossDef << "  " << destName;
 	if ( nargs > 1 ) 
-	  ossDef << i + 1;
+	  ossDef << i % nargs + 1;
 	ossDef << " = " << dv_s[i];
 	oss << "\n" << lineFormat(ossDef.str(), cw, lw + 2);
       }
     }
+    else if ( valType == VAL_TYPE_CUSTOM && ! dv_c.empty() ) {
+      oss << "\n" << lineFormat(std::string("Default: "), cw, lw);
+      for (unsigned int i = 0; i < dv_c.size() / customType->size; ++i) {
+	char t[256];
+	const size_t tl = customType->format(&dv_c[i * customType->size], 
+					     t, sizeof(t));
+	ossDef.str("");
+	ossDef << "  " << destName;
+	if ( nargs > 1 ) 
+	  ossDef << i % nargs + 1;
+	ossDef << " = " << std::string(t, tl);
+	oss << "\n" << lineFormat(ossDef.str(), cw, lw + 2);
+      }
+    }
   }
 
   return oss.str();
@@ -818,33 +2416,54 @@ string Argument :: getHelpString(const int cw,
 
 /* Class ArgumentParser */
 /* Default constructor */
-ArgumentParser :: ArgumentParser() :
+ARGPARSE_INLINE ArgumentParser :: ArgumentParser() :
   bParsed(false), 
   bCombineSwitches(false), 
+  bNumericSwitches(false), 
   command(""), 
   description("") {
   nPosArgs = 0;
   nOptArgs = 0;
   nSLS = 0;
+  bLazyConv = false;
+  nValidatorThreads = 0;
+  traceRec = 0;
+  traceLoopNs = 0;
+  bConstraintsCompiled = true;
+  bSwitchIndexBuilt = false;
+  bSwitchTreeBuilt = false;
+  bValueIndexBuilt = false;
 }
 
 /* Constrcutor with arguments */
-ArgumentParser :: ArgumentParser(const string t_cmd, 
-				 const string t_description, 
+ARGPARSE_INLINE ArgumentParser :: ArgumentParser(const std::string t_cmd, 
+				 const std::string t_description, 
 				 const bool t_bCombineSwitches) : 
   bParsed(false), 
   bCombineSwitches(t_bCombineSwitches), 
+  bNumericSwitches(false), 
   command(t_cmd), 
   description(t_description) {
   nPosArgs = 0;
   nOptArgs = 0;
   nSLS = 0;
+  bLazyConv = false;
+  nValidatorThreads = 0;
+  traceRec = 0;
+  traceLoopNs = 0;
+  bConstraintsCompiled = true;
+  bSwitchIndexBuilt = false;
+  bSwitchTreeBuilt = false;
+  bValueIndexBuilt = false;
 }
 
 /* Private member function: addSwitch */
-void ArgumentParser :: addSwitch(const std::string s) {
+ARGPARSE_INLINE void ArgumentParser :: addSwitch(const std::string s) {
+  if ( classify_token(s.c_str()) == TOKEN_NEGATIVE_NUMBER )
+    bNumericSwitches = true;
+
   if ( s.find_first_not_of("-") == 1 ) { /* Single dash */
-    if ( find(sdSwitches.begin(), sdSwitches.end(), s) 
+    if ( std::find(sdSwitches.begin(), sdSwitches.end(), s) 
 	 != sdSwitches.end() ) {
       throw duplicateSwitchesErr();
     }
@@ -853,7 +2472,7 @@ void ArgumentParser :: addSwitch(const std::string s) {
     }
   }
   else if ( s.find_first_not_of("-") == 2 ) { /* Double dash */
-    if ( find(ddSwitches.begin(), ddSwitches.end(), s) 
+    if ( std::find(ddSwitches.begin(), ddSwitches.end(), s) 
 	 != ddSwitches.end() ) {
       throw duplicateSwitchesErr();
     }
@@ -865,7 +2484,7 @@ void ArgumentParser :: addSwitch(const std::string s) {
 }
 
 /* ArgumentParser: add_argument */
-void ArgumentParser :: 
+ARGPARSE_INLINE void ArgumentParser :: 
 add_argument(const std::string t_dest, /* Destination variable name */
 	     const std::string t_argName, /* Argument name */
 	     const std::string t_help, /* Help information */
@@ -882,358 +2501,1552 @@ add_argument(const std::string t_dest, /* Destination variable name */
   // cout << "t_dest = " << t_dest << endl; // DEBUG
   // cout << "t_action = " << t_action << endl;
 
-  mArgs[t_dest] = Argument(t_argName, t_valType, t_help, t_action,  
-			   altOptSwitches, t_nargs);
+  Argument t_arg(t_argName, t_valType, t_help, t_action, 
+		 altOptSwitches, t_nargs);
+
+  addArgument(t_dest, t_arg, t_argName, altOptSwitches);
+}
+
+/* ArgumentParser: add_argument, with a custom value type */
+ARGPARSE_INLINE void ArgumentParser :: 
+add_argument(const std::string t_dest, 
+	     const std::string t_argName, 
+	     const std::string t_help, 
+	     const std::string & t_typeName, 
+	     const Argument::action_t t_action, 
+	     const std::vector<std::string> & altOptSwitches,  
+	     const int t_nargs) {
+  if ( t_dest.empty() )
+    throw emptyDestNameErr();
+
+  if ( mArgs.count(t_dest) > 0 )
+    throw duplicateArgsErr();
+
+  const ValueType * vt = Argument::findValueType(t_typeName);
+  if ( vt == 0 )
+    throw unknownValueTypeErr();
+
+  Argument t_arg(t_argName, Argument::VAL_TYPE_CUSTOM, t_help, t_action, 
+		 altOptSwitches, t_nargs, vt);
+
+  addArgument(t_dest, t_arg, t_argName, altOptSwitches);
+}
+
+/* Add a constructed argument */
+ARGPARSE_INLINE void ArgumentParser :: 
+addArgument(const std::string & t_dest, const Argument & t_arg, 
+	    const std::string & t_argName, 
+	    const std::vector<std::string> & altOptSwitches) {
+  if ( t_arg.isPositional() && !pArgs.empty() && 
+       mArgs[pArgs.back()].isRemainder() )
+    /* The remainder positional argument must be the last one */
+    throw addArgumentFailure();
+
+  mArgs[t_dest] = t_arg;
+
+  if ( mArgs[t_dest].isPositional() ) {
+    nPosArgs++;
+
+    pArgs.push_back(t_dest); /* Add to the list of positional arguments */
+  }
+  else {
+    nOptArgs++;
+
+    /* Check the duplication of switches */
+    addSwitch(t_argName);
+    for ( std::vector<std::string>::const_iterator aosIt = 
+	    altOptSwitches.begin(); 
+    	  aosIt != altOptSwitches.end(); ++aosIt)
+      addSwitch(*aosIt);
+  }
+  
+  // cout << "nPosArgs = " << nPosArgs << endl; // DEBUG
+
+  if ( !checkSwitches() )
+    throw incompatibleSwitchesErr();
+
+  /* Argument indices have changed */
+  bConstraintsCompiled = false;
+  bSwitchIndexBuilt = false;
+  bSwitchTreeBuilt = false;
+  bValueIndexBuilt = false;
+}
+
+
+/* Set bCombineSwitches */
+ARGPARSE_INLINE void ArgumentParser :: setCombineSwitches(const bool bcs) {
+  bCombineSwitches = bcs;
+}
+
+ARGPARSE_INLINE void ArgumentParser :: setLazyConversion(const bool blc) {
+  bLazyConv = blc;
+}
+
+/* Convert and check the values stored under lazy conversion */
+ARGPARSE_INLINE void ArgumentParser :: validate_all() {
+  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it)
+    convertArg((*it).first, (*it).second);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: convertArg(const std::string & t_dest,
+						  const Argument & arg) {
+  std::ostringstream ossErr;
+  try {
+    arg.convertRaw();
+  }
+  catch (Argument::valOutsideAcceptanceSet) {
+    ossErr << "ERROR: Value outside acceptance set of argument " << t_dest;
+  }
+  catch (...) {
+    ossErr << "ERROR: Failed to convert value of argument " << t_dest;
+  }
+
+  if ( !ossErr.str().empty() ) {
+    print_help();
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr(ossErr.str());
+  }
+}
+
+ARGPARSE_INLINE 
+void ArgumentParser :: setValidatorThreads(const unsigned int n) {
+  nValidatorThreads = n;
+}
+
+/* Mark of arguments without values to validate (see runValidators()) */
+static const unsigned int noValidation = 0xffffffff;
+
+/* A validation run: one task per value, each with its own message slot, 
+   so that the tasks share nothing */
+struct validationRun_t {
+  std::vector<const Argument *> args;
+  std::vector<unsigned int> idx;
+  std::vector<std::string> msgs;
+  std::vector<unsigned char> fails;
+};
+
+ARGPARSE_STATIC void validation_task(const size_t k, void * ctx) {
+  validationRun_t & vr = *static_cast<validationRun_t *>(ctx);
+  vr.fails[k] = !vr.args[k]->validateVal(vr.idx[k], vr.msgs[k]);
+}
+
+ARGPARSE_INLINE 
+void ArgumentParser :: runValidators(const std::vector<unsigned int> * from) {
+  validationRun_t vr;
+  std::vector<const std::string *> dests;
+  /* Path patterns that match nothing, with their destination names */
+  std::vector<std::pair<const std::string *, std::string> > unmatched;
+
+  unsigned int k = 0;
+  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it, ++k) {
+    Argument & arg = (*it).second;
+    const bool bGlob = (arg.getPathOptions() & Argument::PATH_GLOB) != 0;
+    if ( !arg.set() || (!arg.hasValidator() && !bGlob) )
+      continue;
+    const unsigned int first = (from != 0) ? (*from)[k] : 0;
+    if ( first == noValidation )
+      continue;
+
+    convertArg((*it).first, arg);
+    if ( bGlob ) {
+      std::vector<std::string> pats;
+      arg.expandPaths(nValidatorThreads, pats, first);
+      for (unsigned int k = 0; k < pats.size(); ++k)
+	unmatched.push_back(std::make_pair(&(*it).first, pats[k]));
+    }
+    if ( !arg.hasValidator() )
+      continue;
+
+    const unsigned int nv = arg.isRemainder() ? 
+      arg.getRemainderArgc() : arg.getNVals();
+    for (unsigned int i = first; i < nv; ++i) {
+      vr.args.push_back(&arg);
+      vr.idx.push_back(i);
+      dests.push_back(&(*it).first);
+    }
+  }
+  if ( vr.args.empty() && unmatched.empty() )
+    return;
+
+  vr.msgs.resize(vr.args.size());
+  vr.fails.assign(vr.args.size(), 0);
+  /* Up to 256 chunks: few values are spread one by one, many in chunks */
+  parallel_for(vr.args.size(), validation_task, &vr, nValidatorThreads, 
+	       1 + vr.args.size() / 256);
+
+  const unsigned int nFails = unmatched.size() + 
+    std::count(vr.fails.begin(), vr.fails.end(), 1);
+  if ( nFails == 0 )
+    return;
+
+  /* The first maxListed failures are listed */
+  const unsigned int maxListed = 20;
+  std::ostringstream ossErr;
+  ossErr << "ERROR: Validation failed for " << nFails << " value(s):";
+
+  unsigned int nListed = 0;
+  for (k = 0; k < unmatched.size() && nListed < maxListed; ++k) {
+    ossErr << "\n  " << *unmatched[k].first << ": " << unmatched[k].second
+	   << ": No match";
+    nListed++;
+  }
+  for (k = 0; k < vr.args.size() && nListed < maxListed; ++k) {
+    if ( !vr.fails[k] )
+      continue;
+
+    char buf[256];
+    ossErr << "\n  " << *dests[k] << ": " 
+	   << vr.args[k]->getValText(vr.idx[k], buf, sizeof(buf));
+    if ( !vr.msgs[k].empty() )
+      ossErr << ": " << vr.msgs[k];
+    nListed++;
+  }
+  if ( nFails > nListed )
+    ossErr << "\n  ... (" << nFails - nListed << " more)";
+
+  std::cerr << ossErr.str() << std::endl;
+  throw argParsingErr(ossErr.str());
+}
+
+/* Constraints between optional arguments */
+ARGPARSE_INLINE
+void ArgumentParser :: addConstraint(const constraintType_t type, 
+				     const std::string subject,
+				     const std::vector<std::string> & members) {
+  if ( !subject.empty() ) {
+    if ( mArgs.count(subject) == 0 )
+      throw argNotFoundErr();
+    if ( mArgs[subject].isPositional() )
+      throw constraintErr();
+  }
+
+  for (unsigned int k = 0; k < members.size(); ++k) {
+    if ( mArgs.count(members[k]) == 0 )
+      throw argNotFoundErr();
+    if ( mArgs[members[k]].isPositional() || members[k] == subject )
+      throw constraintErr();
+  }
+
+  const unsigned int minMembers = subject.empty() ? 2 : 1;
+  if ( members.size() < minMembers )
+    throw constraintErr();
+
+  constraint_t con;
+  con.type = type;
+  con.subject = subject;
+  con.members = members;
+  con.subjectIdx = -1;
+  con.nMembers = 0;
+  constraints.push_back(con);
+
+  bConstraintsCompiled = false;
+}
+
+ARGPARSE_INLINE
+void ArgumentParser :: 
+add_mutually_exclusive(const std::vector<std::string> & dests) {
+  addConstraint(CONSTRAINT_EXCLUSIVE, std::string(""), dests);
+}
+
+ARGPARSE_INLINE
+void ArgumentParser :: 
+add_required_together(const std::vector<std::string> & dests) {
+  addConstraint(CONSTRAINT_TOGETHER, std::string(""), dests);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: add_requires(const std::string dest, 
+				    const std::vector<std::string> & required) {
+  if ( dest.empty() )
+    throw emptyDestNameErr();
+  addConstraint(CONSTRAINT_REQUIRES, dest, required);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: add_requires(const std::string dest, 
+				    const std::string required) {
+  add_requires(dest, std::vector<std::string>(1, required));
+}
+
+ARGPARSE_INLINE void ArgumentParser :: add_conflicts(const std::string dest, 
+				     const std::vector<std::string> & conflicting) {
+  if ( dest.empty() )
+    throw emptyDestNameErr();
+  addConstraint(CONSTRAINT_CONFLICTS, dest, conflicting);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: add_conflicts(const std::string dest, 
+				     const std::string conflicting) {
+  add_conflicts(dest, std::vector<std::string>(1, conflicting));
+}
+
+/* Translate the destination names of the constraints into bit masks over
+   the indices of the arguments in mArgs */
+ARGPARSE_INLINE void ArgumentParser :: compileConstraints() {
+  std::map<std::string, unsigned int> index;
+  unsigned int k = 0;
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit)
+    index[(*amit).first] = k++;
+
+  for (unsigned int i = 0; i < constraints.size(); ++i) {
+    constraint_t & con = constraints[i];
+    con.subjectIdx = con.subject.empty() ? -1 : index[con.subject];
+    con.mask.clear();
+    for (unsigned int m = 0; m < con.members.size(); ++m)
+      bits_set(con.mask, index[con.members[m]]);
+    con.nMembers = bits_count(con.mask);
+  }
+
+  bConstraintsCompiled = true;
+}
+
+/* List of the (primary) switches of a set of arguments */
+ARGPARSE_INLINE
+std::string 
+ArgumentParser :: switchList(const std::vector<std::string> & dests) const {
+  std::string s;
+  for (unsigned int k = 0; k < dests.size(); ++k) {
+    if ( k > 0 )
+      s += ", ";
+    s += mArgs.at(dests[k]).getArgName();
+  }
+  return s;
+}
+
+/* Check the constraints: each constraint takes masked population counts of
+   the bit sets of the arguments given in argv and in the environment 
+   (which are disjoint) */
+ARGPARSE_INLINE void ArgumentParser :: checkConstraints() {
+  if ( constraints.empty() )
+    return;
+
+  if ( !bConstraintsCompiled )
+    compileConstraints();
+
+  for (unsigned int i = 0; i < constraints.size(); ++i) {
+    const constraint_t & con = constraints[i];
+    const unsigned int nGiven = bits_count_and(argvBits, con.mask) 
+      + bits_count_and(envBits, con.mask);
+
+    bool bOkay = true;
+    switch (con.type) {
+    case CONSTRAINT_EXCLUSIVE:
+      bOkay = (nGiven <= 1);
+      break;
+    case CONSTRAINT_TOGETHER:
+      bOkay = (nGiven == 0 || nGiven == con.nMembers);
+      break;
+    case CONSTRAINT_REQUIRES:
+      bOkay = !isGiven(con.subjectIdx) || nGiven == con.nMembers;
+      break;
+    case CONSTRAINT_CONFLICTS:
+      bOkay = !isGiven(con.subjectIdx) || nGiven == 0;
+      break;
+    }
+    if ( bOkay )
+      continue;
+
+    /* Name the offending switches */
+    std::vector<std::string> present, absent;
+    for (unsigned int m = 0; m < con.members.size(); ++m) {
+      const unsigned int idx = 
+	std::distance(mArgs.begin(), mArgs.find(con.members[m]));
+      if ( isGiven(idx) )
+	present.push_back(con.members[m]);
+      else
+	absent.push_back(con.members[m]);
+    }
+
+    std::ostringstream ossErr;
+    switch (con.type) {
+    case CONSTRAINT_EXCLUSIVE:
+      ossErr << "ERROR: Mutually exclusive optional arguments given together: "
+	     << switchList(present);
+      break;
+    case CONSTRAINT_TOGETHER:
+      ossErr << "ERROR: Optional arguments " << switchList(present) 
+	     << " must be given together with " << switchList(absent);
+      break;
+    case CONSTRAINT_REQUIRES:
+      ossErr << "ERROR: Optional argument " 
+	     << switchList(std::vector<std::string>(1, con.subject)) 
+	     << " requires " << switchList(absent);
+      break;
+    case CONSTRAINT_CONFLICTS:
+      ossErr << "ERROR: Optional argument " 
+	     << switchList(std::vector<std::string>(1, con.subject)) 
+	     << " conflicts with " << switchList(present);
+      break;
+    }
+    print_help();
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr(ossErr.str());
+  }
+}
+
+/* Set the prefix for environment-variable fallbacks */
+ARGPARSE_INLINE void ArgumentParser :: setEnvPrefix(const std::string prefix) {
+  envPrefix = prefix;
+}
+
+/* Environment variable name for an argument: the explicit envVar if there 
+   is one, otherwise envPrefix followed by the upper-cased destination name 
+   (with non-alphanumeric characters replaced by '_'). Empty string: no 
+   environment fallback for this argument. */
+ARGPARSE_INLINE
+std::string ArgumentParser :: envName(const std::string & t_dest, 
+				 const Argument & arg) const {
+  if ( !arg.getEnvVar().empty() )
+    return arg.getEnvVar();
+
+  if ( envPrefix.empty() )
+    return std::string("");
+
+  std::string name = envPrefix;
+  name.reserve(envPrefix.size() + t_dest.size());
+  for (unsigned int i = 0; i < t_dest.size(); ++i) {
+    if ( isalnum(static_cast<unsigned char>(t_dest[i])) )
+      name += static_cast<char>(toupper(static_cast<unsigned char>(t_dest[i])));
+    else
+      name += '_';
+  }
+
+  return name;
+}
+
+/* Take values from the environment for arguments absent from argv. 
+   environ is scanned only once: the names wanted by the absent arguments 
+   are first collected into an index, and each environment entry is then 
+   looked up in that index. */
+ARGPARSE_INLINE void ArgumentParser :: applyEnvFallbacks() {
+  /* Environment variable name --> argument and its index in mArgs */
+  std::map<std::string, std::pair<AMapIt, unsigned int> > wanted; 
+  typedef std::map<std::string, std::pair<AMapIt, unsigned int> >::iterator 
+    WantedIt;
+
+  /* The names of all arguments are collected, so that two arguments with 
+     the same variable are errors whether they are given in argv or not */
+  unsigned int k = 0;
+  unsigned int nWanted = 0;
+  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it, ++k) {
+    const Argument & arg = (*it).second;
+    std::string name = envName((*it).first, arg);
+    if ( name.empty() )
+      continue;
+
+    const std::pair<WantedIt, bool> ins = 
+      wanted.insert(std::make_pair(name, std::make_pair(it, k)));
+    if ( !ins.second ) {
+      std::ostringstream ossErr;
+      ossErr << "ERROR: Arguments " << (*(*ins.first).second.first).first 
+	     << " and " << (*it).first 
+	     << " fall back to the same environment variable " << name;
+      std::cerr << ossErr.str() << std::endl;
+      throw argParsingErr(ossErr.str());
+    }
+
+    if ( !(arg.isPositional() ? arg.set() : bits_test(argvBits, k)) )
+      nWanted++; /* Not given in argv */
+  }
+
+  if ( nWanted == 0 || environ == 0 )
+    return;
+
+  for (char ** ep = environ; *ep != 0; ++ep) {
+    const char * eq = strchr(*ep, '=');
+    if ( eq == 0 )
+      continue;
+
+    std::map<std::string, std::pair<AMapIt, unsigned int> >::const_iterator 
+      wit = wanted.find(std::string(*ep, eq - *ep));
+    if ( wit == wanted.end() )
+      continue;
+
+    const std::string & t_dest = (*(*wit).second.first).first;
+    Argument & arg = (*(*wit).second.first).second;
+    const unsigned int idx = (*wit).second.second;
+    if ( arg.isPositional() ? arg.set() : bits_test(argvBits, idx) )
+      continue; /* Given in argv */
+
+    const std::string val(eq + 1);
+    
+    std::ostringstream ossErr;
+    try {
+      if ( arg.setValFromString(val) )
+	bits_set(envBits, idx);
+    }
+    catch (Argument::valOutsideAcceptanceSet) {
+      ossErr << "ERROR: Value outside acceptance set of argument " 
+	     << t_dest << " in environment variable " 
+	     << (*wit).first << ": " << val;
+      std::cerr << ossErr.str() << std::endl;
+      throw argParsingErr(ossErr.str());
+    }
+    catch (...) {
+      ossErr << "ERROR: Failed to set value of argument " << t_dest 
+	     << " from environment variable " << (*wit).first << ": " << val;
+      std::cerr << ossErr.str() << std::endl;
+      throw argParsingErr(ossErr.str());
+    }
+  }
+}
+
+/* Check the legality of the switches under bCombineSwitches. 
+ Return value: true - OK
+               false - incompatibility found */
+ARGPARSE_INLINE const bool ArgumentParser :: checkSwitches() {
+  if ( bCombineSwitches ) {
+    /* Single-dash BOOL-type switches will be combined */
+    for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
+      if ( (*it).second.getValType() != Argument::VAL_TYPE_BOOL )
+	continue;
+      
+      // cout << (*it).second.getArgName() << endl; // DEBUG
+      if ( (*it).second.getArgName().find_first_not_of("-") != 1 ) {
+	/* Under the combine mode, all boolean switches must be single-dashed 
+	   in its primary argName */
+	throw incompatibleSwitchesErr();
+      }
+
+      
+    }
+    
+    return true;
+  }
+  else {
+    return true;
+  }
+
+}
+
+/* Operator for allowing access to member arguments */
+ARGPARSE_INLINE
+Argument & ArgumentParser :: operator[](const std::string & t_dest) {
+  /* Test if argument exists */
+  if ( mArgs.count(t_dest) == 0 )
+    throw argNotFoundErr();
+
+  /* The argument (e.g., its acceptance set) may be modified through the 
+     reference */
+  bValueIndexBuilt = false;
+
+  return mArgs[t_dest];
+}
+
+/* Build the switch index */
+ARGPARSE_INLINE
+void 
+ArgumentParser :: buildSwitchIndex(std::vector<switchEntry_t> & sws) const {
+  sws.clear();
+
+  unsigned int k = 0;
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit, ++k) {
+    const Argument & arg = (*amit).second;
+    if ( arg.isPositional() )
+      continue;
+
+    switchEntry_t se;
+    se.dest = (*amit).first;
+    se.idx = k;
+    se.sw = arg.getArgName();
+    sws.push_back(se);
+    const std::vector<std::string> & optSwitches = arg.getOptSwitches();
+    for (unsigned int i = 0; i < optSwitches.size(); ++i) {
+      se.sw = optSwitches[i];
+      sws.push_back(se);
+    }
+  }
+
+  std::sort(sws.begin(), sws.end());
+}
+
+/* Build the completion index of values */
+ARGPARSE_INLINE
+void ArgumentParser :: buildValueIndex(ValueIndex & vals) const {
+  vals.clear();
+
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit) {
+    const Argument & arg = (*amit).second;
+    if ( arg.getValType() != Argument::VAL_TYPE_STRING )
+      continue;
+
+    std::vector<std::vector<std::string> > posVals(arg.getNArgs());
+    bool bAny = false;
+    for (int i = 0; i < arg.getNArgs(); ++i) {
+      posVals[i] = arg.getAcceptMembers(i);
+      std::sort(posVals[i].begin(), posVals[i].end());
+      bAny = bAny || !posVals[i].empty();
+    }
+    if ( bAny )
+      vals[(*amit).first].swap(posVals);
+  }
+}
+
+/* Build the switch index if needed, and size the bit sets of given 
+   arguments, so that parsing needs no further allocation */
+ARGPARSE_INLINE void ArgumentParser :: prepareSwitchIndex() {
+  if ( !bSwitchIndexBuilt ) {
+    buildSwitchIndex(switchIndex);
+    bSwitchIndexBuilt = true;
+    bSwitchTreeBuilt = false;
+  }
+
+  const size_t nWords = mArgs.size() / (8 * sizeof(unsigned long)) + 1;
+  if ( argvBits.size() != nWords ) {
+    argvBits.assign(nWords, 0);
+    envBits.assign(nWords, 0);
+  }
+}
+
+/* Look up a switch by binary search, comparing C strings */
+ARGPARSE_INLINE const ArgumentParser::switchEntry_t * 
+ArgumentParser :: findSwitch(const char * sw) const {
+  size_t lo = 0, hi = switchIndex.size();
+  while ( lo < hi ) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp = strcmp(switchIndex[mid].sw.c_str(), sw);
+    if ( cmp == 0 )
+      return &switchIndex[mid];
+    else if ( cmp < 0 )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return 0;
+}
+
+/* Candidates for the last of words, given the preceding words */
+ARGPARSE_INLINE
+std::vector<std::string> 
+ArgumentParser :: complete(const std::vector<std::string> & words) {
+  std::vector<std::string> cands;
+  if ( words.empty() )
+    return cands;
+
+  prepareSwitchIndex();
+  if ( !bValueIndexBuilt ) {
+    buildValueIndex(valueIndex);
+    bValueIndexBuilt = true;
+  }
+
+  /* Replay the preceding words: which argument expects the next value */
+  std::string pendDest;      /* Switch expecting values */
+  int nPending = 0;     /* Number of values still expected */
+  int pendPos = 0;      /* Position of the next value */
+  unsigned int ip = 0;  /* Index of the next positional argument */
+  bool bTerminated = false;
+  std::set<std::string> givenDests;
+
+  for (unsigned int i = 0; i + 1 < words.size(); ++i) {
+    const std::string & w = words[i];
+    if ( nPending > 0 ) {
+      nPending--;
+      pendPos++;
+      continue;
+    }
+
+    const tokenKind_t kind = classify_token(w.c_str());
+    if ( !bTerminated && kind == TOKEN_TERMINATOR ) {
+      bTerminated = true;
+      continue;
+    }
+
+    if ( !bTerminated && isSwitch(kind) ) {
+      const switchEntry_t * se = findSwitch(w.c_str());
+      if ( se == 0 )
+	continue; /* Unknown or combined switches */
+
+      const Argument & arg = mArgs[se->dest];
+      givenDests.insert(se->dest);
+      if ( arg.getAction() != Argument::STORE_TRUE && 
+	   arg.getAction() != Argument::STORE_FALSE ) {
+	pendDest = se->dest;
+	nPending = arg.getNArgs();
+	pendPos = 0;
+      }
+      continue;
+    }
+
+    if ( ip < pArgs.size() && !mArgs[pArgs[ip]].isRemainder() )
+      ip++;
+  }
+
+  const std::string & cur = words.back();
+
+  /* Acceptance-set members of the argument expecting a value */
+  const std::vector<std::string> * pVals = 0;
+  if ( nPending > 0 ) {
+    ValueIndex::const_iterator vit = valueIndex.find(pendDest);
+    if ( vit != valueIndex.end() )
+      pVals = &(*vit).second[pendPos];
+  }
+  else if ( ip < pArgs.size() && 
+	    (bTerminated || cur.empty() || cur[0] != '-') ) {
+    ValueIndex::const_iterator vit = valueIndex.find(pArgs[ip]);
+    if ( vit != valueIndex.end() )
+      pVals = &(*vit).second[0];
+  }
+
+  if ( pVals != 0 ) {
+    for (std::vector<std::string>::const_iterator it = 
+	   std::lower_bound(pVals->begin(), pVals->end(), cur);
+	 it != pVals->end() && (*it).compare(0, cur.size(), cur) == 0; ++it)
+      cands.push_back(*it);
+  }
+
+  if ( nPending > 0 || bTerminated || !cands.empty() )
+    return cands;
+  if ( !cur.empty() && cur[0] != '-' )
+    return cands;
+
+  /* Switches, except those of arguments already given (unless repeatable) */
+  switchEntry_t key;
+  key.sw = cur;
+  for (std::vector<switchEntry_t>::const_iterator it = 
+	 std::lower_bound(switchIndex.begin(), switchIndex.end(), key);
+       it != switchIndex.end() && (*it).sw.compare(0, cur.size(), cur) == 0;
+       ++it) {
+    if ( givenDests.count((*it).dest) > 0 && 
+	 mArgs[(*it).dest].getAction() != Argument::APPEND )
+      continue;
+    cands.push_back((*it).sw);
+  }
+
+  return cands;
+}
+
+/* Serve a completion query: cmd __complete <words...> */
+ARGPARSE_INLINE
+bool ArgumentParser :: handle_completion(int argc, char ** argv) {
+  if ( argc < 2 || strcmp(argv[1], "__complete") != 0 )
+    return false;
+
+  std::vector<std::string> words(argv + 2, argv + argc);
+  if ( words.empty() )
+    words.push_back("");
+
+  const std::vector<std::string> cands = complete(words);
+  std::string out;
+  for (unsigned int k = 0; k < cands.size(); ++k) {
+    out += cands[k];
+    out += '\n';
+  }
+  std::cout << out << std::flush;
+
+  return true;
+}
+
+/* Completion scripts */
+ARGPARSE_INLINE
+std::string 
+ArgumentParser :: completion_script(const std::string & shell) const {
+  /* Shell function name */
+  std::string fn("_");
+  for (unsigned int k = 0; k < command.size(); ++k)
+    fn += isalnum(static_cast<unsigned char>(command[k])) ? command[k] : '_';
+  fn += "_complete";
+
+  std::ostringstream oss;
+  if ( shell == "bash" ) {
+    oss << fn << "() {\n"
+	<< "  local IFS=$'\\n'\n"
+	<< "  COMPREPLY=( $(" << command 
+	<< " __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null) )\n"
+	<< "}\n"
+	<< "complete -o default -F " << fn << " " << command << "\n";
+  }
+  else if ( shell == "zsh" ) {
+    oss << "#compdef " << command << "\n"
+	<< fn << "() {\n"
+	<< "  local -a cands\n"
+	<< "  cands=(${(f)\"$(" << command 
+	<< " __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)\"})\n"
+	<< "  compadd -a cands\n"
+	<< "}\n"
+	<< "compdef " << fn << " " << command << "\n";
+  }
+  else if ( shell == "fish" ) {
+    oss << "complete -c " << command << " -f -a '(" << command 
+	<< " __complete (commandline -opc)[2..-1] (commandline -ct)"
+	<< " 2>/dev/null)'\n";
+  }
+  else {
+    throw unsupportedShellErr();
+  }
+
+  return oss.str();
+}
+
+/* Figure out which optional argument(s) a switch refers to. 
+   Fills the primary argNames and the destination names (more than one for 
+   combined binary switches) and the number of argument values. */
+ARGPARSE_INLINE void ArgumentParser :: lookupSwitch(const std::string & arg, 
+				    std::vector<std::string> & t_argNames, 
+				    std::vector<std::string> & t_destNames, 
+				    int & nArgs) {
+  const bool bDebug = false;
+
+  std::ostringstream ossErr; /* For holding error information */
+
+  /* Look in the primary argNames */
+  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
+    if ( (*it).second.getArgName() == arg ) {	  
+      nArgs = (*it).second.getNArgs();
+      t_argNames.push_back( (*it).second.getArgName() );
+      t_destNames.push_back( (*it).first );
+      if (bDebug)
+	std::cout << "\tOptional argument: " << (*it).first << "("
+	     << (*it).second.getArgName() 
+	     << "): nargs = " << nArgs << std::endl;
+	  
+      break;
+    }
+  }
+      
+  if ( t_argNames.empty() ) {
+    /* Look in the secondary argNames */
+    for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
+      const std::vector<std::string> & optSwitches = 
+	(*it).second.getOptSwitches();
+      for (std::vector<std::string>::const_iterator osIt = optSwitches.begin();
+	   osIt != optSwitches.end(); ++osIt) {
+	if ( (*osIt) == arg ) {
+	  nArgs = (*it).second.getNArgs();
+	  t_argNames.push_back( (*it).second.getArgName() );
+	  t_destNames.push_back( (*it).first );
+	  if (bDebug) 
+	    std::cout << "\tOptional argument (optional switch): " 
+		 << (*it).first << "("
+		 << (*it).second.getArgName() 
+		 << "): nargs = " << nArgs << std::endl;
+
+	  break;
+	}
+      }
+
+    }
+  }
+
+  if ( t_argNames.empty() && bCombineSwitches ) {
+    /* Try to figure out whether this is a combined switch and if so, 
+       which switches these are */
+    if ( arg.size() < 3 ) {
+      unrecognizedSwitchErr("ERROR: Unrecognized optional argument switch: "
+			    + arg, arg);
+    }
+    if ( arg.find_first_not_of("-") != 1 ) {
+      unrecognizedSwitchErr("ERROR: Unrecognized optional argument switch: "
+			    + arg, arg);
+    }
+
+    std::string cs = std::string(arg, 1, arg.size() - 1);
+    if (bDebug) std::cout << "\tcs = " << cs << std::endl;
+    std::vector<bool> parsed(cs.size(), false);
+
+    /* Look for the individual switches in the primary argNames */
+    for (unsigned int j = 0; j < cs.size(); ++j) {
+      std::string t_arg = std::string("-") + std::string(cs, j, 1);
+      if (bDebug) std::cout << "\tt_arg = " << t_arg << std::endl;
+
+      for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
+	if ( (*it).second.getArgName() == t_arg ) {
+	  if ((*it).second.getAction() != Argument::STORE_TRUE && 
+	      (*it).second.getAction() != Argument::STORE_FALSE) {
+	    ossErr << "ERROR: Non-binary option \"" 
+		   << (*it).second.getArgName() 
+		   << "\" is included in the combined switch \"" 
+		   << arg << "\"";
+	    print_help();
+	    std::cerr << ossErr.str() << std::endl;
+	    throw argParsingErr(ossErr.str());
+	  }
+
+	  nArgs = (*it).second.getNArgs();
+	  t_argNames.push_back( (*it).second.getArgName() );
+	  t_destNames.push_back( (*it).first );
+
+	  parsed[j] = true;
+
+	  if (bDebug)
+	    std::cout << "\tOptional argument (combined): " << (*it).first << "("
+		 << (*it).second.getArgName() 
+		 << "): nargs = " << nArgs << std::endl;
+	      
+	  break;
+	}
+      }
+
+    }
+
+    /* Stipulate that there is no unmatched letters in the 
+       combined switch */
+    if ( std::find(parsed.begin(), parsed.end(), false) != parsed.end() ) {
+      unrecognizedSwitchErr("ERROR: Combined binary switches \"" + arg + 
+			    "\" contains some unrecognized individual switches",
+			    arg);
+    }
+	
+  }
+
+  if ( t_argNames.empty() ) {
+    unrecognizedSwitchErr("ERROR: Unrecognized optional argument switch: " 
+			  + arg, arg);
+  }
+}
+
+/* Number of values that follow a switch (0 for binary switches) */
+ARGPARSE_INLINE int ArgumentParser :: switchValCount(const std::string & arg) {
+  const switchEntry_t * se = findSwitch(arg.c_str());
+  if ( se != 0 ) {
+    const Argument & t_arg = (*mArgs.find(se->dest)).second;
+    if ( t_arg.getAction() == Argument::STORE_TRUE || 
+	 t_arg.getAction() == Argument::STORE_FALSE )
+      return 0;
+    else
+      return t_arg.getNArgs();
+  }
+
+  /* Combined binary switches */
+  std::vector<std::string> t_argNames;
+  std::vector<std::string> t_destNames;
+  int nArgs = 0;
+
+  lookupSwitch(arg, t_argNames, t_destNames, nArgs);
+
+  if ( mArgs[t_destNames[0]].getAction() == Argument::STORE_TRUE || 
+       mArgs[t_destNames[0]].getAction() == Argument::STORE_FALSE )
+    return 0;
+  else
+    return nArgs;
+}
+
+/* Process an optional argument: toks[0] is the switch, and the following 
+   ntoks - 1 tokens are available as its values. 
+   Return value: number of tokens consumed, including the switch itself. 
+   A single known switch is looked up in the switch index and its values 
+   are set directly from toks, without constructing strings for the switch
+   or the argument names. */
+ARGPARSE_INLINE
+int ArgumentParser :: parseOptional(const int ntoks, char ** toks, 
+				     const bool bRaw) {
+  const switchEntry_t * se = findSwitch(toks[0]);
+  if ( se == 0 )
+    return parseCombined(toks[0]);
+
+  Argument & arg = (*mArgs.find(se->dest)).second;
+  const int action = arg.getAction();
+
+  /* Check for repeated setting of an argument */
+  if ( bits_test(argvBits, se->idx) && action != Argument::APPEND ) {
+    std::ostringstream ossErr;
+    ossErr << "ERROR: Repeated setting of optional argument: " 
+	   << arg.getArgName();
+    print_help();
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr(ossErr.str());
+  }
+  bits_set(argvBits, se->idx);
+
+  /* Set the values */
+  if ( action == Argument::STORE_TRUE || action == Argument::STORE_FALSE ) {
+    /* Set binary switch */
+    arg.setVal(std::string(action == Argument::STORE_TRUE ? "true" : "false"));
+    return 1;
+  }
+
+  /* TODO: Check to make sure that the following arguments aren't 
+     switches */
+  const int nArgs = arg.getNArgs();
+  if ( nArgs >= ntoks ) {
+    std::ostringstream ossErr;
+    ossErr << "ERROR: Too few arguments";
+    print_help();
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr(ossErr.str());
+  }
+
+  if ( bRaw ) {
+    /* Lazy conversion */
+    if ( action == Argument::APPEND )
+      arg.appendValRaw(toks + 1, nArgs);
+    else
+      arg.setValRaw(toks + 1, nArgs);
+  }
+  else if ( nArgs == 1 ) {
+    if ( action == Argument::APPEND )
+      arg.appendVal(std::string(toks[1]));
+    else
+      arg.setVal(std::string(toks[1]));
+  }
+  else {
+    if ( action == Argument::APPEND )
+      arg.appendVal(toks + 1, nArgs);
+    else
+      arg.setVal(toks + 1, nArgs);
+  }
+
+  return nArgs + 1; /* The switch itself needs to be skipped as well */
+}
+
+/* Report an unrecognized switch. With suggestions, the help is not 
+   printed. */
+ARGPARSE_INLINE 
+void ArgumentParser :: unrecognizedSwitchErr(const std::string & msg, 
+					     const std::string & arg) {
+  std::ostringstream ossErr;
+  ossErr << msg;
+
+  const std::vector<std::string> sugg = suggest_switches(arg);
+  if ( sugg.empty() ) {
+    print_help();
+  }
+  else {
+    ossErr << " (did you mean ";
+    for (unsigned int i = 0; i < sugg.size(); ++i) {
+      if ( i > 0 )
+	ossErr << ((i + 1 == sugg.size()) ? " or " : ", ");
+      ossErr << sugg[i];
+    }
+    ossErr << "?)";
+  }
+
+  std::cerr << ossErr.str() << std::endl;
+  throw argParsingErr(ossErr.str());
+}
+
+/* Closest known switches, by a search of the BK-tree of the switches */
+ARGPARSE_INLINE std::vector<std::string> 
+ArgumentParser :: suggest_switches(const std::string & sw, 
+				   const unsigned int maxN) {
+  prepareSwitchIndex();
+  if ( !bSwitchTreeBuilt ) {
+    std::vector<std::string> sws(switchIndex.size());
+    for (unsigned int k = 0; k < switchIndex.size(); ++k)
+      sws[k] = switchIndex[k].sw;
+    switchTree.build(sws);
+    bSwitchTreeBuilt = true;
+  }
+
+  const unsigned int maxDist = (sw.size() <= 4) ? 1 : 
+    ((sw.size() <= 8) ? 2 : 3);
+  std::vector<std::pair<unsigned int, unsigned int> > hits;
+  switchTree.search(sw.data(), sw.size(), maxDist, hits);
+
+  /* Nearest first; ties in the order of the switch index */
+  std::sort(hits.begin(), hits.end());
+
+  std::vector<std::string> sugg;
+  std::set<unsigned int> sugIdx; /* Arguments already suggested */
+  for (unsigned int i = 0; i < hits.size() && sugg.size() < maxN; ++i) {
+    const switchEntry_t & se = switchIndex[hits[i].second];
+    if ( sugIdx.insert(se.idx).second )
+      sugg.push_back(se.sw);
+  }
+
+  return sugg;
+}
+
+/* Process combined binary switches (e.g., -cd). Unrecognized switches 
+   are reported by lookupSwitch(). Return value: 1 (token consumed) */
+ARGPARSE_INLINE int ArgumentParser :: parseCombined(const std::string & arg) {
+  std::ostringstream ossErr; /* For holding error information */
+
+  std::vector<std::string> t_argNames;
+  std::vector<std::string> t_destNames;
+  int nArgs = 0;
+
+  lookupSwitch(arg, t_argNames, t_destNames, nArgs);
+      
+  /* Check for repeated setting of an argument */
+  for (unsigned int k = 0; k < t_argNames.size(); ++k) {
+    const unsigned int idx = findSwitch(t_argNames[k].c_str())->idx;
+    if ( bits_test(argvBits, idx) ) {
+      ossErr << "ERROR: Repeated setting of optional argument: " 
+	     << t_argNames[k];
+      print_help();
+      std::cerr << ossErr.str() << std::endl;
+      throw argParsingErr(ossErr.str());
+    }
+    else {
+      bits_set(argvBits, idx);
+    }
+  }
+
+  /* Set the values */
+  for (std::vector<std::string>::iterator dit = t_destNames.begin(); 
+       dit != t_destNames.end(); ++dit) {
+    if ( mArgs[*dit].getAction() == Argument::STORE_TRUE )
+      mArgs[*dit].setVal("true");
+    else if ( mArgs[*dit].getAction() == Argument::STORE_FALSE )
+      mArgs[*dit].setVal("false");
+    else
+      throw unexpectedActionErr();
+  }
+
+  return 1;
+}
+
+/* Whether a token of the given kind is to be taken as a switch */
+ARGPARSE_INLINE bool ArgumentParser :: isSwitch(const tokenKind_t kind) const {
+  if ( kind == TOKEN_NEGATIVE_NUMBER )
+    return bNumericSwitches;
+
+  return kind != TOKEN_VALUE;
+}
+
+/* Process the positional argument at index ip */
+ARGPARSE_INLINE void ArgumentParser :: parsePositional(char ** tok, 
+						      const unsigned int ip) {
+  const bool bDebug = false;
 
-  if ( mArgs[t_dest].isPositional() ) {
-    nPosArgs++;
+  std::ostringstream ossErr; /* For holding error information */
 
-    pArgs.push_back(t_dest); /* Add to the list of positional arguments */
+  if ( ip >= pArgs.size() ) {
+    ossErr << "ERROR: Too many positional arguments (" 
+	   << (ip + 1) << " > " << pArgs.size() << ")" << std::endl;
+    print_help();
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr(ossErr.str());
   }
-  else {
-    nOptArgs++;
 
-    /* Check the duplication of switches */
-    addSwitch(t_argName);
-    for ( std::vector<std::string>::const_iterator aosIt = altOptSwitches.begin(); 
-    	  aosIt != altOptSwitches.end(); ++aosIt)
-      addSwitch(*aosIt);
+  if (bDebug)
+    std::cout << "\tPositional argument: " << pArgs[ip] << std::endl;
+
+  try {
+    if ( bLazyConv )
+      mArgs[pArgs[ip]].setValRaw(tok, 1);
+    else
+      mArgs[pArgs[ip]].setVal(tok, 1);
+  }
+  catch (Argument::setValFailure) {
+    ossErr << "ERROR: Failed to set value of positional argument " 
+	   << pArgs[ip] << " to: " << *tok;
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr();
+  }
+  catch (Argument::valOutsideAcceptanceSet) {
+    ossErr << "ERROR: Value outside acceptance set of positional argument "
+	   << pArgs[ip] << ": " << *tok;
+    std::cerr << ossErr.str() << std::endl;
+    throw argParsingErr();
   }
-  
-  // cout << "nPosArgs = " << nPosArgs << endl; // DEBUG
 
-  if ( !checkSwitches() )
-    throw incompatibleSwitchesErr();
+  if (bDebug)
+    std::cout << "\tValue set" << std::endl;
 }
 
+/* Key operation of ArgumentParser: parse the arguments */
+ARGPARSE_INLINE void ArgumentParser :: parse_args(int argc, char ** argv) {
+  parseArgv(argc, argv, false);
+}
 
-/* Set bCombineSwitches */
-void ArgumentParser :: setCombineSwitches(const bool bcs) {
-  bCombineSwitches = bcs;
+/* Parse the arguments, moving the unrecognized tokens to the front of argv */
+ARGPARSE_INLINE int ArgumentParser :: parse_known_args(int argc, char ** argv) {
+  return parseArgv(argc, argv, true);
 }
 
-/* Check the legality of the switches under bCombineSwitches. 
- Return value: true - OK
-               false - incompatibility found */
-const bool ArgumentParser :: checkSwitches() {
-  if ( bCombineSwitches ) {
-    /* Single-dash BOOL-type switches will be combined */
-    for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
-      if ( (*it).second.getValType() != Argument::VAL_TYPE_BOOL )
-	continue;
-      
-      // cout << (*it).second.getArgName() << endl; // DEBUG
-      if ( (*it).second.getArgName().find_first_not_of("-") != 1 ) {
-	/* Under the combine mode, all boolean switches must be single-dashed 
-	   in its primary argName */
-	throw incompatibleSwitchesErr();
-      }
+/* Whether a token is a known combination of Boolean switches (e.g., -cd) */
+ARGPARSE_INLINE bool ArgumentParser :: isKnownCombined(const char * tok) {
+  if ( !bCombineSwitches || tok[0] != '-' || tok[1] == '-' || 
+       tok[1] == '\0' || tok[2] == '\0' )
+    return false;
+
+  char sw[3] = {'-', '\0', '\0'};
+  for (const char * c = tok + 1; *c != '\0'; ++c) {
+    sw[1] = *c;
+    const switchEntry_t * se = findSwitch(sw);
+    if ( se == 0 )
+      return false;
+
+    const int action = (*mArgs.find(se->dest)).second.getAction();
+    if ( action != Argument::STORE_TRUE && action != Argument::STORE_FALSE )
+      return false;
+  }
 
-      
-    }
-    
-    return true;
+  return true;
+}
+
+/* Body of parse_args() and parse_known_args(), recording the parse if a
+   trace recorder is set */
+ARGPARSE_INLINE 
+int ArgumentParser :: parseArgv(int argc, char ** argv, const bool bKnown) {
+  if ( traceRec == 0 )
+    return parseTokens(argc, argv, bKnown);
+
+  /* The tokens are recorded first, as parse_known_args() moves them */
+  ParseTrace::record_t rec;
+  ParseTrace::begin(rec, argc, argv);
+  if ( bLazyConv )
+    rec.flags |= ParseTrace::TRACE_LAZY;
+  if ( bKnown )
+    rec.flags |= ParseTrace::TRACE_KNOWN;
+
+  const unsigned long long t0 = ParseTrace::clock_ns();
+  traceLoopNs = 0;
+  int n = 0;
+  try {
+    n = parseTokens(argc, argv, bKnown);
   }
-  else {
-    return true;
+  catch (const argParsingErr & err) {
+    ParseTrace::setError(rec, err.getErrMsg());
+    appendTrace(rec, t0);
+    throw;
+  }
+  catch (Argument::valOutsideAcceptanceSet) {
+    ParseTrace::setError(rec, "Value outside acceptance set");
+    appendTrace(rec, t0);
+    throw;
+  }
+  catch (...) {
+    ParseTrace::setError(rec, "(exception)");
+    appendTrace(rec, t0);
+    throw;
   }
 
+  appendTrace(rec, t0);
+  return n;
 }
 
-/* Operator for allowing access to member arguments */
-Argument & ArgumentParser :: operator[](const std::string t_dest) {
-  /* Test if argument exists */
-  if ( mArgs.count(t_dest) == 0 )
-    throw argNotFoundErr();
+/* Complete a record of a parse started at clock t0 and append it */
+ARGPARSE_INLINE void ArgumentParser :: appendTrace(ParseTrace::record_t & rec,
+						   const unsigned long long t0) {
+  const unsigned long long t1 = ParseTrace::clock_ns();
+  const unsigned long long tl = (traceLoopNs != 0) ? traceLoopNs : t1;
+  rec.parseNs = static_cast<unsigned int>(tl - t0);
+  rec.checkNs = static_cast<unsigned int>(t1 - tl);
+
+  rec.nArgs = (mArgs.size() < 0xffff) ? mArgs.size() : 0xffff;
+  if ( mArgs.size() > ParseTrace::MAX_TRACE_ARGS )
+    rec.flags |= ParseTrace::TRACE_MANY_ARGS;
+
+  /* Words of argvBits and envBits have 64 bits (LP64) or 32 */
+  const unsigned int wb = 8 * sizeof(unsigned long);
+  for (size_t k = 0; k < argvBits.size() && k * wb < 
+	 ParseTrace::MAX_TRACE_ARGS; ++k) {
+    const unsigned int sh = k * wb % 64;
+    rec.argvBits[k * wb / 64] |= 
+      static_cast<unsigned long long>(argvBits[k]) << sh;
+    rec.envBits[k * wb / 64] |= 
+      static_cast<unsigned long long>(envBits[k]) << sh;
+  }
 
-  return mArgs[t_dest];
+  traceRec->append(rec);
 }
 
-/* Key operation of ArgumentParser: parse the arguments */
-void ArgumentParser :: parse_args(int argc, char ** argv) {
+ARGPARSE_INLINE void ArgumentParser :: setTraceRecorder(ParseTrace * rec) {
+  traceRec = rec;
+  if ( rec == 0 )
+    return;
+
+  std::vector<std::string> names;
+  names.reserve(mArgs.size());
+  for (AMapItC it = mArgs.begin(); it != mArgs.end(); ++it)
+    names.push_back(it->first);
+  rec->setArgNames(names);
+}
+
+/* Parse the tokens. Under bKnown, unrecognized switches and surplus 
+   positional values are skipped, and moved to argv[1..n] afterwards. 
+   Return value: n */
+ARGPARSE_INLINE 
+int ArgumentParser :: parseTokens(int argc, char ** argv, const bool bKnown) {
   const bool bDebug = false;
   
-  ostringstream ossErr; /* For holding error information */
+  std::ostringstream ossErr; /* For holding error information */
 
   unsigned int ip = 0; /* index to positional arguments */
-  vector<int> bPosSet(pArgs.size(), 0); /* Flags for indicating whether the positional arguments have been set */
-  set<string> setOpts; 
-  /* A set of optional arguments already set. This is used for preventing
-     repeated setting of the same optional argument. */  
+
+  prepareSwitchIndex();
+  std::fill(argvBits.begin(), argvBits.end(), 0);
+  std::fill(envBits.begin(), envBits.end(), 0);
+  /* Values appended in an earlier parse are replaced, not added to */
+  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it)
+    if ( (*it).second.action == Argument::APPEND )
+      (*it).second.resetAppended();
+
+  /* Classify all tokens up front. Small command lines use a buffer on the
+     stack. */
+  const int nKindBuf = 256;
+  unsigned char kindBuf[nKindBuf];
+  std::vector<unsigned char> kindVec;
+  unsigned char * kinds = kindBuf;
+  if ( argc > nKindBuf ) {
+    kindVec.resize(argc);
+    kinds = &kindVec[0];
+  }
+  classify_tokens(argc, argv, kinds);
+  const unsigned char KIND_UNKNOWN = 0xff; /* Mark of unrecognized tokens */
+
+  /* Variadic trailing positional argument, if any */
+  Argument * remArg = 0;
+  if ( !pArgs.empty() && mArgs[pArgs.back()].isRemainder() )
+    remArg = &mArgs[pArgs.back()];
+  const unsigned int nFixedPos = pArgs.size() - (remArg ? 1 : 0);
+
+  bool bTerminated = false; /* Whether -- has been seen */
 
   int i = 1;  /* Skip the initial program name */
   while (i < argc) {
-    string arg(argv[i]);
-
     if (bDebug)
-      cout << "Processing argument: " << arg << endl;
+      std::cout << "Processing argument: " << argv[i] << std::endl;
+
+    const tokenKind_t kind = static_cast<tokenKind_t>(kinds[i]);
+    if ( !bTerminated && kind == TOKEN_TERMINATOR ) {
+      /* End of optional arguments: all following tokens are positional */
+      bTerminated = true;
+      i++;
+    }
+    else if ( !bTerminated && isSwitch(kind) ) { 
+      if ( bKnown && findSwitch(argv[i]) == 0 && 
+	   !isKnownCombined(argv[i]) ) {
+	kinds[i++] = KIND_UNKNOWN;
+	continue;
+      }
 
-    if ( arg.size() > 1 && arg[0] == '-' ) { 
       /* Optional argument */
-      /* Figure out what optinal argument this is */
-      vector<string> t_argNames;
-      vector<string> t_destNames;
-      int nArgs = 0;
+      i += parseOptional(argc - i, argv + i, bLazyConv);
+    }
+    else if ( remArg != 0 && ip >= nFixedPos ) {
+      /* The remaining tokens go to the variadic positional argument, 
+	 as a single span */
+      remArg->setRemainder(argv + i, argc - i);
+      i = argc;
+    }
+    else if ( bKnown && ip >= pArgs.size() ) {
+      /* Surplus positional value */
+      kinds[i++] = KIND_UNKNOWN;
+    }
+    else {
+      /* Positional argument */
+      parsePositional(argv + i, ip);
 
-      /* Look in the primary argNames */
-      for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
-	if ( (*it).second.getArgName() == arg ) {	  
-	  nArgs = (*it).second.getNArgs();
-	  t_argNames.push_back( (*it).second.getArgName() );
-	  t_destNames.push_back( (*it).first );
-	  if (bDebug)
-	    cout << "\tOptional argument: " << (*it).first << "("
-		 << (*it).second.getArgName() 
-		 << "): nargs = " << nArgs << endl;
-	  
-	  break;
-	}
-      }
-      
-      if ( t_argNames.empty() ) {
-	/* Look in the secondary argNames */
-	for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
-	  vector<string> optSwitches = (*it).second.getOptSwitches();
-	  for (vector<string>::iterator osIt = optSwitches.begin();
-	       osIt != optSwitches.end(); ++osIt) {
-	    if ( (*osIt) == arg ) {
-	      nArgs = (*it).second.getNArgs();
-	      t_argNames.push_back( (*it).second.getArgName() );
-	      t_destNames.push_back( (*it).first );
-	      if (bDebug) 
-		cout << "\tOptional argument (optional switch): " 
-		     << (*it).first << "("
-		     << (*it).second.getArgName() 
-		     << "): nargs = " << nArgs << endl;
-
-	      break;
-	    }
-	  }
+      ip++;
+      i++;
+    }
 
-	}
-      }
+  }
 
-      if ( t_argNames.empty() && bCombineSwitches ) {
-	/* Try to figure out whether this is a combined switch and if so, 
-	   which switches these are */
-	if ( arg.size() < 3 ) {
-	  ossErr << "ERROR: Unrecognized optional argument switch: " << arg;
-	  print_help();
-	  cerr << ossErr.str() << endl;
-	  throw argParsingErr(ossErr.str());
-	}
-	if ( arg.find_first_not_of("-") != 1 ) {
-	  ossErr << "ERROR: Unrecognized optional argument switch: " << arg;
-	  print_help();
-	  cerr << ossErr.str() << endl;
-	  throw argParsingErr(ossErr.str());
-	}
+  if ( remArg != 0 && !remArg->set() )
+    remArg->setRemainder(argv + argc, 0);
 
-	string cs = string(arg, 1, arg.size() - 1);
-	if (bDebug) cout << "\tcs = " << cs << endl;
-	vector<bool> parsed(cs.size(), false);
+  if ( traceRec != 0 )
+    traceLoopNs = ParseTrace::clock_ns();
 
-	/* Look for the individual switches in the primary argNames */
-	for (unsigned int j = 0; j < cs.size(); ++j) {
-	  string t_arg = string("-") + string(cs, j, 1);
-	  if (bDebug) cout << "\tt_arg = " << t_arg << endl;
+  /* Environment-variable fallbacks for arguments absent from argv */
+  applyEnvFallbacks();
 
-	  for (AMapIt it = mArgs.begin(); it != mArgs.end(); ++it) {
-	    if ( (*it).second.getArgName() == t_arg ) {
-	      if ((*it).second.getAction() != Argument::STORE_TRUE && 
-		  (*it).second.getAction() != Argument::STORE_FALSE) {
-	      	ossErr << "ERROR: Non-binary option \"" 
-	      	       << (*it).second.getArgName() 
-	      	       << "\" is included in the combined switch \"" 
-	      	       << arg << "\"";
-	      	print_help();
-	      	cerr << ossErr.str() << endl;
-	      	throw argParsingErr(ossErr.str());
-	      }
+  /* Make sure that all positional arguments are set */
+  for (unsigned int k = ip; k < pArgs.size(); ++k) {
+    if ( !mArgs[pArgs[k]].set() ) {
+      ossErr << "ERROR: one or more positional arguments are not set.";
+      print_help();
+      std::cerr << ossErr.str() << std::endl;
+      throw argParsingErr(ossErr.str());
+    }
+  }
 
-	      nArgs = (*it).second.getNArgs();
-	      t_argNames.push_back( (*it).second.getArgName() );
-	      t_destNames.push_back( (*it).first );
+  checkConstraints();
 
+  runValidators();
 
+  bParsed = true;
 
-	      parsed[j] = true;
+  if ( !bKnown )
+    return 0;
 
-	      if (bDebug)
-		cout << "\tOptional argument (combined): " << (*it).first << "("
-		     << (*it).second.getArgName() 
-		     << "): nargs = " << nArgs << endl;
-	      
-	      break;
-	    }
-	  }
+  /* Move the unrecognized tokens to argv[1..n], in order. The slots of the 
+     recognized tokens before them are free, since their values have been 
+     copied (or, under lazy conversion, their pointers). */
+  int n = 0;
+  for (int k = 1; k < argc; ++k)
+    if ( kinds[k] == KIND_UNKNOWN )
+      argv[++n] = argv[k];
+
+  /* The terminating null pointer must not overwrite the variadic 
+     positional argument, which stays in place at the end of argv: if it 
+     follows the unrecognized tokens directly, it is moved into argv[argc] */
+  if ( remArg != 0 && remArg->getRemainderArgc() > 0 && 
+       remArg->getRemainderArgv() == argv + n + 1 ) {
+    const int nRem = remArg->getRemainderArgc();
+    memmove(argv + n + 2, argv + n + 1, nRem * sizeof(char *));
+    remArg->setRemainder(argv + n + 2, nRem);
+  }
+  argv[n + 1] = 0;
 
-	}
+  return n;
+}
 
-	/* Stipulate that there is no unmatched letters in the 
-	   combined switch */
-	if ( find(parsed.begin(), parsed.end(), false) != parsed.end() ) {
-	  ossErr << "ERROR: Combined binary switches \"" << arg
-	       << "\" contains some unrecognized individual switches";
-	  print_help();
-	  cerr << ossErr.str() << endl;
-	  throw argParsingErr(ossErr.str());
-	}
-	
-      }
-      
-      /* Check for repeated setting of an argument */
-      for (vector<string>::iterator ait = t_argNames.begin();
-	   ait != t_argNames.end(); ++ait) {
-	if ( setOpts.count(*ait) == 1 ) {
-	  ossErr << "ERROR: Repeated setting of optional argument: " << *ait;
-	  print_help();
-	  cerr << ossErr.str() << endl;
-	  throw argParsingErr(ossErr.str());
-	}
-	else {
-	  setOpts.insert(*ait);
-	}
-      }
-      
-      if ( t_argNames.empty() ) {
-	ossErr << "ERROR: Unrecognized optional argument switch: " << arg;
-	print_help();
-	cerr << ossErr.str() << endl;
-	throw argParsingErr(ossErr.str());
-      }
+/* Streaming parse of argument tokens read from a file descriptor */
+ARGPARSE_INLINE void ArgumentParser :: parse_stream(const int fd, 
+				    posBatchCallback_t callback, 
+				    void * userData, 
+				    const char delim, 
+				    const unsigned int batchSize) {
+  const size_t bufSize = 65536; /* Read buffer size = maximum token length */
 
-      for (vector<string>::iterator dit = t_destNames.begin(); 
-	   dit != t_destNames.end(); ++dit) {
-	if (bDebug) cout << "\taction = " 
-			 << mArgs[*dit].getAction() << endl;
-      }
+  std::ostringstream ossErr; /* For holding error information */
 
-      /* Set the values */
-      if ( t_destNames.size() > 1 ) {
-	/* Combined binary switches */
-	for (vector<string>::iterator dit = t_destNames.begin(); 
-	     dit != t_destNames.end(); ++dit) {
-	  if ( mArgs[*dit].getAction() == Argument::STORE_TRUE )
-	    mArgs[*dit].setVal("true");
-	  else if ( mArgs[*dit].getAction() == Argument::STORE_FALSE )
-	    mArgs[*dit].setVal("false");
-	  else
-	    throw unexpectedActionErr();
+  if ( callback == 0 || batchSize == 0 )
+    throw streamReadErr();
 
-	}
+  prepareSwitchIndex();
 
-      }
-      else if ( mArgs[t_destNames[0]].getAction() == Argument::STORE_TRUE || 
-		mArgs[t_destNames[0]].getAction() == Argument::STORE_FALSE ) {
-	/* Set binary switch */
-	if ( mArgs[t_destNames[0]].getAction() == Argument::STORE_TRUE )
-	  mArgs[t_destNames[0]].setVal("true");
-	else
-	  mArgs[t_destNames[0]].setVal("false");
+  std::vector<char> buf(bufSize);
+  size_t beg = 0; /* Start of the unprocessed input in buf */
+  size_t end = 0; /* End of the input in buf */
+  bool bEOF = false;
 
-      }
-      else {
-	/* TODO: Check to make sure that the following arguments aren't 
-	   switches */
-	if ( nArgs == 1 ) {
-	  if ( i + 1 >= argc ) {
-	    ossErr << "ERROR: Too few arguments";
-	    print_help();
-	    cerr << ossErr.str() << endl;
-	    throw argParsingErr(ossErr.str());
-	  }
+  /* Positional values not yet handed to callback */
+  std::vector<std::string> batch;
+  batch.reserve(batchSize);
+
+  /* Switch whose values haven't all arrived yet */
+  std::vector<std::string> pending;
+  int nPending = 0;       /* Number of values still to arrive */
 
-	  if (bDebug) cout << "\tSetting val using string \"" 
-			   << string(argv[i + 1]) << "\"" << endl;
-	  mArgs[t_destNames[0]].setVal(string(argv[i + 1]));
+  /* Per argument (by index in mArgs), the first of the values set from the
+     stream, which are validated at the end */
+  std::vector<unsigned int> from(mArgs.size(), noValidation);
+
+  bool bTerminated = false; /* Whether -- has been seen */
+
+  while ( true ) {
+    const char * d = (end > beg) ? 
+      static_cast<const char *>(memchr(&buf[beg], delim, end - beg)) : 0;
+
+    size_t len;
+    if ( d == 0 ) {
+      if ( !bEOF ) {
+	/* Move the partial token to the front and read more input */
+	if ( beg > 0 ) {
+	  memmove(&buf[0], &buf[beg], end - beg);
+	  end -= beg;
+	  beg = 0;
 	}
-	else {
-	  vector<string> valStrs;
-	  valStrs.reserve(nArgs);
-	  for (int k = 0; k < nArgs; k++) {
-	    if (i + k + 1 >= argc) {
-	      ossErr << "ERROR: Too few arguments";
-	      print_help();
-	      cerr << ossErr.str() << endl;
-	      throw argParsingErr(ossErr.str());
-	    }
-
-	    valStrs.push_back(string(argv[i + k + 1]));	    
-	  }
 
-	  mArgs[t_destNames[0]].setVal(valStrs);
+	if ( end == bufSize ) {
+	  ossErr << "ERROR: Token in input stream exceeds " << bufSize 
+		 << " characters";
+	  std::cerr << ossErr.str() << std::endl;
+	  throw argParsingErr(ossErr.str());
 	}
-      }
 
-      if ( mArgs[t_destNames[0]].getAction() == Argument::STORE_TRUE || 
-	   mArgs[t_destNames[0]].getAction() == Argument::STORE_FALSE ) {
-	if ( bDebug ) cout << "\tSkipping 0 arg" << endl;
-	i += 1;
-      }
-      else {
-	if ( bDebug ) cout << "\tSkipping " << nArgs << " args" << endl;
-	i += (nArgs + 1); /* The switch itself needs to be skipped as well */
+	ssize_t nr = read(fd, &buf[end], bufSize - end);
+	if ( nr < 0 ) {
+	  if ( errno == EINTR )
+	    continue;
+	  throw streamReadErr();
+	}
+
+	if ( nr == 0 )
+	  bEOF = true;
+	end += nr;
+	continue;
       }
+
+      if ( beg == end )
+	break;
+      len = end - beg; /* Last token, without a trailing delimiter */
     }
     else {
-      /* Positional argument */
-      if ( ip >= pArgs.size() ) {
-	ossErr << "ERROR: Too many positional arguments (" 
-	     << (ip + 1) << " > " << pArgs.size() << ")" << endl;
-	print_help();
-	cerr << ossErr.str() << endl;
-	throw argParsingErr(ossErr.str());
-      }
+      len = d - &buf[beg];
+    }
 
-      if (bDebug)
-	cout << "\tPositional argument: " << pArgs[ip] << endl;
+    std::string tok(&buf[beg], len);
+    beg = (d == 0) ? end : beg + len + 1;
 
-      try {
-	mArgs[pArgs[ip]].setVal(arg);
-      }
-      catch (Argument::setValFailure) {
-	ossErr << "ERROR: Failed to set value of positional argument " 
-	     << pArgs[ip] << " to: " << arg;
-	cerr << ossErr.str() << endl;
-	throw argParsingErr();
-      }
-      catch (Argument::valOutsideAcceptanceSet) {
-	ossErr << "ERROR: Value outside acceptance set of positional argument "
-	       << pArgs[ip] << ": " << arg;
-	cerr << ossErr.str() << endl;
-	throw argParsingErr();
+    if ( nPending > 0 ) {
+      /* Value of the pending switch */
+      pending.push_back(tok);
+      nPending--;
+    }
+    else if ( !bTerminated && 
+	      classify_token(tok.c_str()) == TOKEN_TERMINATOR ) {
+      /* End of optional arguments: all following tokens are positional */
+      bTerminated = true;
+      continue;
+    }
+    else if ( !bTerminated && isSwitch(classify_token(tok.c_str())) ) {
+      /* Optional argument */
+      nPending = switchValCount(tok);
+      pending.assign(1, tok);
+      markStreamSet(tok, from);
+    }
+    else {
+      /* Positional argument */
+      batch.push_back(tok);
+      if ( batch.size() >= batchSize ) {
+	callback(batch, userData);
+	batch.clear();
       }
+      continue;
+    }
 
-      if (bDebug)
-	cout << "\tValue set" << endl;
+    if ( nPending == 0 ) {
+      std::vector<char *> toks(pending.size());
+      for (unsigned int k = 0; k < pending.size(); ++k)
+	toks[k] = &pending[k][0];
 
-      ip++;
-      i++;
+      parseOptional(toks.size(), &toks[0], false);
+      pending.clear();
     }
-
   }
 
-  /* Make sure that all positional arguments are set */
-  if ( static_cast<int>(ip) < nPosArgs ) {
-    ossErr << "ERROR: one or more positional arguments are not set.";
+  if ( nPending > 0 ) {
+    ossErr << "ERROR: Too few arguments";
     print_help();
-    cerr << ossErr.str() << endl;
+    std::cerr << ossErr.str() << std::endl;
     throw argParsingErr(ossErr.str());
   }
 
+  if ( !batch.empty() )
+    callback(batch, userData);
+
+  checkConstraints();
+
+  runValidators(&from);
+}
+
+/* Record in from the first value that a switch read by parse_stream() 
+   sets, for the arguments not recorded yet: values appended to those 
+   given in argv or the environment follow them; other values replace the
+   earlier ones */
+ARGPARSE_INLINE 
+void ArgumentParser :: markStreamSet(const std::string & tok, 
+				     std::vector<unsigned int> & from) {
+  std::vector<std::string> t_destNames;
+  const switchEntry_t * se = findSwitch(tok.c_str());
+  if ( se != 0 ) {
+    t_destNames.push_back(se->dest);
+  }
+  else {
+    /* Combined binary switches */
+    std::vector<std::string> t_argNames;
+    int nArgs = 0;
+    lookupSwitch(tok, t_argNames, t_destNames, nArgs);
+  }
+
+  for (unsigned int k = 0; k < t_destNames.size(); ++k) {
+    AMapIt it = mArgs.find(t_destNames[k]);
+    const unsigned int idx = std::distance(mArgs.begin(), it);
+    if ( it == mArgs.end() || from[idx] != noValidation )
+      continue;
+
+    const Argument & arg = (*it).second;
+    from[idx] = (arg.getAction() == Argument::APPEND && isGiven(idx)) ? 
+      arg.getNVals() : 0;
+  }
 }
 
 /* ArgumentParser: Get help string 
  Input arguments: cw - console width 
                   lw - left white-space width */
-string ArgumentParser :: getHelpString(const int cw, const int lw) const {
-  ostringstream oss;
+ARGPARSE_INLINE
+std::string ArgumentParser :: getHelpString(const int cw, const int lw) const {
+  std::ostringstream oss;
 
   oss << "Usage: " << command << " ";
   int lw0 = oss.str().size();
 
-  ostringstream ossArgs;
+  std::ostringstream ossArgs;
   for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit) {
     /* Print all optinal arguments */
     if ( !((*amit).second.isPositional()) ) {
@@ -1247,7 +4060,8 @@ string ArgumentParser :: getHelpString(const int cw, const int lw) const {
 	  ossArgs << (i + 1);
 
 	if ( i == t_nargs - 1)
-	  ossArgs << "] ";
+	  ossArgs << (((*amit).second.getAction() == Argument::APPEND) ? 
+		      "]... " : "] ");
 	else
 	  ossArgs << " ";
       }
@@ -1259,14 +4073,14 @@ string ArgumentParser :: getHelpString(const int cw, const int lw) const {
     oss << ossArgs.str();
   }
   else {
-    string strArgsFmt = lineFormat(ossArgs.str(), cw, lw0);
+    std::string strArgsFmt = lineFormat(ossArgs.str(), cw, lw0);
     oss << strArgsFmt.substr(lw0, strArgsFmt.size() - lw0);
   }
 
   /* Print all positional arguments */
-  for (deque<string>::const_iterator pait = pArgs.begin();
+  for (std::deque<std::string>::const_iterator pait = pArgs.begin();
        pait != pArgs.end(); ++pait)
-    oss << *pait << " ";
+    oss << *pait << (mArgs.at(*pait).isRemainder() ? "... " : " ");
 
   /* Print description */
   oss << "\n\n" << lineFormat(description, cw, 0) << "\n\n";
@@ -1275,7 +4089,7 @@ string ArgumentParser :: getHelpString(const int cw, const int lw) const {
   if (nPosArgs > 0) {
     oss << "Positional arguments: \n";
 
-    for (deque<string>::const_iterator pait = pArgs.begin(); 
+    for (std::deque<std::string>::const_iterator pait = pArgs.begin(); 
     	 pait != pArgs.end(); ++pait)
       oss << mArgs.at(*pait).getHelpString(cw, lw, *pait) << "\n";
    
@@ -1297,6 +4111,449 @@ string ArgumentParser :: getHelpString(const int cw, const int lw) const {
 } 
 
 /* ArgumentParser: Print help */
-void ArgumentParser :: print_help() const {
-  cout << getHelpString(80, 24) << "\n";
+ARGPARSE_INLINE void ArgumentParser :: print_help() const {
+  std::cout << getHelpString(80, 24) << "\n";
+}
+
+/* ArgumentParser: heap memory used by the parser. The argument objects 
+   themselves are held in the nodes of the argument map, and are counted 
+   under indices. */
+ARGPARSE_INLINE Argument::memUsage_t ArgumentParser :: getMemUsage() const {
+  Argument::memUsage_t mu;
+
+  mu.names = string_heap_bytes(command) + string_heap_bytes(description) 
+    + string_heap_bytes(envPrefix);
+
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit) {
+    mu += (*amit).second.getMemUsage();
+    mu.names += string_heap_bytes((*amit).first);
+  }
+  mu.indices += mArgs.size() * (rbNodeHeader + sizeof(ArgumentMap::value_type));
+
+  mu.indices += (argvBits.capacity() + envBits.capacity()) 
+    * sizeof(unsigned long);
+
+  mu.lists = deque_heap_bytes(pArgs) + deque_heap_bytes(sdSwitches) 
+    + deque_heap_bytes(ddSwitches);
+  mu.lists += constraints.capacity() * sizeof(constraint_t);
+  for (unsigned int i = 0; i < constraints.size(); ++i) {
+    mu.names += string_heap_bytes(constraints[i].subject) 
+      + vector_heap_bytes(constraints[i].members);
+    mu.indices += constraints[i].mask.capacity() * sizeof(unsigned long);
+  }
+
+  mu.indices += switchIndex.capacity() * sizeof(switchEntry_t);
+  for (unsigned int i = 0; i < switchIndex.size(); ++i)
+    mu.indices += string_heap_bytes(switchIndex[i].sw) 
+      + string_heap_bytes(switchIndex[i].dest);
+  mu.indices += switchTree.memUsage();
+  for (ValueIndex::const_iterator vit = valueIndex.begin(); 
+       vit != valueIndex.end(); ++vit) {
+    mu.indices += rbNodeHeader + sizeof(ValueIndex::value_type) 
+      + string_heap_bytes((*vit).first) 
+      + (*vit).second.capacity() * sizeof(std::vector<std::string>);
+    for (unsigned int k = 0; k < (*vit).second.size(); ++k)
+      mu.indices += vector_heap_bytes((*vit).second[k]);
+  }
+
+  return mu;
+}
+
+/* Parse results blob: 
+     magic "APRS", format version, number of arguments, 
+     then for each argument: destination name, packed values */
+static const char resultsMagic[] = "APRS";
+static const unsigned int resultsVersion = 1;
+
+/* ArgumentParser: serialize the parse results */
+ARGPARSE_INLINE std::string ArgumentParser :: dump_results() const {
+  std::string blob(resultsMagic, 4);
+  pack_uint32(blob, resultsVersion);
+  pack_uint32(blob, mArgs.size());
+
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit) {
+    pack_string(blob, (*amit).first);
+    (*amit).second.packVals(blob);
+  }
+
+  return blob;
+}
+
+/* ArgumentParser: load parse results. The schema (names and value types 
+   of the arguments) must be the same as that of the dumping parser. */
+ARGPARSE_INLINE void ArgumentParser :: load_results(const std::string & blob) {
+  load_results(blob.data(), blob.size());
+}
+
+ARGPARSE_INLINE
+void ArgumentParser :: load_results(const char * buf, const size_t n) {
+  size_t pos = 0;
+
+  if ( n < 4 || memcmp(buf, resultsMagic, 4) != 0 )
+    throw resultsFormatErr();
+  pos += 4;
+
+  /* The whole blob is checked first (every argument once, well-formed 
+     values, no trailing bytes), so that a bad blob leaves the parser 
+     unchanged; the values are then stored in a second pass */
+  std::vector<AMapIt> order;
+  order.reserve(mArgs.size());
+  const size_t pos0 = pos + 8;
+  try {
+    if ( unpack_uint32(buf, n, pos) != resultsVersion )
+      throw resultsFormatErr();
+
+    if ( unpack_uint32(buf, n, pos) != mArgs.size() )
+      throw resultsFormatErr();
+
+    std::vector<bool> seen(mArgs.size(), false);
+    for (unsigned int k = 0; k < mArgs.size(); ++k) {
+      AMapIt amit = mArgs.find(unpack_string(buf, n, pos));
+      if ( amit == mArgs.end() )
+	throw resultsFormatErr();
+      const unsigned int idx = std::distance(mArgs.begin(), amit);
+      if ( seen[idx] )
+	throw resultsFormatErr();
+      seen[idx] = true;
+
+      (*amit).second.unpackVals(buf, n, pos, false);
+      order.push_back(amit);
+    }
+  }
+  catch (unpackErr) {
+    throw resultsFormatErr();
+  }
+  catch (Argument::valTypeErr) {
+    throw resultsFormatErr();
+  }
+
+  if ( pos != n )
+    throw resultsFormatErr();
+
+  pos = pos0;
+  for (unsigned int k = 0; k < order.size(); ++k) {
+    unpack_string(buf, n, pos);
+    (*order[k]).second.unpackVals(buf, n, pos);
+  }
+
+  bParsed = true;
+}
+
+/* ArgumentParser: save the parse results to a file */
+ARGPARSE_INLINE
+void ArgumentParser :: save_results(const std::string & fileName) const {
+  std::string blob = dump_results();
+
+  std::ofstream ofs(fileName.c_str(), 
+		    std::ios::out | std::ios::binary | std::ios::trunc);
+  if ( !ofs.write(blob.data(), blob.size()) )
+    throw resultsFileErr();
+}
+
+/* ArgumentParser: load the parse results from a file */
+ARGPARSE_INLINE
+void ArgumentParser :: load_results_file(const std::string & fileName) {
+  size_t n = 0;
+  const char * p = map_file(fileName, n);
+  if ( p == 0 )
+    throw resultsFileErr();
+
+  try {
+    load_results(p, n);
+  }
+  catch (...) {
+    unmap_file(p, n);
+    throw;
+  }
+  unmap_file(p, n);
+}
+
+/* ArgumentParser: export of the effective configuration as text */
+ARGPARSE_INLINE
+void ArgumentParser :: exportConfig(OutputSink & out, const bool bJson) const {
+  if ( bJson )
+    out.put('{');
+
+  unsigned int idx = 0;
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit, ++idx) {
+    const std::string & dest = (*amit).first;
+    const Argument & arg = (*amit).second;
+
+    /* Positional arguments are not in argvBits */
+    const char * source = "none";
+    if ( bits_test(envBits, idx) )
+      source = "env";
+    else if ( bits_test(argvBits, idx) || (arg.set() && arg.isPositional()) )
+      source = "argv";
+    else if ( arg.set() )
+      source = "default";
+
+    if ( bJson ) {
+      if ( idx > 0 )
+	out.put(',');
+      out.putJsonString(dest.data(), dest.size());
+      out.put(":{\"type\":\"", 10);
+      out.put(arg.getValTypeName());
+      out.put("\",\"source\":\"", 12);
+      out.put(source);
+      out.put("\",\"value\":", 10);
+      arg.exportVals(out, true);
+      out.put('}');
+    }
+    else {
+      if ( arg.set() ) {
+	out.put(dest.data(), dest.size());
+	out.put('=');
+	arg.exportVals(out, false);
+	out.put('\n');
+      }
+      out.put(dest.data(), dest.size());
+      out.put(".source=", 8);
+      out.put(source);
+      out.put('\n');
+    }
+  }
+
+  if ( bJson )
+    out.put("}\n", 2);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: export_json(std::string & buf) const {
+  OutputSink out(buf);
+  exportConfig(out, true);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: export_json(const int fd) const {
+  OutputSink out(fd);
+  exportConfig(out, true);
+  if ( !out.flush() )
+    throw exportErr();
+}
+
+ARGPARSE_INLINE void ArgumentParser :: export_kv(std::string & buf) const {
+  OutputSink out(buf);
+  exportConfig(out, false);
+}
+
+ARGPARSE_INLINE void ArgumentParser :: export_kv(const int fd) const {
+  OutputSink out(fd);
+  exportConfig(out, false);
+  if ( !out.flush() )
+    throw exportErr();
+}
+
+/* Schema snapshot: 
+     magic "APSS", format version, FNV-1a hash of everything after the hash,
+     source tag, then the parser fields, the switch lookup lists, the 
+     packed argument definitions, the constraints, the switch index and the
+     completion index of values (so that neither parsing nor completion 
+     queries need sorting at startup) */
+static const char schemaMagic[] = "APSS";
+static const unsigned int schemaVersion = 9;
+
+/* ArgumentParser: freeze the schema into a binary snapshot */
+ARGPARSE_INLINE
+std::string ArgumentParser :: dump_schema(const std::string & sourceTag) const {
+  std::string body;
+  pack_string(body, sourceTag);
+  pack_string(body, command);
+  pack_string(body, description);
+  pack_uint32(body, bCombineSwitches ? 1 : 0);
+  pack_uint32(body, bLazyConv ? 1 : 0);
+  pack_string(body, envPrefix);
+  pack_uint32(body, nPosArgs);
+  pack_uint32(body, nOptArgs);
+  pack_uint32(body, nSLS);
+
+  pack_strings(body, std::vector<std::string>(pArgs.begin(), pArgs.end()));
+  pack_strings(body, 
+	       std::vector<std::string>(sdSwitches.begin(), sdSwitches.end()));
+  pack_strings(body, 
+	       std::vector<std::string>(ddSwitches.begin(), ddSwitches.end()));
+
+  pack_uint32(body, mArgs.size());
+  for (AMapItC amit = mArgs.begin(); amit != mArgs.end(); ++amit) {
+    pack_string(body, (*amit).first);
+    (*amit).second.packSchema(body);
+  }
+
+  pack_uint32(body, constraints.size());
+  for (unsigned int i = 0; i < constraints.size(); ++i) {
+    pack_uint32(body, constraints[i].type);
+    pack_string(body, constraints[i].subject);
+    pack_strings(body, constraints[i].members);
+  }
+
+  std::vector<switchEntry_t> t_switchIndex;
+  ValueIndex t_valueIndex;
+  if ( !bSwitchIndexBuilt )
+    buildSwitchIndex(t_switchIndex);
+  if ( !bValueIndexBuilt )
+    buildValueIndex(t_valueIndex);
+  const std::vector<switchEntry_t> & sws = 
+    bSwitchIndexBuilt ? switchIndex : t_switchIndex;
+  const ValueIndex & vals = bValueIndexBuilt ? valueIndex : t_valueIndex;
+
+  pack_uint32(body, sws.size());
+  for (unsigned int i = 0; i < sws.size(); ++i) {
+    pack_string(body, sws[i].sw);
+    pack_string(body, sws[i].dest);
+    pack_uint32(body, sws[i].idx);
+  }
+  pack_uint32(body, vals.size());
+  for (ValueIndex::const_iterator vit = vals.begin(); vit != vals.end(); 
+       ++vit) {
+    pack_string(body, (*vit).first);
+    pack_uint32(body, (*vit).second.size());
+    for (unsigned int k = 0; k < (*vit).second.size(); ++k)
+      pack_strings(body, (*vit).second[k]);
+  }
+
+  std::string snap(schemaMagic, 4);
+  pack_uint32(snap, schemaVersion);
+  pack_uint32(snap, fnv1a_hash(body.data(), body.size()));
+  snap += body;
+
+  return snap;
+}
+
+/* ArgumentParser: reconstruct the schema from a binary snapshot */
+ARGPARSE_INLINE
+bool ArgumentParser :: load_schema(const char * buf, const size_t n, 
+				   const std::string & sourceTag) {
+  if ( !mArgs.empty() )
+    throw schemaLoadErr();
+
+  size_t pos = 0;
+  if ( n < 12 || memcmp(buf, schemaMagic, 4) != 0 )
+    return false;
+  pos += 4;
+
+  try {
+    if ( unpack_uint32(buf, n, pos) != schemaVersion )
+      return false;
+    if ( unpack_uint32(buf, n, pos) != fnv1a_hash(buf + pos, n - pos) )
+      return false; /* Corrupt snapshot */
+    if ( unpack_string(buf, n, pos) != sourceTag )
+      return false; /* Stale snapshot */
+
+    /* Unpack into a temporary parser, so that this one is left unchanged 
+       on failure */
+    ArgumentParser ap;
+    ap.command = unpack_string(buf, n, pos);
+    ap.description = unpack_string(buf, n, pos);
+    ap.bCombineSwitches = (unpack_uint32(buf, n, pos) != 0);
+    ap.bLazyConv = (unpack_uint32(buf, n, pos) != 0);
+    ap.envPrefix = unpack_string(buf, n, pos);
+    ap.nPosArgs = unpack_uint32(buf, n, pos);
+    ap.nOptArgs = unpack_uint32(buf, n, pos);
+    ap.nSLS = unpack_uint32(buf, n, pos);
+
+    std::vector<std::string> ss = unpack_strings(buf, n, pos);
+    ap.pArgs.assign(ss.begin(), ss.end());
+    ss = unpack_strings(buf, n, pos);
+    ap.sdSwitches.assign(ss.begin(), ss.end());
+    for (unsigned int k = 0; k < ss.size(); ++k)
+      if ( classify_token(ss[k].c_str()) == TOKEN_NEGATIVE_NUMBER )
+	ap.bNumericSwitches = true;
+    ss = unpack_strings(buf, n, pos);
+    ap.ddSwitches.assign(ss.begin(), ss.end());
+
+    unsigned int na = unpack_uint32(buf, n, pos);
+    for (unsigned int k = 0; k < na; ++k) {
+      std::string t_dest = unpack_string(buf, n, pos);
+      ap.mArgs[t_dest].unpackSchema(buf, n, pos);
+    }
+    if ( ap.mArgs.size() != na )
+      return false;
+
+    unsigned int nc = unpack_uint32(buf, n, pos);
+    for (unsigned int k = 0; k < nc; ++k) {
+      unsigned int type = unpack_uint32(buf, n, pos);
+      if ( type > CONSTRAINT_CONFLICTS )
+	return false;
+      std::string subject = unpack_string(buf, n, pos);
+      ap.addConstraint(static_cast<constraintType_t>(type), subject, 
+		       unpack_strings(buf, n, pos));
+    }
+
+    unsigned int ns = unpack_uint32(buf, n, pos);
+    ap.switchIndex.resize(ns);
+    for (unsigned int k = 0; k < ns; ++k) {
+      ap.switchIndex[k].sw = unpack_string(buf, n, pos);
+      ap.switchIndex[k].dest = unpack_string(buf, n, pos);
+      ap.switchIndex[k].idx = unpack_uint32(buf, n, pos);
+      if ( ap.mArgs.count(ap.switchIndex[k].dest) == 0 || 
+	   ap.switchIndex[k].idx >= ap.mArgs.size() )
+	return false;
+    }
+    unsigned int nv = unpack_uint32(buf, n, pos);
+    for (unsigned int k = 0; k < nv; ++k) {
+      std::string t_dest = unpack_string(buf, n, pos);
+      unsigned int np = unpack_uint32(buf, n, pos);
+      if ( ap.mArgs.count(t_dest) == 0 || 
+	   np != static_cast<unsigned int>(ap.mArgs[t_dest].getNArgs()) )
+	return false;
+      std::vector<std::vector<std::string> > & posVals = ap.valueIndex[t_dest];
+      posVals.resize(np);
+      for (unsigned int i = 0; i < np; ++i)
+	posVals[i] = unpack_strings(buf, n, pos);
+    }
+    ap.bSwitchIndexBuilt = true;
+    ap.bSwitchTreeBuilt = false;
+    ap.bValueIndexBuilt = true;
+    ap.nValidatorThreads = nValidatorThreads;
+
+    if ( pos != n )
+      return false;
+
+    *this = ap;
+  }
+  catch (unpackErr) {
+    return false;
+  }
+  catch (Argument::valTypeErr) {
+    return false;
+  }
+  catch (Argument::acceptPatternErr) {
+    return false;
+  }
+  catch (argNotFoundErr) {
+    return false;
+  }
+  catch (constraintErr) {
+    return false;
+  }
+
+  return true;
+}
+
+/* ArgumentParser: save the schema snapshot to a file */
+ARGPARSE_INLINE
+void ArgumentParser :: save_schema(const std::string & fileName, 
+				   const std::string & sourceTag) const {
+  std::string snap = dump_schema(sourceTag);
+
+  std::ofstream ofs(fileName.c_str(), 
+		    std::ios::out | std::ios::binary | std::ios::trunc);
+  if ( !ofs.write(snap.data(), snap.size()) )
+    throw schemaFileErr();
+}
+
+/* ArgumentParser: load the schema snapshot from a file */
+ARGPARSE_INLINE
+bool ArgumentParser :: load_schema_file(const std::string & fileName, 
+					const std::string & sourceTag) {
+  if ( !mArgs.empty() )
+    throw schemaLoadErr();
+
+  size_t n = 0;
+  const char * p = map_file(fileName, n);
+  if ( p == 0 )
+    return false;
+
+  bool bLoaded = load_schema(p, n, sourceTag);
+  unmap_file(p, n);
+
+  return bLoaded;
 }
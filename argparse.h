@@ -7,6 +7,43 @@
 #include <set>
 #include <map>
 #include <string>
+#include <cstring>
+
+#include "utils.h"
+#include "pattern.h"
+#include "parsetrace.h"
+
+/* ValueType:
+      Table of the functions of a custom value type (e.g., durations, IP 
+   addresses, byte sizes), registered by name with 
+   Argument::registerValueType() and chosen once per argument, when it is
+   added (see ArgumentParser::add_argument() with a type name). The values
+   are fixed-size objects of size bytes, copied with memcpy(), which the 
+   parser converts directly from the tokens and holds in the arguments. 
+   They are read back with Argument::getCustomVal<T>() and 
+   getCustomVals<T>(), T being a type of that size. */
+struct ValueType {
+  const char * name; /* Type name, e.g., "duration", as shown in help */
+  size_t size;       /* Size of a value (bytes) */
+
+  /* Convert the token s (n characters) into *val; false if malformed */
+  bool (*parse)(const char * s, const size_t n, void * val);
+  /* Test *val against an acceptance-set string (as given to 
+     Argument::setAcceptSet() for its position). 0: acceptance sets are 
+     not supported. */
+  bool (*accept)(const void * val, const char * as, const size_t n);
+  /* Write *val as text (as accepted by parse) into buf, of n bytes; 
+     return the length, at most n */
+  size_t (*format)(const void * val, char * buf, const size_t n);
+};
+
+/* Validator of argument values (see Argument::setValidator): checks the 
+   value val (as text, e.g., a path), typically against the system, and 
+   returns false with the reason of the failure in msg if it fails. ctx is 
+   the pointer given to setValidator(). Validators of different values may
+   run concurrently. */
+typedef bool (*argValidator_t)(const char * val, std::string & msg, 
+			       void * ctx);
 
 /* Main class: Argument: a single argument */
 class Argument {
@@ -18,6 +55,14 @@ class Argument {
 
   int nargs; /* Number of arguments (e.g., --rgb 160 240 80) */
 
+  bool bRemainder;
+  /* Whether this is a variadic trailing positional argument, which takes 
+     all the remaining tokens of argv (t_nargs == NARGS_REMAINDER in the 
+     constructor; nargs is then 1) */
+  char ** remArgv; 
+  int remArgc;
+  /* The remaining tokens, as a span of argv (not copied) */
+
   bool bOpt;
   /* Whether the argument is optional or not.
      Optional arguments start have argNames that start with - or --. 
@@ -30,6 +75,11 @@ class Argument {
 
   std::string help; /* Help information */
 
+  std::string envVar;
+  /* Name of the environment variable from which the value is taken when 
+     the argument is absent from argv. Empty: no explicit variable (the 
+     parser-wide prefix, if any, applies; see ArgumentParser::setEnvPrefix) */
+
   /* Values:
      These values are stored in vectors, so that multiple arguments (i.e., 
      nargs > 1) can be supported */
@@ -37,12 +87,24 @@ class Argument {
   std::vector<int> v_i;            /* Integer value */
   std::vector<float> v_f;          /* Float value */
   std::vector<std::string> v_s;    /* String value */
+  StringTable v_m;                 /* Key-value map value */
+  std::vector<char> v_c;
+  /* Custom values, back to back (customType->size bytes each) */
 
   /* Default values */
   std::vector<bool> dv_b;        /* Default Boolean value */
   std::vector<int> dv_i;         /* Default integer value */
   std::vector<float> dv_f;       /* Default float value */
   std::vector<std::string> dv_s; /* Default string value */
+  std::vector<char> dv_c;        /* Default custom values */
+
+  const ValueType * customType;
+  /* Functions of the value type (VAL_TYPE_CUSTOM only; otherwise 0) */
+
+  argValidator_t validator; /* 0: none */
+  void * validatorCtx;
+
+  unsigned int pathOpts; /* VAL_TYPE_PATH: pathOption_t flags */
 
   /* Acceptable set of values */
   std::vector<std::string> acceptSet;
@@ -59,8 +121,77 @@ class Argument {
      different acceptance sets. This is why "acceptSet" is defined as a 
      vector. */
 
+  std::vector<StringTable> acceptTables;
+  /* Compiled acceptance sets of string values (and map keys): hash tables 
+     of the members of acceptSet, one per position, built once when the 
+     acceptance set is set, for O(1) membership tests */
+
+  std::vector<Pattern> acceptPatterns;
+  /* Compiled pattern acceptance sets, one per position: an acceptSet entry
+     of the form "re:<regular expression>" or "glob:<glob pattern>" is 
+     compiled into a DFA instead of a hash table. See pattern.h. */
+
+  /* Compiled acceptance sets of numeric values, one per position: each 
+     member of acceptSet (e.g., ">0<=100" or "42") becomes a conjunction of 
+     comparisons, ended by the bEnd flag. Empty for positions whose set 
+     does not compile; those are checked from the strings instead. */
+  enum numOp_t {NUM_EQ, NUM_NE, NUM_LE, NUM_GE, NUM_LT, NUM_GT, 
+		NUM_IS /* A bare number */};
+  struct numTest_t {
+    numOp_t op;
+    double val;
+    bool bEnd; /* Last comparison of a member */
+  };
+  std::vector<std::vector<numTest_t> > acceptTests;
+
+  /* Compile a numeric acceptance set; false if it does not compile */
+  bool compileNumTests(const std::string & as, 
+		       std::vector<numTest_t> & tests) const;
+  /* Test a number against compiled tests */
+  template<class NT> 
+  static bool numTestsPass(const std::vector<numTest_t> & tests, const NT n);
+
+  /* Build acceptTables, acceptPatterns and acceptTests from acceptSet */
+  void compileAcceptSets();
+  /* Test if a string value (or map key) is accepted at position pos */
+  bool strAccept(const unsigned int pos, 
+		 const char * s, const size_t n) const;
+
+  bool bAppended;
+  /* Whether values have been appended (APPEND action). The first appended
+     values replace the default values. */
+
+  std::vector<const char *> rawVals;
+  /* Lazy conversion (see ArgumentParser::setLazyConversion): tokens of
+     values that have been given but not converted yet, as pointers into 
+     argv. They are converted, checked and cached on first access. */
+  bool bRawAppend;
+  /* Whether rawVals add to the values (APPEND) instead of replacing them */
+
+  /* Convert and check rawVals (non-empty) */
+  void convertRawVals();
+
   /* Test if the set values are all in the acceptance set */
   bool valAccept() const;
+  /* Test if the i-th value is in the acceptance set of its position */
+  bool elemAccept(const unsigned int i) const;
+
+  /* Convert a string and append it to the values */
+  void pushVal(const std::string & inStr);
+  /* Add the key=value pairs in a string (e.g., "a=1,b=2") to the map */
+  void addPairs(const std::string & inStr);
+  /* Number of values currently held */
+  unsigned int nVals() const;
+  /* Whether the values are held as strings (v_s) */
+  bool strType() const { 
+    return valType == VAL_TYPE_STRING || valType == VAL_TYPE_PATH; }
+  /* Convert a token into a custom value, appended to vals */
+  void pushCustom(std::vector<char> & vals, 
+		  const char * s, const size_t n) const;
+  /* The custom values, after checking that they are of size bytes and
+     set (and, if bScalar, that there is a single one); nv: their number */
+  const char * customVals(const size_t size, unsigned int & nv, 
+			  const bool bScalar) const;
   /* TODO: nested structures */
 
  public:
@@ -70,18 +201,72 @@ class Argument {
     VAL_TYPE_INT,
     VAL_TYPE_FLOAT,
     VAL_TYPE_STRING,
+    VAL_TYPE_MAP,
+    VAL_TYPE_CUSTOM,
+    VAL_TYPE_PATH,
   } valueType_t;
+  /* VAL_TYPE_MAP: key=value pairs, given as "k1=v1,k2=v2". nargs must be 1;
+     with the APPEND action, the pairs of all occurrences are collected 
+     (e.g., -D a=1 -D b=2). The acceptance set restricts the keys. 
+     VAL_TYPE_CUSTOM: a registered value type (see ValueType). Default 
+     values are given as strings, which are converted as tokens are. 
+     VAL_TYPE_PATH: file system paths, held and read as strings, which the 
+     parser can check and expand (see setPathOptions). */
+
+  /* Checks and expansion of VAL_TYPE_PATH values, done by the parser at 
+     the end of parse_args() (see ArgumentParser::setValidatorThreads) */
+  typedef enum {
+    PATH_EXISTS = 1, /* The path exists */
+    PATH_FILE = 2,   /* The path is a regular file (or a link to one) */
+    PATH_DIR = 4,    /* The path is a directory (or a link to one) */
+    PATH_GLOB = 8,   
+    /* Values are glob(3) patterns (e.g., /data/2026-0[1-6]/part-*), each 
+       replaced by the matching paths, sorted; a pattern matching nothing
+       is an error. For APPEND arguments with nargs == 1 only. */
+  } pathOption_t;
+
+  /* Handling of repeated keys in VAL_TYPE_MAP values */
+  typedef enum {
+    DUP_KEY_LAST,  /* The last value wins */
+    DUP_KEY_FIRST, /* The first value wins */
+    DUP_KEY_ERROR, /* Repeated keys are errors */
+  } dupKeyPolicy_t;
 
   /* Actions: 
-   non-optional arguments can only be associated with DEFAULT_ACTION */
+   non-optional arguments can only be associated with DEFAULT_ACTION. 
+   APPEND: the switch can be repeated, and the nargs values of every 
+   occurrence are appended to the values (e.g., -I dir1 -I dir2) */
   typedef enum {
     DEFAULT_ACTION, 
     STORE_TRUE,
     STORE_FALSE,
+    APPEND,
   } action_t;
 
+  /* Heap memory usage (bytes), by category. The sizes of the standard 
+     containers are computed from their element counts and capacities 
+     following the libstdc++ layouts. */
+  struct memUsage_t {
+    size_t names;      /* Argument names, switches and help strings */
+    size_t values;     /* Value vectors and maps */
+    size_t defaults;   /* Default value vectors */
+    size_t acceptSets; /* Acceptance sets */
+    size_t indices;    /* Parser: map of arguments and set of set switches */
+    size_t lists;      /* Parser: positional and switch lists */
+
+    memUsage_t();
+    size_t total() const;
+    memUsage_t & operator+=(const memUsage_t & mu);
+  };
+
   valueType_t valType;
   action_t action;
+  dupKeyPolicy_t dupKeyPolicy;
+
+  /* nargs of a variadic trailing positional argument: 
+     takes the remaining tokens (e.g., files1 ... fileN, or all tokens 
+     after --). Must be the last positional argument, of VAL_TYPE_STRING. */
+  static const int NARGS_REMAINDER = -1;
 
   /* Default constructor */
   Argument();
@@ -92,15 +277,121 @@ class Argument {
 	   const std::string t_help=std::string(""), 
 	   const action_t t_action=DEFAULT_ACTION, 
 	   const std::vector<std::string> & altOptSwitches=std::vector<std::string>(),
-	   const int t_nargs=1);
+	   const int t_nargs=1,
+	   const ValueType * t_customType=0);
+
+  /* Registration of custom value types, usually at startup (the registry
+     is not locked). Registering a name again with the same functions has 
+     no effect. Throws illegalValueTypeErr for tables without a name, 
+     size, parse or format function, and duplicateValueTypeErr for 
+     another table under a registered name. Return value: the registered
+     table. */
+  static const ValueType * registerValueType(const ValueType & vt);
+  /* Registered value type of a name; 0 if none */
+  static const ValueType * findValueType(const std::string & name);
 	   
   /* Setting the acceptance set (acceptSet) */
   void setAcceptSet(const std::string aSet);
   void setAcceptSet(const std::vector<std::string> aSets);
+  /* Load a (possibly large) acceptance set of a string-type argument from 
+     a file, one member per line. The set applies to all positions. */
+  void setAcceptSetFromFile(const std::string fileName);
+
+  /* Setting the handling of repeated keys (VAL_TYPE_MAP) */
+  void setDupKeyPolicy(const dupKeyPolicy_t policy);
+
+  /* Setting the environment variable for fallback values */
+  void setEnvVar(const std::string t_envVar);
+
+  /* Setting the validator of the values (0: none), run by the parser after
+     the values are set (see ArgumentParser::setValidatorThreads). 
+     Validators are not part of schema snapshots. */
+  void setValidator(argValidator_t v, void * ctx=0);
+  /* Whether the values are validated, by a validator or by path checks */
+  bool hasValidator() const { 
+    return validator != 0 || (pathOpts & (PATH_EXISTS | PATH_FILE | 
+					  PATH_DIR)) != 0; }
+  /* Run the path checks and the validator on the i-th value (true 
+     without either). The values must have been converted (see 
+     convertRaw()); different values can then be validated concurrently.
+     Exceptions of the validator are failures. */
+  bool validateVal(const unsigned int i, std::string & msg) const;
+  /* The i-th value (converted) as a null-terminated string: in the 
+     argument (string values), or formatted into buf, of n bytes (possibly
+     truncated). Map values are given as key=value. */
+  const char * getValText(const unsigned int i, char * buf, 
+			  const size_t n) const;
+
+  /* Setting the checks and expansion of VAL_TYPE_PATH values (see 
+     pathOption_t), e.g., PATH_GLOB | PATH_FILE. Throws valTypeErr for 
+     other value types, and illegalActionType for PATH_GLOB without APPEND 
+     or with nargs > 1. */
+  void setPathOptions(const unsigned int opts);
+  unsigned int getPathOptions() const { return pathOpts; }
+  /* Replace the patterns among the values (PATH_GLOB) by the matching 
+     paths. The patterns are expanded on up to nThreads threads (0: one per
+     CPU core): those with wildcards in several components (e.g., 
+     /data/2026-0[1-6]/part-*) directory by directory of the first such 
+     component. Patterns that match nothing are appended to unmatched and
+     left out. Only the values from index first on are expanded. Called by 
+     the parser. */
+  void expandPaths(const unsigned int nThreads, 
+		   std::vector<std::string> & unmatched, 
+		   const unsigned int first=0);
+
+  /* Stock validators, for string values */
+  /* The path exists */
+  static bool checkPathExists(const char * val, std::string & msg, void *);
+  /* The path is a writable directory */
+  static bool checkDirWritable(const char * val, std::string & msg, void *);
+  /* The host name resolves (e.g., through /etc/hosts or DNS) */
+  static bool checkHostResolves(const char * val, std::string & msg, void *);
+  /* The TCP port (for int values too) is free on all local addresses, 
+     IPv4 and IPv6 (where supported) */
+  static bool checkPortFree(const char * val, std::string & msg, void *);
   
   /* Set value, through string */
-  void setVal(const std::string inStr);
-  void setVal(const std::vector<std::string> inStrs);
+  void setVal(const std::string & inStr);
+  void setVal(const std::vector<std::string> & inStrs);
+  /* Same as above, from n C strings (e.g., a span of argv) */
+  void setVal(char ** inStrs, const int n);
+
+  /* Set the remaining tokens (NARGS_REMAINDER only). 
+     The tokens are not copied, converted or checked. */
+  void setRemainder(char ** t_argv, const int t_argc);
+
+  /* Append values, through strings (APPEND action only). 
+     The number of strings must be a multiple of nargs. Every value is 
+     checked against the acceptance set of its position. */
+  void appendVal(const std::string & inStr);
+  void appendVal(const std::vector<std::string> & inStrs);
+  void appendVal(char ** inStrs, const int n);
+  /* Start a new parse: the next appended values replace the current ones
+     instead of adding to them */
+  void resetAppended() { bAppended = false; }
+
+  /* Lazy versions of setVal(char **, int) and appendVal(char **, int): the
+     n tokens are stored without copying, and converted and checked on 
+     first access (see convertRaw()), so they must outlive that. 
+     VAL_TYPE_MAP values are converted immediately. */
+  void setValRaw(char ** inStrs, const int n);
+  void appendValRaw(char ** inStrs, const int n);
+
+  /* Convert and check the values stored by setValRaw() and appendValRaw(),
+     if any. Throws as setVal() and appendVal() do; the tokens are then kept,
+     so that every further access fails the same way. All the value 
+     getters call this first. */
+  void convertRaw() const {
+    if ( !rawVals.empty() )
+      const_cast<Argument *>(this)->convertRawVals();
+  }
+
+  /* Set value(s) from a single string, as given in an environment variable
+     or a config file: a Boolean string for STORE_TRUE / STORE_FALSE 
+     switches (a false value leaves the switch unset), or values separated
+     by white space when nargs > 1 or under APPEND. 
+     Return value: whether the argument has been set. */
+  bool setValFromString(const std::string & val);
 
   /* Overloaded functions for setting default value. 
      These functions are for nargs == 1 only. */
@@ -125,7 +416,7 @@ class Argument {
   void * getVal() const;
 
   /* A bunch of automatic type conversion operators. 
-     These operators are for nargs == 1 only. */
+     These operators are for nargs == 1 only (and not for APPEND). */
   operator bool() const;
   operator int() const;
   operator float() const;
@@ -136,21 +427,86 @@ class Argument {
 			    const int leftWidth, 
 			    const std::string destName) const;
 
-  /* Value getters for nargs >= 1 */
+  /* Heap memory used by this argument */
+  memUsage_t getMemUsage() const;
+
+  /* Binary serialization of the values (see ArgumentParser::dump_results). 
+     unpackVals() restores the values without conversion or validation; 
+     it throws unpackErr (leaving the argument unchanged) on malformed 
+     values or value counts. With bStore false, the values are only 
+     checked and skipped. */
+  void packVals(std::string & buf) const;
+  void unpackVals(const char * buf, const size_t n, size_t & pos, 
+		  const bool bStore=true);
+
+  /* Text export of the values (see ArgumentParser::export_json): a JSON 
+     value (a scalar for single values, an array for nargs > 1, APPEND and
+     NARGS_REMAINDER, an object for VAL_TYPE_MAP, null without values), or
+     space-separated values with escapes (see OutputSink::putEscaped) and 
+     maps as k1=v1,k2=v2 */
+  void exportVals(OutputSink & out, const bool bJson) const;
+  /* Name of the value type, e.g., "int" */
+  const char * getValTypeName() const;
+
+  /* Binary serialization of the whole argument definition, including the 
+     values (see ArgumentParser::dump_schema) */
+  void packSchema(std::string & buf) const;
+  void unpackSchema(const char * buf, const size_t n, size_t & pos);
+
+  /* Value getters for nargs >= 1 and for APPEND */
   std::vector<bool> getBoolVals() const;
   std::vector<int> getIntVals() const;
   std::vector<float> getFloatVals() const;
   std::vector<std::string> getStringVals() const;  
 
+  /* Value getters for NARGS_REMAINDER. getRemainderArgv() gives the span 
+     of argv, without copying, and is 0 for values not from parse_args() 
+     (use getStringVals() instead). */
+  int getRemainderArgc() const;
+  char ** getRemainderArgv() const;
+
+  /* Value getters for VAL_TYPE_CUSTOM. T must have the size of the 
+     values (getValFailure otherwise). getCustomVal() is for nargs == 1 
+     only (and not for APPEND). */
+  template<class T> T getCustomVal() const {
+    unsigned int nv;
+    const char * p = customVals(sizeof(T), nv, true);
+    T t;
+    memcpy(&t, p, sizeof(T));
+    return t;
+  }
+  template<class T> std::vector<T> getCustomVals() const {
+    unsigned int nv;
+    const char * p = customVals(sizeof(T), nv, false);
+    std::vector<T> ts(nv);
+    if ( nv > 0 )
+      memcpy(&ts[0], p, nv * sizeof(T));
+    return ts;
+  }
+  const ValueType * getCustomType() const { return customType; }
+
+  /* Value getters for VAL_TYPE_MAP */
+  std::map<std::string, std::string> getMapVals() const;
+  const StringTable & getMapTable() const;
+  bool hasKey(const std::string & key) const;
+  std::string getMapVal(const std::string & key) const;
+
   /* A bunch of getters */
   const bool isPositional() const { return !bOpt; }
+  const bool isRemainder() const { return bRemainder; }
   const valueType_t getValType() const { return valType; }
   const std::string getArgName() const { return argName; }
   const int getNArgs() const { return nargs; }
+  const unsigned int getNVals() const { convertRaw(); return nVals(); }
   const int getAction() const { return action; }
   const std::vector<std::string> & getOptSwitches() const { 
     return optSwitches; }
   const bool set() const { return bSet; }
+  const std::string & getEnvVar() const { return envVar; }
+
+  /* Members of the acceptance set of a string value at position pos 
+     (empty for patterns and for other value types), unsorted */
+  std::vector<std::string> getAcceptMembers(const unsigned int pos) const;
 
   /* Exceptions */
   class illegalArgName {};
@@ -168,6 +524,14 @@ class Argument {
   class unrecognizedBooleanValErr {};
   class unrecognizedNumberErr {};  
   class getHelpStringErr {};
+  class unrecognizedMapPairErr {};
+  class duplicateKeyErr {};
+  class keyNotFoundErr {};
+  class acceptSetFileErr {};
+  class acceptPatternErr {};
+  class unrecognizedCustomValErr {};
+  class illegalValueTypeErr {};
+  class duplicateValueTypeErr {};
 };
 
 /* Main class: ArgumentParser */
@@ -181,6 +545,20 @@ class ArgumentParser {
   bool bCombineSwitches; 
   /* Combine single-letter boolean switches into a single argument: e.g., 
      -avz */
+  bool bNumericSwitches;
+  /* Whether any switch looks like a negative number (e.g., -1). If not, 
+     negative numbers in argv are taken as positional arguments. */
+  bool bLazyConv;
+  /* Lazy conversion: parse_args() stores the tokens of the values, which 
+     are converted and checked on first access (see setLazyConversion) */
+
+  unsigned int nValidatorThreads;
+  /* Number of threads running the validators (see setValidatorThreads) */
+
+  ParseTrace * traceRec; /* Recorder of parses; 0: no recording */
+  unsigned long long traceLoopNs; 
+  /* Clock (ParseTrace::clock_ns()) at the end of the token loop of the 
+     parse being recorded */
 
   typedef std::map<std::string, Argument> ArgumentMap;
   typedef std::map<std::string, Argument>::iterator AMapIt;
@@ -188,6 +566,9 @@ class ArgumentParser {
 
   std::string command;
   std::string description;
+  std::string envPrefix; 
+  /* Prefix for environment-variable fallbacks (e.g., MYTOOL_). 
+     Empty: only arguments with explicit envVar fall back to the environment */
   ArgumentMap mArgs;
   /* Map of all arguments, with destination names as keys */
 
@@ -197,7 +578,74 @@ class ArgumentParser {
   std::deque<std::string> sdSwitches; /* Single-dash switches */
   std::deque<std::string> ddSwitches; /* Double-dash switches */
 
-  /* TODO: Mutual exclusion */
+  bitWords_t argvBits;
+  /* Optional arguments already set from the command line, by index in 
+     mArgs. This is used for preventing repeated setting of the same 
+     optional argument, including across parse_args() and parse_stream(). */
+
+  bitWords_t envBits;
+  /* Optional arguments that took their values from the environment in the
+     last parse_args(), by index in mArgs */
+
+  /* Constraints between optional arguments */
+  enum constraintType_t {
+    CONSTRAINT_EXCLUSIVE, /* At most one of the members may be given */
+    CONSTRAINT_TOGETHER,  /* Either all or none of the members are given */
+    CONSTRAINT_REQUIRES,  /* If subject is given, all members are given */
+    CONSTRAINT_CONFLICTS  /* If subject is given, no member is given */
+  };
+
+  struct constraint_t {
+    constraintType_t type;
+    std::string subject;              /* Destination name (REQUIRES, CONFLICTS) */
+    std::vector<std::string> members; /* Destination names */
+
+    /* Compiled form, over the indices of the arguments in mArgs */
+    int subjectIdx;
+    bitWords_t mask;                  /* Bits of the members */
+    unsigned int nMembers;
+  };
+
+  std::vector<constraint_t> constraints;
+  bool bConstraintsCompiled; 
+  /* Whether the masks of the constraints are up to date with mArgs */
+
+  /* Switch index: all switches, sorted, with the destination names and the
+     indices of their arguments in mArgs. Used for looking up switches 
+     during parsing without constructing strings, and for completion. 
+     Built on the first parse or completion query, or loaded from a schema
+     snapshot. */
+  struct switchEntry_t {
+    std::string sw;   /* Switch, e.g., --n-forms */
+    std::string dest; /* Destination name */
+    unsigned int idx; /* Index of the argument in mArgs */
+    bool operator<(const switchEntry_t & o) const { return sw < o.sw; }
+  };
+  std::vector<switchEntry_t> switchIndex;
+  bool bSwitchIndexBuilt;
+
+  BKTree switchTree; 
+  /* Edit-distance index of the switches, with ids into switchIndex, for
+     suggestions on unrecognized switches. Built on the first suggestion. */
+  bool bSwitchTreeBuilt;
+
+  /* Completion index of values: the sorted acceptance-set members of 
+     string arguments, by destination name and position */
+  typedef std::map<std::string, 
+		   std::vector<std::vector<std::string> > > ValueIndex;
+  ValueIndex valueIndex;
+  bool bValueIndexBuilt;
+
+  void buildSwitchIndex(std::vector<switchEntry_t> & sws) const;
+  void buildValueIndex(ValueIndex & vals) const;
+  /* Build the switch index if needed and size argvBits and envBits */
+  void prepareSwitchIndex();
+  /* Look up a switch in the switch index; 0 if not found */
+  const switchEntry_t * findSwitch(const char * sw) const;
+  /* Whether the argument with index idx is given in argv or the environment */
+  bool isGiven(const unsigned int idx) const {
+    return bits_test(argvBits, idx) || bits_test(envBits, idx); }
+
   /* TODO: Argument groups */
 
   /* Private member functions */
@@ -206,6 +654,61 @@ class ArgumentParser {
   /* Check the legality of switches under bCombineSwitches */
   const bool checkSwitches();
 
+  /* Helpers of parse_args() and parse_stream() */
+  void lookupSwitch(const std::string & arg, 
+		    std::vector<std::string> & t_argNames, 
+		    std::vector<std::string> & t_destNames, 
+		    int & nArgs);
+  int switchValCount(const std::string & arg);
+  int parseOptional(const int ntoks, char ** toks, const bool bRaw);
+  bool isKnownCombined(const char * tok);
+  int parseArgv(int argc, char ** argv, const bool bKnown);
+  int parseTokens(int argc, char ** argv, const bool bKnown);
+  void appendTrace(ParseTrace::record_t & rec, const unsigned long long t0);
+  int parseCombined(const std::string & arg);
+  /* Report an unrecognized switch arg with the error message msg, 
+     suggesting the closest known switches; throws argParsingErr */
+  void unrecognizedSwitchErr(const std::string & msg, const std::string & arg);
+  bool isSwitch(const tokenKind_t kind) const;
+  void parsePositional(char ** tok, const unsigned int ip);
+
+  /* Environment variable name for an argument (empty if none) */
+  std::string envName(const std::string & t_dest, const Argument & arg) const;
+
+  /* Take values from the environment for arguments absent from argv */
+  void applyEnvFallbacks();
+
+  /* Helpers of the constraints */
+  void addConstraint(const constraintType_t type, const std::string subject,
+		     const std::vector<std::string> & members);
+  void compileConstraints();
+  /* Check all constraints against the arguments given in argv or the 
+     environment; throws argParsingErr naming the offending switches */
+  void checkConstraints();
+  /* List of the switches of dests, e.g., "--foo, --bar" */
+  std::string switchList(const std::vector<std::string> & dests) const;
+
+  /* Convert and check the values of an argument stored under lazy 
+     conversion; throws argParsingErr */
+  void convertArg(const std::string & t_dest, const Argument & arg);
+  /* Expand the path patterns and run the path checks and validators of 
+     all set arguments; throws argParsingErr listing the failures. With 
+     from, only the values of the k-th argument (in mArgs) from index 
+     from[k] on (none for from[k] == 0xffffffff). */
+  void runValidators(const std::vector<unsigned int> * from=0);
+  /* Record the arguments set by a switch token of parse_stream() in from
+     (see runValidators()) */
+  void markStreamSet(const std::string & tok, 
+		     std::vector<unsigned int> & from);
+
+  /* Body of the add_argument() overloads */
+  void addArgument(const std::string & t_dest, const Argument & t_arg, 
+		   const std::string & t_argName, 
+		   const std::vector<std::string> & altOptSwitches);
+
+  /* Body of export_json() and export_kv() */
+  void exportConfig(OutputSink & out, const bool bJson) const;
+
  public:
   /* Default constructor */
   ArgumentParser();
@@ -226,18 +729,187 @@ class ArgumentParser {
 
 
 
+  /* Add an argument of a custom value type, by the name under which the
+     type is registered (see ValueType). Throws unknownValueTypeErr for 
+     unregistered names. */
+  void add_argument(const std::string t_dest, 
+		    const std::string t_argName, 
+		    const std::string t_help, 
+		    const std::string & t_typeName, 
+		    const Argument::action_t t_action=Argument::DEFAULT_ACTION,
+		    const std::vector<std::string> & altOptSwitches=std::vector<std::string>(), 
+		    const int t_nargs=1);
+
   /* Remove argument */
   void remove_argument(const std::string t_argName);
 
   void parse_args(int argc, char ** argv);
 
+  /* Same as parse_args(), except that unrecognized switches and surplus 
+     positional values are not errors. They are moved to argv[1..n], in 
+     their original order, and argv[n + 1] is set to null, so that argv can
+     be handed to execv() (with argv[0] set to the child program) or 
+     argv + 1 to execvp(). The pointers are moved, not copied. Values of 
+     unrecognized switches are taken as positional values unless joined 
+     (e.g., --opt=val). If a variadic positional argument directly follows 
+     the unrecognized tokens, it is moved up by one into argv[argc], which 
+     must exist (as for the argv of main()). Return value: n */
+  int parse_known_args(int argc, char ** argv);
+
+  /* Callback for the positional values read by parse_stream(): receives a 
+     batch of values and the userData pointer given to parse_stream() */
+  typedef void (*posBatchCallback_t)(const std::vector<std::string> & vals, 
+				     void * userData);
+
+  /* Streaming parse of argument tokens read from a file descriptor, e.g., 
+     for "find -print0 | tool --stdin0" (delim = '\0'). Usually called after 
+     parse_args(). Optional switches (and their values) are applied as they
+     arrive; positional values are not stored but handed to callback in 
+     batches of up to batchSize values. Memory use is bounded by the read 
+     buffer (which also limits the token length) and the batch size. The 
+     values of the switches are validated at the end of the stream (see 
+     setValidatorThreads); positional values are left to callback. */
+  void parse_stream(const int fd, 
+		    posBatchCallback_t callback, 
+		    void * userData=0, 
+		    const char delim='\0', 
+		    const unsigned int batchSize=1024);
+
   void setCombineSwitches(const bool bcs);
 
+  /* Lazy conversion: parse_args() only stores the value tokens (as 
+     pointers into argv, which must stay valid), and every value is 
+     converted, checked against its acceptance set and cached on its first
+     access. Conversion errors are then thrown by the value getters (as 
+     Argument exceptions, e.g., Argument::valOutsideAcceptanceSet), unless 
+     validate_all() is called after parse_args(). parse_stream() and the 
+     environment fallbacks still convert immediately. */
+  void setLazyConversion(const bool blc);
+  /* Convert and check all values not converted yet. Errors are reported 
+     as in parse_args() (argParsingErr). */
+  void validate_all();
+
+  /* Validators (see Argument::setValidator) and path checks (see 
+     Argument::setPathOptions) are run at the end of parse_args() and 
+     parse_known_args(), after the constraints are checked and the path 
+     patterns are expanded, on every value of the arguments that are set 
+     (from argv, the environment or default values), on up to n threads 
+     (0, the default: one per CPU core; 1: in the calling thread only). 
+     Values under lazy conversion are converted first. All failures 
+     (including patterns that match nothing) are reported together, in 
+     the order of the destination names and values, as a single 
+     argParsingErr. At the end of parse_stream(), the same is done for the
+     values set by the switches read from the stream (the values appended 
+     to those of argv or the environment, for APPEND). */
+  void setValidatorThreads(const unsigned int n);
+
+  /* Record every parse_args() and parse_known_args() in rec (see 
+     ParseTrace), which must outlive the parser or be unset (0) first. The
+     destination names of the arguments are written to rec, so the 
+     recorder is set after the arguments are added. */
+  void setTraceRecorder(ParseTrace * rec);
+
+  /* Constraints between optional arguments (given by destination names), 
+     checked at the end of parse_args() and parse_stream() against the 
+     arguments given in argv or the environment (default values do not 
+     count). Throw argNotFoundErr for unknown names and constraintErr for 
+     positional arguments or too few members. */
+  /* At most one of dests may be given */
+  void add_mutually_exclusive(const std::vector<std::string> & dests);
+  /* Either all or none of dests must be given */
+  void add_required_together(const std::vector<std::string> & dests);
+  /* If dest is given, all of required must be given too */
+  void add_requires(const std::string dest, 
+		    const std::vector<std::string> & required);
+  void add_requires(const std::string dest, const std::string required);
+  /* If dest is given, none of conflicting may be given */
+  void add_conflicts(const std::string dest, 
+		     const std::vector<std::string> & conflicting);
+  void add_conflicts(const std::string dest, const std::string conflicting);
+
+  /* Set the prefix for environment-variable fallbacks. With prefix MYTOOL_, 
+     argument nForms falls back to $MYTOOL_NFORMS. Two arguments falling 
+     back to the same variable (e.g., n-forms and n_forms, or through 
+     Argument::setEnvVar) make parse_args() throw argParsingErr. */
+  void setEnvPrefix(const std::string prefix);
+
   std::string getHelpString(const int cw, const int lw) const;
   void print_help() const;
 
+  /* Shell completion. 
+     complete() returns the candidates for the last of words (the partial 
+     word under the cursor, possibly empty), given the preceding words 
+     (argv without the program name): switches, or the acceptance-set 
+     members of the switch or positional argument expecting a value. 
+     handle_completion() serves the query "cmd __complete <words...>": it 
+     prints the candidates to stdout, one per line, and returns true; for 
+     any other argv it returns false. Call it before parse_args(). */
+  std::vector<std::string> complete(const std::vector<std::string> & words);
+  bool handle_completion(int argc, char ** argv);
+
+  /* Completion script for shell "bash", "zsh" or "fish", which calls 
+     "cmd __complete". Throws unsupportedShellErr for other shells. */
+  std::string completion_script(const std::string & shell) const;
+
+  /* Known switches (primary or alternative) closest to sw in edit 
+     distance, nearest first, at most one per argument and at most maxN. 
+     Switches more than 1, 2 or 3 edits away (for sw of up to 4, 8 or more 
+     characters) are not suggested. Used in the errors on unrecognized 
+     switches. */
+  std::vector<std::string> suggest_switches(const std::string & sw, 
+					    const unsigned int maxN=3);
+
+  /* Heap memory used by the parser, including all its arguments */
+  Argument::memUsage_t getMemUsage() const;
+
+  /* Serialize the parse results (values and set-flags of all arguments) 
+     into a compact, versioned binary blob, e.g., for handing over to worker
+     processes. The blob can be loaded back into a parser with the same 
+     schema, which then needs no parse_args() call. */
+  std::string dump_results() const;
+  void load_results(const std::string & blob);
+  void load_results(const char * buf, const size_t n);
+
+  /* Same as above, through a file. load_results_file() maps the file 
+     read-only instead of reading it into an intermediate buffer. */
+  void save_results(const std::string & fileName) const;
+  void load_results_file(const std::string & fileName);
+
+  /* Export the effective configuration (all arguments, in the order of 
+     their destination names) as text, e.g., for provenance logs: 
+     JSON, as {"dest":{"type":"int","source":"argv","value":3},...}, or 
+     flat key=value lines, as dest=3 followed by dest.source=argv (values 
+     as in Argument::exportVals; arguments without values have only the 
+     source line). The source is where the value came from in the last
+     parse: "argv", "env", "default" or "none" (not set). The text is 
+     appended to buf, or written to the file descriptor fd, through a 
+     small buffer; values are formatted in place, floats as the shortest
+     decimal strings that read back exactly. The fd versions throw 
+     exportErr on write errors. */
+  void export_json(std::string & buf) const;
+  void export_json(const int fd) const;
+  void export_kv(std::string & buf) const;
+  void export_kv(const int fd) const;
+
+  /* Freeze the schema (all argument definitions and the switch lookup 
+     lists) into a binary snapshot, so that it can be reconstructed at 
+     startup without the add_argument() calls. sourceTag identifies the 
+     source definition (e.g., a version string bumped whenever the 
+     add_argument() calls change); a snapshot with a different tag is stale.
+     load_schema() returns false if the snapshot is stale, corrupt or 
+     missing, in which case the parser is left unchanged. It can be called
+     only on a parser without arguments. */
+  std::string dump_schema(const std::string & sourceTag) const;
+  bool load_schema(const char * buf, const size_t n, 
+		   const std::string & sourceTag);
+
+  void save_schema(const std::string & fileName, 
+		   const std::string & sourceTag) const;
+  bool load_schema_file(const std::string & fileName, 
+			const std::string & sourceTag);
+
   /* Operator for allowing access to member arguments */
-  Argument & operator[](std::string t_dest);
+  Argument & operator[](const std::string & t_dest);
   
   /* Exception classes */
   class addArgumentFailure {};
@@ -248,15 +920,33 @@ class ArgumentParser {
   class argRemovalFailure {};
   class argNotFoundErr {};
   class unexpectedActionErr {};
+  class resultsFormatErr {};
+  class resultsFileErr {};
+  class exportErr {};
+  class schemaLoadErr {};
+  class schemaFileErr {};
+  class streamReadErr {};
+  class constraintErr {};
+  class unsupportedShellErr {};
+  class unknownValueTypeErr {};
   class argParsingErr {
     std::string errMsg;
 
   public:
   argParsingErr() : errMsg("") {}
   argParsingErr(std::string em) : errMsg(em) {}
+  const std::string & getErrMsg() const { return errMsg; }
   };
 
 
 };
 
+/* Header-only mode (see utils.h): pull in the implementation */
+#ifdef ARGPARSE_HEADER_ONLY
+#include "utils.cpp"
+#include "pattern.cpp"
+#include "parsetrace.cpp"
+#include "argparse.cpp"
+#endif
+
 #endif
@@ -12,6 +12,7 @@ Correct calling:
    ./argparse_example battlecruiser Excaliber 3 --speed 3000 -cd
    ./argparse_example battlecruiser Excaliber 3 --speed 3000 -cd --armor-thick 80  
    ./argparse_example battlecruiser Excaliber 3 --speed 3000 -cd --armor-thick 280 --alliance-corp UFP AmaDyne
+   ./argparse_example battlecruiser Excaliber 3 --warp-time 1m30s
 
 
 To demostrate errors:
@@ -33,15 +34,64 @@ To demostrate errors:
    ./argparse_example battlecruiser Excaliber 3 --speed 3000 -cd --armor-thick 160
    (float value outside acceptance set)
 
+   ./argparse_example battlecruiser Excaliber 3 --warp-time 1h
+   (duration outside acceptance set)
+
 */
 
 #include <iostream>
 #include <vector>
+#include <cstdio>
 
 #include "argparse.h"
 
 using namespace std;
 
+/* Custom value type: durations such as 90, 1m30s or 2h, held as unsigned 
+   ints (seconds) */
+static bool parseDuration(const char * s, const size_t n, void * val) {
+  unsigned int t = 0, u = 0;
+  bool bDigits = false;
+  for (size_t i = 0; i < n; ++i) {
+    if ( s[i] >= '0' && s[i] <= '9' ) {
+      u = u * 10 + (s[i] - '0');
+      bDigits = true;
+    }
+    else if ( bDigits && (s[i] == 'h' || s[i] == 'm' || s[i] == 's') ) {
+      t += u * ((s[i] == 'h') ? 3600 : (s[i] == 'm') ? 60 : 1);
+      u = 0;
+      bDigits = false;
+    }
+    else {
+      return false;
+    }
+  }
+  if ( n == 0 )
+    return false;
+
+  t += u;
+  memcpy(val, &t, sizeof(t));
+  return true;
+}
+
+/* Acceptance sets of durations: upper limits, e.g., "<=10m" */
+static bool acceptDuration(const void * val, const char * as, 
+			   const size_t n) {
+  unsigned int t, lim;
+  memcpy(&t, val, sizeof(t));
+  if ( n < 3 || as[0] != '<' || as[1] != '=' || 
+       !parseDuration(as + 2, n - 2, &lim) )
+    return false;
+  return t <= lim;
+}
+
+static size_t formatDuration(const void * val, char * buf, const size_t n) {
+  unsigned int t;
+  memcpy(&t, val, sizeof(t));
+  const int len = snprintf(buf, n, "%um%us", t / 60, t % 60);
+  return (len < 0) ? 0 : (static_cast<size_t>(len) < n) ? len : n - 1;
+}
+
 
 int main(int argc, char ** argv) {
   ArgumentParser ap(string("argparse_example"), 
@@ -102,7 +152,23 @@ int main(int argc, char ** argv) {
 		  "Assign to alliance and corporation", 
 		  Argument::VAL_TYPE_STRING, Argument::DEFAULT_ACTION, 
 		  vector<string>(), 2);
+
+  /* Add 5th optional argument: warp time: a custom value type */
+  const ValueType durationType = {"duration", sizeof(unsigned int), 
+				  parseDuration, acceptDuration, 
+				  formatDuration};
+  Argument::registerValueType(durationType);
+  ap.add_argument("warpTime", "--warp-time", 
+		  "Time in warp (e.g., 45s, 1m30s)", 
+		  "duration", Argument::DEFAULT_ACTION, 
+		  vector<string>(1, "-w"), 1);
+  ap["warpTime"].setDefaultVal(string("30s"));
+  ap["warpTime"].setAcceptSet("<=10m");
 		  
+  /* Shell completion queries: argparse_example __complete <words...> */
+  if ( ap.handle_completion(argc, argv) )
+    return 0;
+
   if ( argc <= 1) {
     ap.print_help();
     return 0;
@@ -119,6 +185,8 @@ int main(int argc, char ** argv) {
   cout << "\tDrone bay = " << bool(ap["droneBay"]) << endl;
   if ( ap["armorThick"].set() )
     cout << "\tArmor thickness = " << float(ap["armorThick"]) << " cm" <<endl;
+  cout << "\tWarp time = " << ap["warpTime"].getCustomVal<unsigned int>() 
+       << " s" << endl;
 
   if ( ap["alliCorp"].set() ) {
     vector<string> alliCorp = ap["alliCorp"].getStringVals();
@@ -0,0 +1,803 @@
+/* Benchmarks of argparse-cpp.
+
+   Memory usage of synthetic schemas (bytes per argument):
+   ./bench_argparse mem
+   ./bench_argparse mem -n 100 -n 10000
+
+   Parsing speed of long command lines:
+   ./bench_argparse parse
+   ./bench_argparse parse -t 1000000
+   ./bench_argparse parse -t 1000000 --lazy   (lazy conversion)
+
+   Speed of value access in a hot loop. bench_argparse_ho is the same 
+   program built in header-only mode (ARGPARSE_HEADER_ONLY), in which the 
+   accessors can be inlined into the loop:
+   ./bench_argparse access -r 100000000
+   ./bench_argparse_ho access -r 100000000
+
+   Splitting of a comma-separated list of -t members (e.g., an acceptance 
+   set), by split_string() and by StringSplitter:
+   ./bench_argparse split -t 1000000
+
+   Suggestions for mistyped switches among -n switches (word-like names),
+   by the BK-tree of the parser and by brute force:
+   ./bench_argparse suggest -n 20000
+
+   Cost of recording parses with a ParseTrace (in memory and in a mapped 
+   file), over -p parses of a short command line:
+   ./bench_argparse trace -p 1000000
+
+   Export of the effective configuration of -n arguments, by the copying
+   value getters and iostreams, and by export_kv() and export_json():
+   ./bench_argparse export -n 10000
+
+   Validation of -t paths (existence, by Argument::checkPathExists) at the 
+   end of parse_args(), in the calling thread and on -j threads, with the 
+   files in the page cache and with a simulated 100 us of I/O latency per 
+   path (as on a network file system):
+   ./bench_argparse validate -t 10000 -j 16
+
+   Expansion of a path pattern (VAL_TYPE_PATH, PATH_GLOB) over 100 
+   directories of -t files in all, with every match checked to be a 
+   regular file (PATH_FILE), in the calling thread and on -j threads:
+   ./bench_argparse paths -t 100000 -j 16
+
+   Snapshot reads of hot-reloadable values by reader threads while the 
+   config file is reloaded (including rejected reloads), and the latency
+   of a reload triggered by the file watcher:
+   ./bench_argparse reload -l 1000 -j 4
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "argparse.h"
+#include "hotconfig.h"
+
+using namespace std;
+
+/* Build a synthetic schema of nArgs optional arguments, cycling through
+   Boolean switches, integers with default values, strings with acceptance
+   sets and two-valued floats */
+static void build_schema(ArgumentParser & ap, const int nArgs) {
+  for (int k = 0; k < nArgs; ++k) {
+    ostringstream dest, sw;
+    dest << "arg" << k;
+    sw << "--arg-" << k;
+
+    switch (k % 4) {
+    case 0:
+      ap.add_argument(dest.str(), sw.str(), "Boolean switch",
+		      Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+      break;
+    case 1:
+      ap.add_argument(dest.str(), sw.str(), "Integer with a default value",
+		      Argument::VAL_TYPE_INT);
+      ap[dest.str()].setDefaultVal(k);
+      break;
+    case 2:
+      ap.add_argument(dest.str(), sw.str(), "String with an acceptance set",
+		      Argument::VAL_TYPE_STRING);
+      ap[dest.str()].setAcceptSet("red,green,blue,black");
+      break;
+    default:
+      ap.add_argument(dest.str(), sw.str(), "Pair of floats",
+		      Argument::VAL_TYPE_FLOAT, Argument::DEFAULT_ACTION,
+		      vector<string>(), 2);
+      break;
+    }
+  }
+}
+
+/* Print the memory usage of synthetic schemas, per argument */
+static void bench_mem(const vector<int> & sizes) {
+  cout << setw(8) << "nArgs"
+       << setw(10) << "names" << setw(10) << "values"
+       << setw(10) << "defaults" << setw(10) << "accept"
+       << setw(10) << "indices" << setw(10) << "lists"
+       << setw(10) << "total" << "   (bytes per argument)" << endl;
+
+  for (unsigned int i = 0; i < sizes.size(); ++i) {
+    ArgumentParser ap("synthetic", "Synthetic schema");
+    build_schema(ap, sizes[i]);
+
+    Argument::memUsage_t mu = ap.getMemUsage();
+    const double n = sizes[i];
+    cout << fixed << setprecision(1) << setw(8) << sizes[i]
+	 << setw(10) << mu.names / n << setw(10) << mu.values / n
+	 << setw(10) << mu.defaults / n << setw(10) << mu.acceptSets / n
+	 << setw(10) << mu.indices / n << setw(10) << mu.lists / n
+	 << setw(10) << mu.total() / n << endl;
+  }
+}
+
+/* Time the parsing of a command line of nTokens tokens: repeated integer
+   values, Boolean switches and negative-number values */
+static void bench_parse(const int nTokens, const bool bLazy) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.setLazyConversion(bLazy);
+  build_schema(ap, 16);
+  ap.add_argument("ints", "-i", "Repeated integers",
+		  Argument::VAL_TYPE_INT, Argument::APPEND);
+  ap.add_argument("verbose", "-v", "Verbose mode",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+
+  vector<string> toks;
+  toks.reserve(nTokens + 2);
+  toks.push_back("synthetic");
+  toks.push_back("-v");
+  while ( static_cast<int>(toks.size()) < nTokens + 1 ) {
+    toks.push_back("-i");
+    toks.push_back((toks.size() % 4 == 1) ? "-42" : "42");
+  }
+
+  vector<char *> targv(toks.size() + 1, static_cast<char *>(0));
+  for (unsigned int i = 0; i < toks.size(); ++i)
+    targv[i] = &toks[i][0];
+
+  clock_t t0 = clock();
+  ap.parse_args(toks.size(), &targv[0]);
+  double sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+
+  cout << toks.size() - 1 << " tokens parsed in " << sec * 1e3 << " ms ("
+       << ((sec > 0) ? (toks.size() - 1) / sec / 1e6 : 0)
+       << " M tokens/s)" << (bLazy ? " (lazy)" : "");
+
+  if ( bLazy ) {
+    t0 = clock();
+    ap.validate_all();
+    sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+    cout << "; validate_all() in " << sec * 1e3 << " ms";
+  }
+  cout << "; " << ap["ints"].getNVals() << " values" << endl;
+}
+
+/* Time the splitting of a list of nMembers comma-separated members by
+   split_string() (copying) and by StringSplitter (in place) */
+static void bench_split(const int nMembers) {
+  string list;
+  for (int i = 0; i < nMembers; ++i) {
+    if ( i > 0 )
+      list += ',';
+    list += (i % 3 == 0) ? "member" : "a-longer-member-name";
+  }
+
+  clock_t t0 = clock();
+  const vector<string> toks = split_string(list, ",");
+  double sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << "split_string(): " << toks.size() << " members of " 
+       << list.size() << " bytes in " << sec * 1e3 << " ms" << endl;
+
+  t0 = clock();
+  StringSplitter sp(list, ',');
+  const char * t;
+  size_t tl;
+  size_t n = 0, nChars = 0;
+  while ( sp.next(t, tl) ) {
+    n++;
+    nChars += tl;
+  }
+  sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << "StringSplitter: " << n << " members of " << list.size() 
+       << " bytes in " << sec * 1e3 << " ms (" 
+       << ((sec > 0) ? list.size() / sec / 1e9 : 0) << " GB/s)" << endl;
+
+  if ( n != toks.size() || nChars + n - 1 != list.size() )
+    cout << "ERROR: Inconsistent splits" << endl;
+}
+
+/* Time value access through the accessors of already parsed arguments: 
+   nReads iterations that each read an int, a float and a bool, and 
+   nReads / 100 reads of an element of a vector value */
+static void bench_access(const int nReads) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.add_argument("count", "--count", "Integer", Argument::VAL_TYPE_INT);
+  ap.add_argument("ratio", "--ratio", "Float", Argument::VAL_TYPE_FLOAT);
+  ap.add_argument("verbose", "-v", "Verbose mode",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("range", "--range", "Pair of integers",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(), 2);
+
+  const char * toks[] = {"synthetic", "--count", "3", "--ratio", "0.5", "-v",
+			 "--range", "-8", "7"};
+  const int ntoks = sizeof(toks) / sizeof(toks[0]);
+  vector<char *> targv(ntoks + 1, static_cast<char *>(0));
+  for (int i = 0; i < ntoks; ++i)
+    targv[i] = const_cast<char *>(toks[i]);
+  ap.parse_args(ntoks, &targv[0]);
+
+  const Argument & count = ap["count"];
+  const Argument & ratio = ap["ratio"];
+  const Argument & verbose = ap["verbose"];
+  const Argument & range = ap["range"];
+
+#ifdef ARGPARSE_HEADER_ONLY
+  const char * mode = "header-only";
+#else
+  const char * mode = "library";
+#endif
+
+  long iSum = 0;
+  clock_t t0 = clock();
+  for (int k = 0; k < nReads; ++k) {
+    const int scale = static_cast<bool>(verbose) ? 4 : 1;
+    iSum += static_cast<int>(count) * k + 
+      static_cast<int>(static_cast<float>(ratio) * scale);
+  }
+  double sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << mode << ": " << nReads << " x 3 scalar reads in " << sec * 1e3 
+       << " ms (" << sec * 1e9 / (3.0 * nReads) << " ns/read); sum " 
+       << iSum << endl;
+
+  const int nVecReads = nReads / 100 + 1;
+  iSum = 0;
+  t0 = clock();
+  for (int k = 0; k < nVecReads; ++k)
+    iSum += range.getIntVals()[k & 1];
+  sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << mode << ": " << nVecReads << " vector reads in " << sec * 1e3 
+       << " ms (" << sec * 1e9 / nVecReads << " ns/read); sum " 
+       << iSum << endl;
+}
+
+/* Time suggestions for mistyped switches among nArgs switches with random
+   word-like names, against a brute-force edit-distance scan */
+static void bench_suggest(const int nArgs) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  vector<string> sws;
+  unsigned int seed = 12345;
+  while ( static_cast<int>(sws.size()) < nArgs ) {
+    string sw("--");
+    const int len = 6 + seed % 10;
+    for (int i = 0; i < len; ++i) {
+      seed = seed * 1103515245u + 12345u;
+      sw += (i > 0 && (seed >> 16) % 7 == 0) ? '-' : 
+	static_cast<char>('a' + (seed >> 16) % 26);
+    }
+    ostringstream dest;
+    dest << "arg" << sws.size();
+    try {
+      ap.add_argument(dest.str(), sw, "Boolean switch",
+		      Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+      sws.push_back(sw);
+    }
+    catch (...) {
+      /* Duplicate switch */
+    }
+  }
+
+  /* Typos: one substitution and one deletion */
+  const int nQueries = 1000;
+  vector<string> queries;
+  for (int q = 0; q < nQueries; ++q) {
+    string sw = sws[(q * 7919) % sws.size()];
+    sw[2 + q % (sw.size() - 2)] = 'z';
+    sw.erase(3 + q % (sw.size() - 3), 1);
+    queries.push_back(sw);
+  }
+
+  clock_t t0 = clock();
+  ap.suggest_switches(queries[0]);
+  double sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << sws.size() << " switches; index built in " << sec * 1e3 
+       << " ms" << endl;
+
+  t0 = clock();
+  size_t nSugg = 0;
+  for (int q = 0; q < nQueries; ++q)
+    nSugg += ap.suggest_switches(queries[q]).size();
+  sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << "BK-tree:     " << sec / nQueries * 1e6 << " us/query; " 
+       << nSugg << " suggestions" << endl;
+
+  t0 = clock();
+  size_t nNear = 0;
+  vector<unsigned int> row;
+  for (int q = 0; q < nQueries; ++q)
+    for (unsigned int i = 0; i < sws.size(); ++i)
+      if ( edit_distance(queries[q].data(), queries[q].size(), 
+			 sws[i].data(), sws[i].size(), row) <= 3 )
+	nNear++;
+  sec = static_cast<double>(clock() - t0) / CLOCKS_PER_SEC;
+  cout << "brute force: " << sec / nQueries * 1e6 << " us/query; " 
+       << nNear << " switches within 3 edits" << endl;
+}
+
+/* Time nParses parses of a short command line by ap */
+static double time_parses(ArgumentParser & ap, const int nParses) {
+  const char * toks[] = {"synthetic", "--lo", "1", "--hi", "2", "-v"};
+  vector<char *> targv(7, static_cast<char *>(0));
+  for (int i = 0; i < 6; ++i)
+    targv[i] = const_cast<char *>(toks[i]);
+
+  ap.parse_args(6, &targv[0]);
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  for (int k = 0; k < nParses; ++k)
+    ap.parse_args(6, &targv[0]);
+  return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+/* Time parses without recording, and recorded by a ParseTrace in memory 
+   and in a mapped file */
+static void bench_trace(const int nParses) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.add_argument("lo", "--lo", "Lower value", Argument::VAL_TYPE_INT);
+  ap.add_argument("hi", "--hi", "Higher value", Argument::VAL_TYPE_INT);
+  ap["hi"].setAcceptSet(">=0");
+  ap.add_argument("verbose", "-v", "Verbose mode",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+
+  const double secBase = time_parses(ap, nParses);
+  cout << "no recording: " << secBase / nParses * 1e9 << " ns/parse" << endl;
+
+  ParseTrace memTrace(4096);
+  ap.setTraceRecorder(&memTrace);
+  const double secMem = time_parses(ap, nParses);
+  cout << "in memory:    " << secMem / nParses * 1e9 << " ns/parse (+"
+       << (secMem - secBase) / nParses * 1e9 << " ns)" << endl;
+
+  char dirTmpl[] = "/tmp/bench_argparse_XXXXXX";
+  if ( mkdtemp(dirTmpl) == 0 ) {
+    cerr << "ERROR: Failed to create a temporary directory" << endl;
+    return;
+  }
+  const string fileName = string(dirTmpl) + "/bench.trace";
+  {
+    ParseTrace fileTrace(fileName, 4096);
+    ap.setTraceRecorder(&fileTrace);
+    const double secFile = time_parses(ap, nParses);
+    ap.setTraceRecorder(0);
+    cout << "mapped file:  " << secFile / nParses * 1e9 << " ns/parse (+"
+	 << (secFile - secBase) / nParses * 1e9 << " ns); " 
+	 << fileTrace.nRecorded() << " records" << endl;
+  }
+
+  unlink(fileName.c_str());
+  rmdir(dirTmpl);
+}
+
+/* Time exports of the configuration of a synthetic schema of nArgs 
+   arguments, all given on the command line: key=value lines formatted with
+   iostreams from the copying value getters, and export_kv() and 
+   export_json() into a buffer and to /dev/null */
+static void bench_export(const int nArgs) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  build_schema(ap, nArgs);
+
+  vector<string> toks(1, "synthetic");
+  vector<string> dests;
+  for (int k = 0; k < nArgs; ++k) {
+    ostringstream dest, sw, f0, f1;
+    dest << "arg" << k;
+    sw << "--arg-" << k;
+    dests.push_back(dest.str());
+    toks.push_back(sw.str());
+
+    if ( k % 4 == 1 ) {
+      f0 << k * 7;
+      toks.push_back(f0.str());
+    }
+    else if ( k % 4 == 2 ) {
+      toks.push_back("green");
+    }
+    else if ( k % 4 == 3 ) {
+      f0 << k * 0.001;
+      f1 << 1.0 / (k + 1);
+      toks.push_back(f0.str());
+      toks.push_back(f1.str());
+    }
+  }
+  vector<char *> targv(toks.size() + 1, static_cast<char *>(0));
+  for (unsigned int i = 0; i < toks.size(); ++i)
+    targv[i] = const_cast<char *>(toks[i].c_str());
+  ap.parse_args(toks.size(), &targv[0]);
+
+  const int nReps = 1000000 / nArgs + 1;
+  size_t nBytes = 0;
+
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  for (int r = 0; r < nReps; ++r) {
+    ostringstream oss;
+    oss << setprecision(9);
+    for (unsigned int i = 0; i < dests.size(); ++i) {
+      Argument & arg = ap[dests[i]];
+      oss << dests[i] << "=";
+      if ( arg.getValType() == Argument::VAL_TYPE_BOOL ) {
+	vector<bool> vs = arg.getBoolVals();
+	for (unsigned int j = 0; j < vs.size(); ++j)
+	  oss << (j > 0 ? " " : "") << (vs[j] ? "true" : "false");
+      }
+      else if ( arg.getValType() == Argument::VAL_TYPE_INT ) {
+	vector<int> vs = arg.getIntVals();
+	for (unsigned int j = 0; j < vs.size(); ++j)
+	  oss << (j > 0 ? " " : "") << vs[j];
+      }
+      else if ( arg.getValType() == Argument::VAL_TYPE_FLOAT ) {
+	vector<float> vs = arg.getFloatVals();
+	for (unsigned int j = 0; j < vs.size(); ++j)
+	  oss << (j > 0 ? " " : "") << vs[j];
+      }
+      else {
+	vector<string> vs = arg.getStringVals();
+	for (unsigned int j = 0; j < vs.size(); ++j)
+	  oss << (j > 0 ? " " : "") << vs[j];
+      }
+      oss << "\n";
+    }
+    nBytes = oss.str().size();
+  }
+  const double secIos = 
+    chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+  string buf;
+  t0 = chrono::steady_clock::now();
+  for (int r = 0; r < nReps; ++r) {
+    buf.clear();
+    ap.export_kv(buf);
+  }
+  const double secKv = 
+    chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  const size_t nKvBytes = buf.size();
+
+  t0 = chrono::steady_clock::now();
+  for (int r = 0; r < nReps; ++r) {
+    buf.clear();
+    ap.export_json(buf);
+  }
+  const double secJson = 
+    chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  const size_t nJsonBytes = buf.size();
+
+  const int fd = open("/dev/null", O_WRONLY);
+  t0 = chrono::steady_clock::now();
+  for (int r = 0; r < nReps; ++r)
+    ap.export_json(fd);
+  const double secFd = 
+    chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  close(fd);
+
+  const double n = static_cast<double>(nReps) * nArgs;
+  cout << nArgs << " arguments, " << nReps << " exports" << endl;
+  cout << fixed << setprecision(1)
+       << "getters + iostreams:       " << secIos / n * 1e9 << " ns/arg ("
+       << nBytes << " bytes)" << endl
+       << "export_kv(), buffer:       " << secKv / n * 1e9 << " ns/arg ("
+       << nKvBytes << " bytes, with sources)" << endl
+       << "export_json(), buffer:     " << secJson / n * 1e9 << " ns/arg ("
+       << nJsonBytes << " bytes)" << endl
+       << "export_json(), /dev/null:  " << secFd / n * 1e9 << " ns/arg" 
+       << endl;
+}
+
+/* Validator of paths with a simulated I/O latency */
+static bool check_path_slow(const char * val, string & msg, void * ctx) {
+  this_thread::sleep_for(chrono::microseconds(100));
+  return Argument::checkPathExists(val, msg, ctx);
+}
+
+/* Time parses of nPaths paths, validated on 1 and on nThreads threads */
+static void bench_validate(const int nPaths, const int nThreads) {
+  char dirTmpl[] = "/tmp/bench_argparse_XXXXXX";
+  if ( mkdtemp(dirTmpl) == 0 ) {
+    cerr << "ERROR: Failed to create a temporary directory" << endl;
+    return;
+  }
+
+  vector<string> toks(1, "synthetic");
+  for (int k = 0; k < nPaths; ++k) {
+    ostringstream path;
+    path << dirTmpl << "/part-" << k;
+    close(open(path.str().c_str(), O_WRONLY | O_CREAT, 0644));
+    toks.push_back("--in");
+    toks.push_back(path.str());
+  }
+  vector<char *> targv(toks.size() + 1, static_cast<char *>(0));
+  for (unsigned int i = 0; i < toks.size(); ++i)
+    targv[i] = const_cast<char *>(toks[i].c_str());
+
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.add_argument("inputs", "--in", "Input files", 
+		  Argument::VAL_TYPE_STRING, Argument::APPEND);
+
+  cout << nPaths << " paths" << endl;
+  for (int s = 0; s < 2; ++s) {
+    ap["inputs"].setValidator((s == 0) ? Argument::checkPathExists : 
+			      check_path_slow);
+    for (int j = 1; j <= nThreads; j = (j < nThreads) ? nThreads : j + 1) {
+      ap.setValidatorThreads(j);
+      chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+      ap.parse_args(toks.size(), &targv[0]);
+      const double sec = 
+	chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+      cout << ((s == 0) ? "page cache, " : "+100 us I/O, ") << setw(3) << j 
+	   << " thread(s): " << sec * 1e3 << " ms (" 
+	   << sec / nPaths * 1e6 << " us/path)" << endl;
+    }
+  }
+
+  for (int k = 0; k < nPaths; ++k)
+    unlink(toks[2 * k + 2].c_str());
+  rmdir(dirTmpl);
+}
+
+/* Time parses of a pattern matching nFiles files in 100 directories, 
+   expanded and checked on 1 and on nThreads threads */
+static void bench_paths(const int nFiles, const int nThreads) {
+  char dirTmpl[] = "/tmp/bench_argparse_XXXXXX";
+  if ( mkdtemp(dirTmpl) == 0 ) {
+    cerr << "ERROR: Failed to create a temporary directory" << endl;
+    return;
+  }
+
+  const int nDirs = 100;
+  vector<string> files;
+  for (int d = 0; d < nDirs; ++d) {
+    ostringstream dir;
+    dir << dirTmpl << "/day-" << d;
+    mkdir(dir.str().c_str(), 0755);
+    for (int k = d; k < nFiles; k += nDirs) {
+      ostringstream path;
+      path << dir.str() << "/part-" << k;
+      files.push_back(path.str());
+      close(open(path.str().c_str(), O_WRONLY | O_CREAT, 0644));
+    }
+  }
+
+  const string pattern = string(dirTmpl) + "/day-*/part-*";
+  const char * toks[] = {"synthetic", "--in", pattern.c_str()};
+
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.add_argument("inputs", "--in", "Input files", 
+		  Argument::VAL_TYPE_PATH, Argument::APPEND);
+  ap["inputs"].setPathOptions(Argument::PATH_GLOB | Argument::PATH_FILE);
+
+  cout << pattern << ": " << nFiles << " files in " << nDirs << " directories"
+       << endl;
+  for (int j = 1; j <= nThreads; j = (j < nThreads) ? nThreads : j + 1) {
+    ap.setValidatorThreads(j);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    ap.parse_args(3, const_cast<char **>(toks));
+    const double sec = 
+      chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << setw(3) << j << " thread(s): " << sec * 1e3 << " ms (" 
+	 << sec / nFiles * 1e6 << " us/file); " 
+	 << ap["inputs"].getNVals() << " paths" << endl;
+  }
+
+  for (unsigned int k = 0; k < files.size(); ++k)
+    unlink(files[k].c_str());
+  for (int d = 0; d < nDirs; ++d) {
+    ostringstream dir;
+    dir << dirTmpl << "/day-" << d;
+    rmdir(dir.str().c_str());
+  }
+  rmdir(dirTmpl);
+}
+
+/* Write a config file through a temporary file and rename(), as editors
+   and deployment tools do */
+static void write_config(const string & fileName, const string & text) {
+  const string tmpName = fileName + ".tmp";
+  {
+    ofstream ofs(tmpName.c_str());
+    ofs << text;
+  }
+  rename(tmpName.c_str(), fileName.c_str());
+}
+
+/* Reader threads of bench_reload: every snapshot must have hi == 2 * lo */
+static void reload_reader(HotConfig & hc, const atomic<bool> & bStop,
+			  atomic<long> & nReads, atomic<long> & nTorn) {
+  HotConfig::Reader rd(hc);
+
+  long n = 0, nBad = 0;
+  while ( !bStop.load(memory_order_relaxed) ) {
+    const ConfigSnapshot & snap = rd.snapshot();
+    const int lo = snap["lo"];
+    const int hi = snap["hi"];
+    if ( hi != 2 * lo )
+      nBad++;
+
+    if ( (++n & 63) == 0 )
+      rd.quiescent();
+  }
+
+  nReads += n;
+  nTorn += nBad;
+}
+
+/* Time nReloads reloads of a config file under nThreads reader threads.
+   Every tenth config has a value outside the acceptance set, and must be
+   rejected as a whole. */
+static void bench_reload(const int nReloads, const int nThreads) {
+  ArgumentParser ap("synthetic", "Synthetic schema");
+  ap.add_argument("lo", "--lo", "Lower value", Argument::VAL_TYPE_INT);
+  ap["lo"].setDefaultVal(0);
+  ap.add_argument("hi", "--hi", "Higher value", Argument::VAL_TYPE_INT);
+  ap["hi"].setDefaultVal(0);
+  ap["hi"].setAcceptSet(">=0");
+
+  const char * toks[] = {"synthetic", "--lo", "1", "--hi", "2"};
+  vector<char *> targv(6, static_cast<char *>(0));
+  for (int i = 0; i < 5; ++i)
+    targv[i] = const_cast<char *>(toks[i]);
+  ap.parse_args(5, &targv[0]);
+
+  char dirTmpl[] = "/tmp/bench_argparse_XXXXXX";
+  if ( mkdtemp(dirTmpl) == 0 ) {
+    cerr << "ERROR: Failed to create a temporary directory" << endl;
+    return;
+  }
+  const string fileName = string(dirTmpl) + "/bench.conf";
+
+  vector<string> dests;
+  dests.push_back("lo");
+  dests.push_back("hi");
+  HotConfig hc(ap, dests);
+
+  atomic<bool> bStop(false);
+  atomic<long> nReads(0), nTorn(0);
+  vector<thread> readers;
+  for (int t = 0; t < nThreads; ++t)
+    readers.push_back(thread(reload_reader, ref(hc), cref(bStop), 
+			     ref(nReads), ref(nTorn)));
+
+  /* Rejected reloads print their reasons; keep them off the output */
+  streambuf * cerrBuf = cerr.rdbuf(0);
+
+  int nPublished = 0, nRejected = 0;
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  for (int k = 1; k <= nReloads; ++k) {
+    ostringstream oss;
+    oss << "# Reload " << k << "\nlo = " << k << "\nhi = " 
+	<< ((k % 10 == 0) ? -1 : 2 * k) << "\n";
+    write_config(fileName, oss.str());
+
+    if ( hc.reload(fileName) )
+      nPublished++;
+    else
+      nRejected++;
+  }
+  double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+  cerr.rdbuf(cerrBuf);
+
+  bStop = true;
+  for (int t = 0; t < nThreads; ++t)
+    readers[t].join();
+
+  cout << nPublished << " reloads published, " << nRejected << " rejected in "
+       << sec * 1e3 << " ms (" << sec * 1e6 / nReloads << " us/reload); "
+       << nThreads << " reader thread(s): " << nReads << " reads ("
+       << nReads / sec / 1e6 << " M reads/s), " << nTorn 
+       << " inconsistent; " << hc.nRetired() << " snapshot(s) unreclaimed" 
+       << endl;
+
+  /* Reload through the file watcher */
+  write_config(fileName, "lo = 5\nhi = 10\n");
+  const unsigned long v0 = HotConfig::Reader(hc).snapshot().getVersion();
+  if ( !hc.watch(fileName) ) {
+    cerr << "ERROR: Failed to watch " << fileName << endl;
+  }
+  else {
+    const unsigned long v1 = HotConfig::Reader(hc).snapshot().getVersion();
+    t0 = chrono::steady_clock::now();
+    write_config(fileName, "lo = 7\nhi = 14\n");
+
+    bool bSeen = false;
+    while ( !bSeen && chrono::steady_clock::now() - t0 < chrono::seconds(5) ) {
+      HotConfig::Reader rd(hc);
+      bSeen = (rd.snapshot().getVersion() > v1 && 
+	       int(rd.snapshot()["lo"]) == 7);
+      if ( !bSeen )
+	usleep(100);
+    }
+    sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    hc.unwatch();
+
+    cout << "watch: " << v1 - v0 << " initial reload(s); file change "
+	 << (bSeen ? "picked up in " : "NOT picked up in ") 
+	 << sec * 1e3 << " ms" << endl;
+  }
+
+  unlink(fileName.c_str());
+  rmdir(dirTmpl);
+}
+
+int main(int argc, char ** argv) {
+  ArgumentParser ap("bench_argparse", "Benchmarks of argparse-cpp");
+
+  ap.add_argument("mode", "mode", "Benchmark to run",
+		  Argument::VAL_TYPE_STRING);
+  ap["mode"].setAcceptSet(
+    "mem,parse,split,access,suggest,trace,export,reload,validate,paths");
+
+  ap.add_argument("nArgs", "-n", "Number of arguments in the schema",
+		  Argument::VAL_TYPE_INT, Argument::APPEND,
+		  vector<string>(1, "--n-args"), 1);
+  vector<int> defSizes;
+  defSizes.push_back(10);
+  defSizes.push_back(100);
+  defSizes.push_back(1000);
+  defSizes.push_back(10000);
+  ap["nArgs"].setDefaultVals(defSizes);
+  ap["nArgs"].setAcceptSet(">0");
+
+  ap.add_argument("nTokens", "-t", "Number of tokens on the command line",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--n-tokens"), 1);
+  ap["nTokens"].setDefaultVal(100000);
+  ap["nTokens"].setAcceptSet(">0");
+
+  ap.add_argument("lazy", "--lazy", "Lazy conversion (parse)",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+
+  ap.add_argument("nReads", "-r", "Number of value reads",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--n-reads"), 1);
+  ap["nReads"].setDefaultVal(100000000);
+  ap["nReads"].setAcceptSet(">0");
+
+  ap.add_argument("nParses", "-p", "Number of parses (trace)",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--n-parses"), 1);
+  ap["nParses"].setDefaultVal(1000000);
+  ap["nParses"].setAcceptSet(">0");
+
+  ap.add_argument("nReloads", "-l", "Number of config reloads",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--n-reloads"), 1);
+  ap["nReloads"].setDefaultVal(1000);
+  ap["nReloads"].setAcceptSet(">0");
+
+  ap.add_argument("nThreads", "-j", 
+		  "Number of reader threads (reload) or validator threads",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--n-threads"), 1);
+  ap["nThreads"].setDefaultVal(4);
+  ap["nThreads"].setAcceptSet(">0");
+
+  if ( argc <= 1 ) {
+    ap.print_help();
+    return 0;
+  }
+
+  ap.parse_args(argc, argv);
+
+  if ( string(ap["mode"]) == "mem" )
+    bench_mem(ap["nArgs"].getIntVals());
+  else if ( string(ap["mode"]) == "parse" )
+    bench_parse(ap["nTokens"], ap["lazy"]);
+  else if ( string(ap["mode"]) == "split" )
+    bench_split(ap["nTokens"]);
+  else if ( string(ap["mode"]) == "access" )
+    bench_access(ap["nReads"]);
+  else if ( string(ap["mode"]) == "suggest" )
+    bench_suggest(ap["nArgs"].getIntVals().back());
+  else if ( string(ap["mode"]) == "trace" )
+    bench_trace(ap["nParses"]);
+  else if ( string(ap["mode"]) == "export" )
+    bench_export(ap["nArgs"].getIntVals().back());
+  else if ( string(ap["mode"]) == "reload" )
+    bench_reload(ap["nReloads"], ap["nThreads"]);
+  else if ( string(ap["mode"]) == "validate" )
+    bench_validate(ap["nTokens"], ap["nThreads"]);
+  else if ( string(ap["mode"]) == "paths" )
+    bench_paths(ap["nTokens"], ap["nThreads"]);
+
+  return 0;
+}
@@ -0,0 +1,280 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+#include "utils.h"
+#include "hotconfig.h"
+
+/* Class ConfigSnapshot: Member functions */
+ARGPARSE_INLINE
+ConfigSnapshot :: ConfigSnapshot(const unsigned long t_version,
+				 const std::vector<std::string> * t_dests,
+				 const std::vector<Argument> & t_args) :
+  version(t_version), dests(t_dests), args(t_args) {
+}
+
+ARGPARSE_INLINE const Argument &
+ConfigSnapshot :: operator[](const std::string & dest) const {
+  std::vector<std::string>::const_iterator it =
+    std::lower_bound(dests->begin(), dests->end(), dest);
+  if ( it == dests->end() || *it != dest )
+    throw ArgumentParser::argNotFoundErr();
+
+  return args[it - dests->begin()];
+}
+
+/* Class HotConfig::Reader: Member functions */
+ARGPARSE_INLINE HotConfig::Reader :: Reader(HotConfig & t_hc) : hc(t_hc) {
+  std::lock_guard<std::mutex> lock(hc.mtx);
+  seen.store(hc.epoch.load());
+  hc.readers.push_back(this);
+}
+
+ARGPARSE_INLINE HotConfig::Reader :: ~Reader() {
+  std::lock_guard<std::mutex> lock(hc.mtx);
+  hc.readers.erase(std::find(hc.readers.begin(), hc.readers.end(), this));
+  hc.reclaim();
+}
+
+/* Class HotConfig: Member functions */
+ARGPARSE_INLINE
+HotConfig :: HotConfig(ArgumentParser & ap,
+		       const std::vector<std::string> & t_dests) :
+  dests(t_dests), current(0), epoch(0), inotifyFd(-1) {
+  stopFds[0] = stopFds[1] = -1;
+
+  std::sort(dests.begin(), dests.end());
+  dests.erase(std::unique(dests.begin(), dests.end()), dests.end());
+
+  baseArgs.reserve(dests.size());
+  for (unsigned int i = 0; i < dests.size(); ++i) {
+    baseArgs.push_back(ap[dests[i]]);
+    /* Snapshots are read concurrently, so values stored for lazy 
+       conversion are converted here */
+    baseArgs.back().convertRaw();
+  }
+
+  current.store(new ConfigSnapshot(0, &dests, baseArgs));
+}
+
+ARGPARSE_INLINE HotConfig :: ~HotConfig() {
+  unwatch();
+
+  delete current.load();
+  for (unsigned int i = 0; i < retired.size(); ++i)
+    delete retired[i].first;
+}
+
+/* Make snap the current snapshot and retire the previous one */
+ARGPARSE_INLINE void HotConfig :: publish(ConfigSnapshot * snap) {
+  ConfigSnapshot * old = current.exchange(snap);
+
+  /* Readers that see the incremented epoch at a quiescent state can no
+     longer reach old */
+  const unsigned long e = epoch.fetch_add(1) + 1;
+  retired.push_back(std::make_pair(old, e));
+
+  reclaim();
+}
+
+/* Delete the retired snapshots that all readers have passed.
+   Called with mtx held. */
+ARGPARSE_INLINE void HotConfig :: reclaim() {
+  unsigned long minSeen = ULONG_MAX;
+  for (unsigned int i = 0; i < readers.size(); ++i)
+    minSeen = std::min(minSeen, readers[i]->seen.load());
+
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < retired.size(); ++i) {
+    if ( retired[i].second <= minSeen )
+      delete retired[i].first;
+    else
+      retired[n++] = retired[i];
+  }
+  retired.resize(n);
+}
+
+ARGPARSE_INLINE size_t HotConfig :: nRetired() {
+  std::lock_guard<std::mutex> lock(mtx);
+  reclaim();
+  return retired.size();
+}
+
+/* Strip leading and trailing white space */
+ARGPARSE_STATIC std::string strip_blanks(const std::string & s) {
+  const size_t b = s.find_first_not_of(" \t\r");
+  if ( b == std::string::npos )
+    return std::string("");
+
+  const size_t e = s.find_last_not_of(" \t\r");
+  return s.substr(b, e + 1 - b);
+}
+
+ARGPARSE_INLINE bool HotConfig :: reload(const std::string & fileName) {
+  std::ifstream ifs(fileName.c_str());
+  if ( !ifs ) {
+    std::cerr << "ERROR: Failed to open config file: " << fileName
+	      << std::endl;
+    return false;
+  }
+
+  /* The new values are set on copies of the parsed arguments, so that
+     arguments absent from the file keep the values from the parser */
+  std::vector<Argument> args(baseArgs);
+  std::vector<bool> bGiven(dests.size(), false);
+
+  std::ostringstream ossErr;
+  std::string line;
+  int lineNo = 0;
+  while ( ossErr.str().empty() && std::getline(ifs, line) ) {
+    lineNo++;
+
+    const std::string sl = strip_blanks(line);
+    if ( sl.empty() || sl[0] == '#' )
+      continue;
+
+    const size_t eq = sl.find('=');
+    if ( eq == std::string::npos ) {
+      ossErr << "Missing '=' in line " << lineNo << ": " << sl;
+      break;
+    }
+
+    const std::string key = strip_blanks(sl.substr(0, eq));
+    const std::string val = strip_blanks(sl.substr(eq + 1));
+
+    std::vector<std::string>::const_iterator it =
+      std::lower_bound(dests.begin(), dests.end(), key);
+    if ( it == dests.end() || *it != key ) {
+      ossErr << "Unknown or non-reloadable argument in line " << lineNo
+	     << ": " << key;
+      break;
+    }
+
+    const unsigned int i = it - dests.begin();
+    if ( bGiven[i] ) {
+      ossErr << "Repeated argument in line " << lineNo << ": " << key;
+      break;
+    }
+    bGiven[i] = true;
+
+    try {
+      args[i].setValFromString(val);
+    }
+    catch (Argument::valOutsideAcceptanceSet) {
+      ossErr << "Value outside acceptance set of argument " << key
+	     << " in line " << lineNo << ": " << val;
+    }
+    catch (...) {
+      ossErr << "Failed to set value of argument " << key
+	     << " in line " << lineNo << ": " << val;
+    }
+  }
+
+  if ( !ossErr.str().empty() ) {
+    std::cerr << "ERROR: Rejected reload of config file " << fileName
+	      << ": " << ossErr.str() << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  publish(new ConfigSnapshot(current.load()->version + 1, &dests, args));
+
+  return true;
+}
+
+/* Body of the watcher thread: reload the file whenever an inotify event
+   on baseName arrives, until woken up through stopFds */
+ARGPARSE_INLINE void HotConfig :: watchLoop(const std::string fileName,
+					    const std::string baseName) {
+  /* Buffer aligned for struct inotify_event */
+  union {
+    struct inotify_event ev;
+    char buf[4096];
+  } evBuf;
+
+  while ( true ) {
+    struct pollfd pfds[2];
+    pfds[0].fd = inotifyFd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = stopFds[0];
+    pfds[1].events = POLLIN;
+
+    if ( poll(pfds, 2, -1) < 0 ) {
+      if ( errno == EINTR )
+	continue;
+      break;
+    }
+
+    if ( pfds[1].revents != 0 )
+      break;
+
+    const ssize_t n = read(inotifyFd, evBuf.buf, sizeof(evBuf.buf));
+    if ( n <= 0 )
+      continue;
+
+    bool bChanged = false;
+    for (ssize_t p = 0; p < n; ) {
+      const struct inotify_event * ev =
+	reinterpret_cast<const struct inotify_event *>(evBuf.buf + p);
+      if ( ev->len > 0 && baseName == ev->name )
+	bChanged = true;
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+
+    if ( bChanged )
+      reload(fileName);
+  }
+}
+
+ARGPARSE_INLINE bool HotConfig :: watch(const std::string & fileName) {
+  unwatch();
+
+  /* The directory is watched, so that replacements of the file (e.g., by
+     rename()) are seen */
+  const size_t sl = fileName.rfind('/');
+  const std::string dirName = (sl == std::string::npos) ?
+    std::string(".") : fileName.substr(0, (sl == 0) ? 1 : sl);
+  const std::string baseName = (sl == std::string::npos) ?
+    fileName : fileName.substr(sl + 1);
+
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if ( inotifyFd < 0 )
+    return false;
+
+  if ( inotify_add_watch(inotifyFd, dirName.c_str(),
+			 IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+       pipe(stopFds) != 0 ) {
+    close(inotifyFd);
+    inotifyFd = -1;
+    stopFds[0] = stopFds[1] = -1;
+    return false;
+  }
+
+  if ( access(fileName.c_str(), F_OK) == 0 )
+    reload(fileName);
+
+  watcher = std::thread(&HotConfig::watchLoop, this, fileName, baseName);
+  return true;
+}
+
+ARGPARSE_INLINE void HotConfig :: unwatch() {
+  if ( !watcher.joinable() )
+    return;
+
+  const char c = 0;
+  if ( write(stopFds[1], &c, 1) != 1 )
+    std::cerr << "ERROR: Failed to stop config file watcher" << std::endl;
+  watcher.join();
+
+  close(inotifyFd);
+  close(stopFds[0]);
+  close(stopFds[1]);
+  inotifyFd = -1;
+  stopFds[0] = stopFds[1] = -1;
+}
@@ -0,0 +1,152 @@
+#ifndef HOTCONFIG_H
+#define HOTCONFIG_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "argparse.h"
+
+/* ConfigSnapshot:
+      An immutable, versioned set of values of the reloadable arguments of a
+   HotConfig. Snapshots are created by HotConfig and read through
+   HotConfig::Reader. */
+class ConfigSnapshot {
+ private:
+  unsigned long version; /* 0: values from the parser; +1 per reload */
+  const std::vector<std::string> * dests; /* Sorted destination names */
+  std::vector<Argument> args; /* Arguments, in the order of dests */
+
+  ConfigSnapshot(const unsigned long t_version,
+		 const std::vector<std::string> * t_dests,
+		 const std::vector<Argument> & t_args);
+
+  friend class HotConfig;
+
+ public:
+  unsigned long getVersion() const { return version; }
+
+  /* Access to an argument by destination name.
+     Throws ArgumentParser::argNotFoundErr for non-reloadable names. */
+  const Argument & operator[](const std::string & dest) const;
+};
+
+/* HotConfig:
+      Reloadable values of selected arguments of a parsed ArgumentParser,
+   re-sourced from a config file at run time.
+
+   The config file has one "dest = value" line per argument; empty lines
+   and lines starting with # are ignored. Values are given as in
+   environment variables (see Argument::setValFromString()) and go through
+   the same conversion and acceptance-set checks as command-line values.
+   Arguments absent from the file take their values from the parser.
+
+   A reload builds a complete new snapshot and publishes it with a single
+   atomic pointer store; if any line fails, the reload is rejected as a
+   whole and the current snapshot stays in effect.
+
+   Reader threads read the current snapshot through a HotConfig::Reader,
+   with a single atomic load and no locks. Old snapshots are reclaimed by
+   quiescent-state-based reclamation: every Reader declares from time to
+   time (e.g., between requests) that it holds no more references into
+   snapshots, by calling quiescent(). A snapshot replaced by a reload is
+   deleted once all Readers have done so.
+
+   e.g.,
+     HotConfig hc(ap, dests);
+     hc.watch("/etc/myserver.conf");
+     ... in every worker thread:
+     HotConfig::Reader rd(hc);
+     while ( ... ) {
+       int nWorkers = rd.snapshot()["nWorkers"];
+       ...
+       rd.quiescent();
+     }
+*/
+class HotConfig {
+ public:
+  class Reader {
+   private:
+    HotConfig & hc;
+    std::atomic<unsigned long> seen;
+    /* Reclamation epoch seen at the last quiescent state */
+
+    Reader(const Reader &);
+    Reader & operator=(const Reader &);
+
+    friend class HotConfig;
+
+   public:
+    /* Readers register with and unregister from hc on construction and
+       destruction */
+    Reader(HotConfig & t_hc);
+    ~Reader();
+
+    /* The current snapshot. References into it remain valid until the
+       next call to quiescent() of this Reader. */
+    const ConfigSnapshot & snapshot() const {
+      return *hc.current.load(std::memory_order_acquire);
+    }
+
+    /* Declare that no references into snapshots are held */
+    void quiescent() {
+      seen.store(hc.epoch.load(std::memory_order_seq_cst),
+		 std::memory_order_seq_cst);
+    }
+  };
+
+ private:
+  std::vector<std::string> dests; /* Sorted destination names */
+  std::vector<Argument> baseArgs; /* Arguments as parsed, in dests order */
+
+  std::atomic<ConfigSnapshot *> current;
+  std::atomic<unsigned long> epoch; /* Incremented on every publication */
+
+  std::mutex mtx;
+  /* Serializes reloads and guards readers and retired */
+  std::vector<Reader *> readers;
+  std::vector<std::pair<ConfigSnapshot *, unsigned long> > retired;
+  /* Replaced snapshots and the epochs of their replacement */
+
+  /* File watching */
+  std::thread watcher;
+  int inotifyFd;
+  int stopFds[2]; /* Pipe that wakes up the watcher thread for stopping */
+
+  HotConfig(const HotConfig &);
+  HotConfig & operator=(const HotConfig &);
+
+  void publish(ConfigSnapshot * snap);
+  void reclaim();
+  void watchLoop(const std::string dirName, const std::string baseName);
+
+ public:
+  /* The values of arguments t_dests of ap (parsed) become snapshot 0 */
+  HotConfig(ArgumentParser & ap, const std::vector<std::string> & t_dests);
+  /* Stops watching. There must be no Readers left. */
+  ~HotConfig();
+
+  /* Re-source the values from a config file.
+     Return value: true if a new snapshot has been published; false if the
+     reload has been rejected (with the reason printed to stderr). */
+  bool reload(const std::string & fileName);
+
+  /* Reload the file now (if it exists) and whenever it is written or
+     replaced (e.g., by an editor or by rename()), from a background
+     thread. Return value: false if the file cannot be watched. */
+  bool watch(const std::string & fileName);
+  void unwatch();
+
+  /* Reclaim what can be reclaimed, and return the number of replaced 
+     snapshots still held */
+  size_t nRetired();
+};
+
+/* Header-only mode (see utils.h): pull in the implementation */
+#ifdef ARGPARSE_HEADER_ONLY
+#include "hotconfig.cpp"
+#endif
+
+#endif
@@ -0,0 +1,287 @@
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "parsetrace.h"
+
+static const char TRACE_MAGIC[8] = {'A', 'P', 'T', 'R', 'A', 'C', 'E', '\0'};
+static const unsigned int TRACE_VERSION = 1;
+
+/* Class ParseTrace: Member functions */
+ARGPARSE_INLINE void ParseTrace :: initHeader(const unsigned int nRecords) {
+  memset(region, 0, regionSize);
+  memcpy(hdr()->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  hdr()->version = TRACE_VERSION;
+  hdr()->recordSize = sizeof(record_t);
+  hdr()->nRecords = nRecords;
+}
+
+ARGPARSE_INLINE ParseTrace :: ParseTrace(const unsigned int nRecords) :
+  region(0), regionSize(0), bMapped(false) {
+  const unsigned int nr = (nRecords > 0) ? nRecords : 1;
+  regionSize = sizeof(header_t) + nr * sizeof(record_t);
+  region = new char[regionSize];
+  initHeader(nr);
+}
+
+ARGPARSE_INLINE ParseTrace :: ParseTrace(const std::string & fileName,
+					 const unsigned int nRecords) :
+  region(0), regionSize(0), bMapped(true) {
+  const unsigned int nr = (nRecords > 0) ? nRecords : 1;
+  regionSize = sizeof(header_t) + nr * sizeof(record_t);
+
+  int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if ( fd < 0 )
+    throw traceFileErr();
+
+  struct stat st;
+  if ( fstat(fd, &st) != 0 ) {
+    close(fd);
+    throw traceFileErr();
+  }
+  const bool bSameSize = (static_cast<size_t>(st.st_size) == regionSize);
+
+  if ( !bSameSize && ftruncate(fd, regionSize) != 0 ) {
+    close(fd);
+    throw traceFileErr();
+  }
+
+  void * p = mmap(0, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( p == MAP_FAILED )
+    throw traceFileErr();
+  region = static_cast<char *>(p);
+
+  /* An existing trace of the same layout is appended to */
+  if ( !bSameSize || memcmp(hdr()->magic, TRACE_MAGIC, 8) != 0 ||
+       hdr()->version != TRACE_VERSION ||
+       hdr()->recordSize != sizeof(record_t) || hdr()->nRecords != nr )
+    initHeader(nr);
+}
+
+ARGPARSE_INLINE ParseTrace :: ~ParseTrace() {
+  if ( bMapped )
+    munmap(region, regionSize);
+  else
+    delete [] region;
+}
+
+ARGPARSE_INLINE
+void ParseTrace :: setArgNames(const std::vector<std::string> & names) {
+  char * buf = hdr()->names;
+  const size_t cap = sizeof(hdr()->names);
+
+  size_t len = 0;
+  for (unsigned int i = 0; i < names.size(); ++i) {
+    if ( len + names[i].size() + 1 > cap )
+      break;
+    memcpy(buf + len, names[i].c_str(), names[i].size() + 1);
+    len += names[i].size() + 1;
+  }
+  memset(buf + len, 0, cap - len);
+  hdr()->namesLen = len;
+}
+
+ARGPARSE_INLINE unsigned long long ParseTrace :: clock_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+ARGPARSE_INLINE
+void ParseTrace :: begin(record_t & rec, const int argc, char ** argv) {
+  memset(&rec, 0, sizeof(rec));
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  rec.timeNs = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  rec.argc = (argc > 0) ? argc : 0;
+
+  /* The tokens are hashed with their terminating '\0', so that token
+     boundaries count, and copied while they fit */
+  unsigned int h = 2166136261u;
+  size_t len = 0;
+  for (int i = 1; i < argc; ++i) {
+    const size_t tl = strlen(argv[i]) + 1;
+    h = fnv1a_hash(argv[i], tl, h);
+
+    if ( len < TEXT_LEN ) {
+      const size_t nc = (len + tl <= TEXT_LEN) ? tl : TEXT_LEN - len;
+      memcpy(rec.text + len, argv[i], nc);
+      len += nc;
+      if ( nc < tl )
+	rec.flags |= TRACE_TRUNCATED;
+    }
+    else {
+      rec.flags |= TRACE_TRUNCATED;
+    }
+  }
+  rec.argvHash = h;
+}
+
+ARGPARSE_INLINE
+void ParseTrace :: setError(record_t & rec, const std::string & msg) {
+  rec.flags |= TRACE_ERROR;
+
+  size_t ml = msg.size() + 1;
+  if ( ml > TEXT_LEN )
+    ml = TEXT_LEN;
+
+  /* Length of the tokens, up to their last terminating '\0' */
+  size_t len = TEXT_LEN;
+  while ( len > 0 && rec.text[len - 1] == '\0' )
+    len--;
+  if ( len > 0 && len + 1 + ml > TEXT_LEN )
+    rec.flags |= TRACE_TRUNCATED;
+
+  memmove(rec.text + ml, rec.text, TEXT_LEN - ml);
+  memcpy(rec.text, msg.c_str(), ml - 1);
+  rec.text[ml - 1] = '\0';
+}
+
+ARGPARSE_INLINE void ParseTrace :: append(record_t & rec) {
+  const unsigned long long s =
+    __atomic_fetch_add(&hdr()->nextSeq, 1ULL, __ATOMIC_RELAXED);
+  record_t * slot = ring() + s % hdr()->nRecords;
+
+  /* Readers skip the slot while its sequence number is 0 */
+  __atomic_store_n(&slot->seq, 0ULL, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  rec.seq = 0;
+  memcpy(slot, &rec, sizeof(record_t));
+  rec.seq = s + 1;
+  __atomic_store_n(&slot->seq, s + 1, __ATOMIC_RELEASE);
+}
+
+ARGPARSE_INLINE unsigned long long ParseTrace :: nRecorded() const {
+  return __atomic_load_n(&hdr()->nextSeq, __ATOMIC_ACQUIRE);
+}
+
+ARGPARSE_INLINE bool ParseTrace :: read(const char * buf, const size_t n,
+					std::vector<record_t> & recs,
+					std::vector<std::string> & names) {
+  recs.clear();
+  names.clear();
+
+  if ( n < sizeof(header_t) )
+    return false;
+
+  const header_t * h = reinterpret_cast<const header_t *>(buf);
+  if ( memcmp(h->magic, TRACE_MAGIC, 8) != 0 ||
+       h->version != TRACE_VERSION || h->recordSize != sizeof(record_t) ||
+       h->nRecords == 0 ||
+       n < sizeof(header_t) + h->nRecords * sizeof(record_t) )
+    return false;
+
+  const char * nb = h->names;
+  const char * ne = nb + std::min(static_cast<size_t>(h->namesLen),
+				  sizeof(h->names));
+  while ( nb < ne ) {
+    const size_t nl = strnlen(nb, ne - nb);
+    names.push_back(std::string(nb, nl));
+    nb += nl + 1;
+  }
+
+  const record_t * r =
+    reinterpret_cast<const record_t *>(buf + sizeof(header_t));
+  const unsigned long long next =
+    __atomic_load_n(&h->nextSeq, __ATOMIC_ACQUIRE);
+  const unsigned long long first =
+    (next > h->nRecords) ? next - h->nRecords : 0;
+
+  recs.reserve(next - first);
+  for (unsigned long long s = first; s < next; ++s) {
+    const record_t * slot = r + s % h->nRecords;
+
+    /* A record is complete if its sequence number is the expected one
+       before and after it is copied */
+    if ( __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != s + 1 )
+      continue;
+    record_t rec;
+    memcpy(&rec, slot, sizeof(record_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ( __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != s + 1 )
+      continue;
+
+    rec.seq = s + 1;
+    recs.push_back(rec);
+  }
+
+  return true;
+}
+
+/* Names of the arguments with bits set, e.g., " nForms verbose" */
+ARGPARSE_STATIC void format_bits(std::ostringstream & oss,
+				 const unsigned long long * bits,
+				 const unsigned int nArgs,
+				 const std::vector<std::string> & names) {
+  const unsigned int nb = (nArgs < ParseTrace::MAX_TRACE_ARGS) ? 
+    nArgs : ParseTrace::MAX_TRACE_ARGS;
+  for (unsigned int i = 0; i < nb; ++i) {
+    if ( (bits[i / 64] >> (i % 64) & 1ULL) == 0 )
+      continue;
+    if ( i < names.size() )
+      oss << " " << names[i];
+    else
+      oss << " #" << i;
+  }
+}
+
+ARGPARSE_INLINE
+std::string ParseTrace :: format(const record_t & rec,
+				 const std::vector<std::string> & names) {
+  std::ostringstream oss;
+
+  const time_t sec = rec.timeNs / 1000000000ULL;
+  struct tm tmv;
+  char tbuf[32];
+  localtime_r(&sec, &tmv);
+  strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tmv);
+
+  oss << "#" << rec.seq - 1 << " " << tbuf << "." << std::setfill('0')
+      << std::setw(6) << rec.timeNs % 1000000000ULL / 1000
+      << std::setfill(' ') << ((rec.flags & TRACE_ERROR) ? " ERROR" : " ok")
+      << " argc=" << rec.argc << " argv=" << std::hex << std::setfill('0')
+      << std::setw(8) << rec.argvHash << std::dec << std::setfill(' ')
+      << std::fixed << std::setprecision(1)
+      << " parse=" << rec.parseNs / 1e3 << "us"
+      << " check=" << rec.checkNs / 1e3 << "us";
+  if ( rec.flags & TRACE_LAZY )
+    oss << " lazy";
+  if ( rec.flags & TRACE_KNOWN )
+    oss << " known";
+
+  oss << " argv:";
+  format_bits(oss, rec.argvBits, rec.nArgs, names);
+  oss << " env:";
+  format_bits(oss, rec.envBits, rec.nArgs, names);
+  if ( rec.flags & TRACE_MANY_ARGS )
+    oss << " ...";
+
+  const char * p = rec.text;
+  const char * e = rec.text + TEXT_LEN;
+  if ( rec.flags & TRACE_ERROR ) {
+    const size_t ml = strnlen(p, e - p);
+    oss << " error: \"" << std::string(p, ml) << "\"";
+    p += ml + 1;
+  }
+
+  oss << " tokens:";
+  for (unsigned int i = 1; i < rec.argc && p < e; ++i) {
+    const size_t tl = strnlen(p, e - p);
+    oss << " " << std::string(p, tl);
+    p += tl + 1;
+  }
+  if ( rec.flags & TRACE_TRUNCATED )
+    oss << " ...";
+
+  return oss.str();
+}
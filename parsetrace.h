@@ -0,0 +1,137 @@
+#ifndef PARSETRACE_H
+#define PARSETRACE_H
+
+#include <string>
+#include <vector>
+
+/* ParseTrace:
+      Recorder of parses, for after-the-fact inspection of what a process
+   was given (see ArgumentParser::setTraceRecorder()). Every parse is
+   appended as a fixed-size binary record to a ring of nRecords records,
+   which overwrites the oldest records when full. The ring is held in
+   memory, or in a file mapped into memory (MAP_SHARED), so that the
+   records survive a crash of the process and can be read with
+   parsetrace_dump while it runs.
+
+   A record holds the time of the parse, the hash of the tokens and their
+   first bytes, the arguments given in argv and in the environment, the
+   durations of token parsing (including the conversion of values) and of
+   the checks after it (environment fallbacks, positional arguments,
+   constraints), and the error message of a failed parse. Recording takes
+   a few clock reads and one pass over the tokens, and does not allocate.
+
+   Records are written without locks: a writer claims a slot by an atomic
+   increment of the record counter and publishes the record by writing its
+   sequence number last, so that readers can skip records being written.
+   Parsers in several threads (or processes, through a file) can share a
+   recorder. Records are in native byte order. */
+class ParseTrace {
+ public:
+  static const unsigned int MAX_TRACE_ARGS = 256;
+  /* Arguments (by index in the parser) whose sources are recorded */
+
+  static const unsigned int TEXT_LEN = 152;
+
+  /* Flags of records */
+  static const unsigned short TRACE_ERROR = 1;     /* Parse failed */
+  static const unsigned short TRACE_TRUNCATED = 2; /* text truncated */
+  static const unsigned short TRACE_LAZY = 4;      /* Lazy conversion */
+  static const unsigned short TRACE_KNOWN = 8;     /* parse_known_args() */
+  static const unsigned short TRACE_MANY_ARGS = 16;
+  /* More than MAX_TRACE_ARGS arguments: the sources of the others are not
+     recorded */
+
+  /* A record (256 bytes) */
+  struct record_t {
+    unsigned long long seq;    /* Record number + 1; 0: being written */
+    unsigned long long timeNs; /* Start of the parse, ns since the epoch */
+    unsigned int argvHash;     /* FNV-1a hash of argv[1..argc-1] */
+    unsigned int argc;
+    unsigned int parseNs;      /* Duration of token parsing */
+    unsigned int checkNs;      /* Duration of the checks after it */
+    unsigned short nArgs;      /* Number of arguments of the parser */
+    unsigned short flags;
+    unsigned int reserved;
+    unsigned long long argvBits[MAX_TRACE_ARGS / 64];
+    /* Arguments given in argv, by index */
+    unsigned long long envBits[MAX_TRACE_ARGS / 64];
+    /* Arguments given in the environment, by index */
+    char text[TEXT_LEN];
+    /* Error message (failed parses) and tokens, separated by '\0' */
+  };
+
+ private:
+  /* Header at the start of the ring region (one page) */
+  struct header_t {
+    char magic[8];
+    unsigned int version;
+    unsigned int recordSize;
+    unsigned int nRecords; /* Capacity of the ring */
+    unsigned int namesLen;
+    unsigned long long nextSeq; /* Number of records claimed so far */
+    char names[4096 - 32];
+    /* Destination names of the arguments, by index, separated by '\0' */
+  };
+
+  char * region; /* Header followed by the ring */
+  size_t regionSize;
+  bool bMapped;  /* Whether region is a mapped file */
+
+  header_t * hdr() const { return reinterpret_cast<header_t *>(region); }
+  record_t * ring() const {
+    return reinterpret_cast<record_t *>(region + sizeof(header_t)); }
+
+  void initHeader(const unsigned int nRecords);
+
+  ParseTrace(const ParseTrace &);
+  ParseTrace & operator=(const ParseTrace &);
+
+ public:
+  /* Ring of nRecords records in memory */
+  ParseTrace(const unsigned int nRecords);
+  /* Ring of nRecords records in a file. An existing trace file of the
+     same capacity is appended to; any other file is overwritten.
+     Throws traceFileErr if the file cannot be created or mapped. */
+  ParseTrace(const std::string & fileName, const unsigned int nRecords);
+  ~ParseTrace();
+
+  /* Record the destination names of the arguments, by index, for the
+     decoding of the sources of records. Names beyond the room in the
+     header are dropped. */
+  void setArgNames(const std::vector<std::string> & names);
+
+  /* Start a record: time, tokens and their hash */
+  static void begin(record_t & rec, const int argc, char ** argv);
+  /* Set the error message of a record. The message goes before the tokens,
+     which are truncated if needed. */
+  static void setError(record_t & rec, const std::string & msg);
+  /* Monotonic clock (ns) */
+  static unsigned long long clock_ns();
+
+  /* Append a record to the ring, setting its sequence number */
+  void append(record_t & rec);
+
+  /* Number of records appended so far (including overwritten ones) */
+  unsigned long long nRecorded() const;
+
+  /* The whole ring region (header and records), e.g., for saving an
+     in-memory ring to a file */
+  const char * data() const { return region; }
+  size_t size() const { return regionSize; }
+
+  /* Decoding of ring regions (e.g., mapped trace files). read() gets the
+     complete records, oldest first, and the argument names; records
+     being written are skipped. Returns false for data that is not a
+     trace. */
+  static bool read(const char * buf, const size_t n,
+		   std::vector<record_t> & recs,
+		   std::vector<std::string> & names);
+  /* One-line description of a record, e.g.,
+     #12 2026-10-19 08:00:01.123456 ok argv=9f3e0a11 parse=2.1us ... */
+  static std::string format(const record_t & rec,
+			    const std::vector<std::string> & names);
+
+  class traceFileErr {};
+};
+
+#endif
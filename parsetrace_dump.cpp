@@ -0,0 +1,69 @@
+/* Reader of parse trace files (see ParseTrace in parsetrace.h): prints the
+   records, oldest first, one per line.
+
+   ./parsetrace_dump /var/tmp/myservice.trace
+   ./parsetrace_dump /var/tmp/myservice.trace -n 20 --errors
+
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "argparse.h"
+
+using namespace std;
+
+int main(int argc, char ** argv) {
+  ArgumentParser ap("parsetrace_dump", "Print the records of a parse trace");
+
+  ap.add_argument("traceFile", "traceFile", "Trace file",
+		  Argument::VAL_TYPE_STRING);
+  ap.add_argument("nLast", "-n", "Print only the last n records",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "--last"), 1);
+  ap["nLast"].setDefaultVal(0);
+  ap["nLast"].setAcceptSet(">=0");
+  ap.add_argument("errors", "--errors", "Print only failed parses",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+
+  if ( argc <= 1 ) {
+    ap.print_help();
+    return 0;
+  }
+
+  ap.parse_args(argc, argv);
+
+  const string fileName = ap["traceFile"];
+  size_t n = 0;
+  const char * buf = map_file(fileName, n);
+  if ( buf == 0 ) {
+    cerr << "ERROR: Failed to map trace file: " << fileName << endl;
+    return 1;
+  }
+
+  vector<ParseTrace::record_t> recs;
+  vector<string> names;
+  const bool bOkay = ParseTrace::read(buf, n, recs, names);
+  unmap_file(buf, n);
+  if ( !bOkay ) {
+    cerr << "ERROR: Not a parse trace file: " << fileName << endl;
+    return 1;
+  }
+
+  const bool bErrors = ap["errors"];
+  vector<const ParseTrace::record_t *> sel;
+  for (unsigned int i = 0; i < recs.size(); ++i)
+    if ( !bErrors || (recs[i].flags & ParseTrace::TRACE_ERROR) )
+      sel.push_back(&recs[i]);
+
+  const int nLast = ap["nLast"];
+  size_t i0 = 0;
+  if ( nLast > 0 && sel.size() > static_cast<size_t>(nLast) )
+    i0 = sel.size() - nLast;
+
+  for (size_t i = i0; i < sel.size(); ++i)
+    cout << ParseTrace::format(*sel[i], names) << endl;
+
+  return 0;
+}
@@ -0,0 +1,542 @@
+#include <bitset>
+#include <map>
+#include <algorithm>
+
+#include "utils.h"
+#include "pattern.h"
+
+/* Limits that keep compilation time and table size bounded */
+static const int MAX_NFA_STATES = 8192;
+static const int MAX_DFA_STATES = 4096;
+static const int MAX_REPEAT = 256;
+
+typedef std::bitset<256> charSet_t;
+
+/* Syntax tree of a regular expression */
+enum nodeType_t {NODE_EMPTY, NODE_CHARS, NODE_CONCAT, NODE_ALT, NODE_REPEAT};
+
+struct node_t {
+  nodeType_t type;
+  charSet_t cs;        /* NODE_CHARS */
+  std::vector<int> kids;    /* NODE_CONCAT, NODE_ALT, NODE_REPEAT */
+  int min, max;        /* NODE_REPEAT; max < 0: unbounded */
+};
+
+/* Recursive-descent parser:
+      alt    := concat ( '|' concat )*
+      concat := repeat*
+      repeat := atom ( '*' | '+' | '?' | '{m}' | '{m,}' | '{m,n}' )*
+      atom   := char | '.' | '[' class ']' | '\' escape | '(' alt ')' */
+class RegexParser {
+ private:
+  const std::string & re;
+  size_t p;
+
+  int newNode(const nodeType_t type) {
+    node_t nd;
+    nd.type = type;
+    nd.min = nd.max = 0;
+    nodes.push_back(nd);
+    return static_cast<int>(nodes.size()) - 1;
+  }
+
+  bool atEnd() const { return p >= re.size(); }
+
+  /* Character classes of \d \w \s (and the negated \D \W \S) */
+  static bool escapeClass(const char c, charSet_t & cs) {
+    cs.reset();
+    switch (c) {
+    case 'd': case 'D':
+      for (int k = '0'; k <= '9'; ++k)
+	cs.set(k);
+      break;
+    case 'w': case 'W':
+      for (int k = '0'; k <= '9'; ++k)
+	cs.set(k);
+      for (int k = 'a'; k <= 'z'; ++k)
+	cs.set(k);
+      for (int k = 'A'; k <= 'Z'; ++k)
+	cs.set(k);
+      cs.set('_');
+      break;
+    case 's': case 'S':
+      cs.set(' ');
+      cs.set('\t');
+      cs.set('\n');
+      cs.set('\r');
+      cs.set('\f');
+      cs.set('\v');
+      break;
+    default:
+      return false;
+    }
+
+    if ( c == 'D' || c == 'W' || c == 'S' )
+      cs.flip();
+    return true;
+  }
+
+  /* Single escaped character, e.g., \n or \. */
+  static unsigned char escapeChar(const char c) {
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default:  return static_cast<unsigned char>(c);
+    }
+  }
+
+  int parseClass() {
+    /* p points just past '[' */
+    charSet_t cs;
+    bool bNeg = false;
+    if ( !atEnd() && re[p] == '^' ) {
+      bNeg = true;
+      ++p;
+    }
+
+    bool bFirst = true;
+    while ( true ) {
+      if ( atEnd() )
+	throw Pattern::patternErr();
+      if ( re[p] == ']' && !bFirst )
+	break;
+      bFirst = false;
+
+      int lo;
+      if ( re[p] == '\\' ) {
+	if ( ++p >= re.size() )
+	  throw Pattern::patternErr();
+	charSet_t esc;
+	if ( escapeClass(re[p], esc) ) {
+	  cs |= esc;
+	  ++p;
+	  continue;
+	}
+	lo = escapeChar(re[p++]);
+      }
+      else {
+	lo = static_cast<unsigned char>(re[p++]);
+      }
+
+      int hi = lo;
+      if ( p + 1 < re.size() && re[p] == '-' && re[p + 1] != ']' ) {
+	++p;
+	if ( re[p] == '\\' ) {
+	  if ( ++p >= re.size() )
+	    throw Pattern::patternErr();
+	  hi = escapeChar(re[p++]);
+	}
+	else {
+	  hi = static_cast<unsigned char>(re[p++]);
+	}
+	if ( hi < lo )
+	  throw Pattern::patternErr();
+      }
+
+      for (int k = lo; k <= hi; ++k)
+	cs.set(k);
+    }
+    ++p; /* ']' */
+
+    if ( bNeg )
+      cs.flip();
+
+    int nd = newNode(NODE_CHARS);
+    nodes[nd].cs = cs;
+    return nd;
+  }
+
+  int parseAtom() {
+    const char c = re[p++];
+    int nd;
+
+    switch (c) {
+    case '(':
+      nd = parseAlt();
+      if ( atEnd() || re[p] != ')' )
+	throw Pattern::patternErr();
+      ++p;
+      return nd;
+    case '[':
+      return parseClass();
+    case '.':
+      nd = newNode(NODE_CHARS);
+      nodes[nd].cs.set();
+      return nd;
+    case '\\':
+      if ( atEnd() )
+	throw Pattern::patternErr();
+      nd = newNode(NODE_CHARS);
+      if ( !escapeClass(re[p], nodes[nd].cs) )
+	nodes[nd].cs.set(escapeChar(re[p]));
+      ++p;
+      return nd;
+    case ')': case '*': case '+': case '?': case '{': case '|':
+      throw Pattern::patternErr();
+    default:
+      nd = newNode(NODE_CHARS);
+      nodes[nd].cs.set(static_cast<unsigned char>(c));
+      return nd;
+    }
+  }
+
+  int parseNumber() {
+    if ( atEnd() || re[p] < '0' || re[p] > '9' )
+      throw Pattern::patternErr();
+    int n = 0;
+    while ( !atEnd() && re[p] >= '0' && re[p] <= '9' ) {
+      n = n * 10 + (re[p++] - '0');
+      if ( n > MAX_REPEAT )
+	throw Pattern::patternErr();
+    }
+    return n;
+  }
+
+  int parseRepeat() {
+    int nd = parseAtom();
+
+    while ( !atEnd() ) {
+      int min, max;
+      const char c = re[p];
+      if ( c == '*' ) {
+	min = 0;
+	max = -1;
+	++p;
+      }
+      else if ( c == '+' ) {
+	min = 1;
+	max = -1;
+	++p;
+      }
+      else if ( c == '?' ) {
+	min = 0;
+	max = 1;
+	++p;
+      }
+      else if ( c == '{' ) {
+	++p;
+	min = max = parseNumber();
+	if ( !atEnd() && re[p] == ',' ) {
+	  ++p;
+	  max = ( !atEnd() && re[p] == '}' ) ? -1 : parseNumber();
+	}
+	if ( atEnd() || re[p] != '}' || (max >= 0 && max < min) )
+	  throw Pattern::patternErr();
+	++p;
+      }
+      else {
+	break;
+      }
+
+      int rep = newNode(NODE_REPEAT);
+      nodes[rep].kids.push_back(nd);
+      nodes[rep].min = min;
+      nodes[rep].max = max;
+      nd = rep;
+    }
+
+    return nd;
+  }
+
+  int parseConcat() {
+    int nd = newNode(NODE_CONCAT);
+    while ( !atEnd() && re[p] != '|' && re[p] != ')' ) {
+      /* Anchors are implicit: ignore a leading ^ and a trailing $ */
+      if ( re[p] == '^' && p == 0 ) {
+	++p;
+	continue;
+      }
+      if ( re[p] == '$' && p + 1 == re.size() ) {
+	++p;
+	continue;
+      }
+
+      int kid = parseRepeat();
+      nodes[nd].kids.push_back(kid);
+    }
+    return nd;
+  }
+
+  int parseAlt() {
+    int first = parseConcat();
+    if ( atEnd() || re[p] != '|' )
+      return first;
+
+    int nd = newNode(NODE_ALT);
+    nodes[nd].kids.push_back(first);
+    while ( !atEnd() && re[p] == '|' ) {
+      ++p;
+      int kid = parseConcat();
+      nodes[nd].kids.push_back(kid);
+    }
+    return nd;
+  }
+
+ public:
+  std::vector<node_t> nodes;
+
+  RegexParser(const std::string & t_re) : re(t_re), p(0) {}
+
+  int parse() {
+    int root = parseAlt();
+    if ( !atEnd() ) /* Unbalanced ')' */
+      throw Pattern::patternErr();
+    return root;
+  }
+};
+
+/* Thompson NFA, built back to front: each state either consumes one
+   character of cs and moves to out, or (bEps) moves to out and/or out1
+   without consuming input. */
+struct nfaState_t {
+  bool bEps;
+  charSet_t cs;
+  int out, out1;
+};
+
+class NfaBuilder {
+ private:
+  const std::vector<node_t> & nodes;
+
+  int newState(const bool bEps, const int out, const int out1) {
+    if ( static_cast<int>(states.size()) >= MAX_NFA_STATES )
+      throw Pattern::patternErr();
+    nfaState_t st;
+    st.bEps = bEps;
+    st.out = out;
+    st.out1 = out1;
+    states.push_back(st);
+    return static_cast<int>(states.size()) - 1;
+  }
+
+ public:
+  std::vector<nfaState_t> states;
+
+  NfaBuilder(const std::vector<node_t> & t_nodes) : nodes(t_nodes) {}
+
+  /* Build the states of node nd, continuing to state next; returns the
+     entry state */
+  int build(const int nd, int next) {
+    const node_t & n = nodes[nd];
+    int s;
+
+    switch (n.type) {
+    case NODE_EMPTY:
+      return next;
+    case NODE_CHARS:
+      s = newState(false, next, -1);
+      states[s].cs = n.cs;
+      return s;
+    case NODE_CONCAT:
+      for (int k = static_cast<int>(n.kids.size()) - 1; k >= 0; --k)
+	next = build(n.kids[k], next);
+      return next;
+    case NODE_ALT:
+      s = build(n.kids.back(), next);
+      for (int k = static_cast<int>(n.kids.size()) - 2; k >= 0; --k) {
+	int alt = build(n.kids[k], next);
+	s = newState(true, alt, s);
+      }
+      return s;
+    case NODE_REPEAT:
+      if ( n.max < 0 ) {
+	/* Loop state: either one more repetition or leave */
+	int loop = newState(true, -1, next);
+	int body = build(n.kids[0], loop);
+	states[loop].out = body;
+	s = loop;
+      }
+      else {
+	/* Nested optional repetitions: (x(x)?)? */
+	s = next;
+	for (int k = 0; k < n.max - n.min; ++k) {
+	  int body = build(n.kids[0], s);
+	  s = newState(true, body, next);
+	}
+      }
+      for (int k = 0; k < n.min; ++k)
+	s = build(n.kids[0], s);
+      return s;
+    }
+
+    return next;
+  }
+};
+
+/* Add state s and everything reachable from it by epsilon moves */
+ARGPARSE_STATIC
+void closure(const std::vector<nfaState_t> & states, const int s,
+		    std::vector<bool> & inSet, std::vector<int> & out) {
+  std::vector<int> stack(1, s);
+  while ( !stack.empty() ) {
+    int t = stack.back();
+    stack.pop_back();
+    if ( t < 0 || inSet[t] )
+      continue;
+    inSet[t] = true;
+    out.push_back(t);
+    if ( states[t].bEps ) {
+      stack.push_back(states[t].out);
+      stack.push_back(states[t].out1);
+    }
+  }
+}
+
+ARGPARSE_INLINE Pattern::Pattern() : nClasses(0) {}
+
+ARGPARSE_INLINE void Pattern::compile_regex(const std::string & re) {
+  RegexParser parser(re);
+  const int root = parser.parse();
+
+  /* NFA: state 0 is the accepting state */
+  NfaBuilder nfa(parser.nodes);
+  nfaState_t acc;
+  acc.bEps = true;
+  acc.out = acc.out1 = -1;
+  nfa.states.push_back(acc);
+  const int start = nfa.build(root, 0);
+  const std::vector<nfaState_t> & ns = nfa.states;
+  const int nNfa = static_cast<int>(ns.size());
+
+  /* Byte classes: bytes that belong to exactly the same character sets
+     behave identically and share a column */
+  std::vector<int> charStates;
+  for (int s = 0; s < nNfa; ++s)
+    if ( !ns[s].bEps )
+      charStates.push_back(s);
+
+  byteClass.assign(256, 0);
+  {
+    std::map<std::vector<bool>, int> sigs;
+    for (int c = 0; c < 256; ++c) {
+      std::vector<bool> sig(charStates.size());
+      for (size_t k = 0; k < charStates.size(); ++k)
+	sig[k] = ns[charStates[k]].cs.test(c);
+      std::map<std::vector<bool>, int>::iterator it = sigs.find(sig);
+      if ( it == sigs.end() )
+	it = sigs.insert(std::make_pair(sig, static_cast<int>(sigs.size()))).first;
+      byteClass[c] = static_cast<unsigned char>(it->second);
+    }
+    nClasses = static_cast<int>(sigs.size());
+  }
+
+  std::vector<int> classRep(nClasses, -1); /* One byte of each class */
+  for (int c = 0; c < 256; ++c)
+    if ( classRep[byteClass[c]] < 0 )
+      classRep[byteClass[c]] = c;
+
+  /* Subset construction */
+  std::vector< std::vector<int> > dStates;
+  std::map<std::vector<int>, int> dIndex;
+  std::vector<bool> inSet(nNfa, false);
+
+  {
+    std::vector<int> s0;
+    closure(ns, start, inSet, s0);
+    std::sort(s0.begin(), s0.end());
+    dIndex[s0] = 0;
+    dStates.push_back(s0);
+  }
+
+  trans.clear();
+  accepting.clear();
+  for (size_t d = 0; d < dStates.size(); ++d) {
+    /* dStates may grow: copy the set */
+    const std::vector<int> cur = dStates[d];
+    accepting.push_back(std::binary_search(cur.begin(), cur.end(), 0));
+
+    for (int cl = 0; cl < nClasses; ++cl) {
+      const int c = classRep[cl];
+      std::vector<int> nxt;
+      std::fill(inSet.begin(), inSet.end(), false);
+      for (size_t k = 0; k < cur.size(); ++k) {
+	const nfaState_t & st = ns[cur[k]];
+	if ( !st.bEps && st.cs.test(c) )
+	  closure(ns, st.out, inSet, nxt);
+      }
+
+      if ( nxt.empty() ) {
+	trans.push_back(-1);
+	continue;
+      }
+
+      std::sort(nxt.begin(), nxt.end());
+      std::map<std::vector<int>, int>::iterator it = dIndex.find(nxt);
+      if ( it == dIndex.end() ) {
+	if ( static_cast<int>(dStates.size()) >= MAX_DFA_STATES )
+	  throw patternErr();
+	it = dIndex.insert(std::make_pair(nxt,
+				     static_cast<int>(dStates.size()))).first;
+	dStates.push_back(nxt);
+      }
+      trans.push_back(it->second);
+    }
+  }
+}
+
+ARGPARSE_INLINE void Pattern::compile_glob(const std::string & glob) {
+  /* Translate into an equivalent regular expression */
+  std::string re;
+  for (size_t i = 0; i < glob.size(); ++i) {
+    const char c = glob[i];
+    if ( c == '*' ) {
+      re += ".*";
+    }
+    else if ( c == '?' ) {
+      re += '.';
+    }
+    else if ( c == '[' ) {
+      size_t j = i + 1;
+      std::string cls("[");
+      if ( j < glob.size() && (glob[j] == '!' || glob[j] == '^') ) {
+	cls += '^';
+	++j;
+      }
+      if ( j < glob.size() && glob[j] == ']' )
+	cls += glob[j++];
+      while ( j < glob.size() && glob[j] != ']' ) {
+	if ( glob[j] == '\\' )
+	  cls += '\\';
+	cls += glob[j++];
+      }
+      if ( j >= glob.size() ) /* No closing ']': literal '[' */
+	re += "\\[";
+      else {
+	re += cls + "]";
+	i = j;
+      }
+    }
+    else {
+      if ( std::string("\\.^$|()[]{}*+?").find(c) != std::string::npos )
+	re += '\\';
+      re += c;
+    }
+  }
+
+  compile_regex(re);
+}
+
+ARGPARSE_INLINE bool Pattern::match(const char * s, const size_t n) const {
+  if ( accepting.empty() )
+    return false;
+
+  int st = 0;
+  for (size_t i = 0; i < n; ++i) {
+    st = trans[st * nClasses + byteClass[static_cast<unsigned char>(s[i])]];
+    if ( st < 0 )
+      return false;
+  }
+  return accepting[st];
+}
+
+ARGPARSE_INLINE bool Pattern::match(const std::string & s) const {
+  return match(s.data(), s.size());
+}
+
+ARGPARSE_INLINE size_t Pattern::memUsage() const {
+  return byteClass.capacity() + trans.capacity() * sizeof(int)
+    + accepting.capacity() / 8;
+}
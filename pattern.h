@@ -0,0 +1,59 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <string>
+#include <vector>
+
+/* Pattern:
+      A regular expression or glob pattern compiled into a deterministic
+   finite automaton (DFA). Matching takes a single pass over the string,
+   one table lookup per character, without backtracking. Patterns always
+   match whole strings.
+
+   Regular expression syntax:
+      literal characters, . (any character), [a-z0-9_] and [^...] classes,
+      \d \w \s \D \W \S, escaped metacharacters (e.g., \. \*),
+      grouping ( ), alternation |, quantifiers * + ? {m} {m,} {m,n}.
+      Leading ^ and trailing $ are accepted and ignored.
+      e.g., [a-z]{3}\d+
+   Glob syntax:
+      * (any string), ? (any character), [...] and [!...] classes.
+      e.g., s3-*-prod */
+class Pattern {
+ private:
+  int nClasses;
+  /* Number of byte classes: bytes that no part of the pattern tells apart
+     share one column of the transition table */
+  std::vector<unsigned char> byteClass; /* Byte --> byte class */
+
+  std::vector<int> trans;
+  /* Transition table: trans[state * nClasses + class] = next state,
+     or -1 for no match. State 0 is the start state. */
+  std::vector<bool> accepting; /* Accepting states */
+
+ public:
+  Pattern();
+
+  /* Compile a regular expression or a glob pattern.
+     Throws patternErr on syntax errors or overly large patterns. */
+  void compile_regex(const std::string & re);
+  void compile_glob(const std::string & glob);
+
+  /* Test if the whole string matches */
+  bool match(const char * s, const size_t n) const;
+  bool match(const std::string & s) const;
+
+  /* Whether a pattern has been compiled */
+  bool empty() const { return accepting.empty(); }
+
+  /* Number of DFA states */
+  size_t nStates() const { return accepting.size(); }
+
+  /* Heap memory used (bytes) */
+  size_t memUsage() const;
+
+  /* Exceptions */
+  class patternErr {};
+};
+
+#endif
@@ -0,0 +1,150 @@
+/* Allocation-counting tests of argparse-cpp.
+
+   The global operator new and operator delete are replaced by versions that
+   count allocations. Once a parser has been constructed and has parsed a
+   command line (which builds its switch index and sizes the storage of the
+   values), parsing a command line of known switches with numeric and
+   Boolean values, and reading the scalar values back, must not allocate.
+   Neither must recording the parses with a ParseTrace, nor exporting the
+   configuration into a reserved buffer or to a file descriptor.
+
+   ./test_alloc
+
+*/
+
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "argparse.h"
+
+using namespace std;
+
+static unsigned long nAllocs = 0; /* Number of allocations so far */
+
+void * operator new(size_t n) {
+  nAllocs++;
+  void * p = malloc(n ? n : 1);
+  if ( p == 0 )
+    throw bad_alloc();
+  return p;
+}
+
+void * operator new[](size_t n) {
+  return operator new(n);
+}
+
+void operator delete(void * p) throw() {
+  free(p);
+}
+
+void operator delete[](void * p) throw() {
+  free(p);
+}
+
+static int nFailed = 0;
+
+/* Report the number of allocations of a test */
+static void check(const char * name, const unsigned long n,
+		  const bool bExpectZero) {
+  const bool bPass = bExpectZero ? (n == 0) : (n > 0);
+  cout << (bPass ? "PASS: " : "FAIL: ") << name << ": " << n
+       << " allocation(s)" << endl;
+  if ( !bPass )
+    nFailed++;
+}
+
+int main() {
+  ArgumentParser ap("test_alloc", "Allocation-counting tests");
+
+  ap.add_argument("count", "count", "Positional integer",
+		  Argument::VAL_TYPE_INT);
+  ap["count"].setAcceptSet(">0");
+
+  ap.add_argument("nForms", "--n-forms", "Integer with a range",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(1, "-n"));
+  ap["nForms"].setAcceptSet(">0<=100");
+  ap["nForms"].setDefaultVal(1);
+
+  ap.add_argument("ratio", "--ratio", "Float with a range",
+		  Argument::VAL_TYPE_FLOAT);
+  ap["ratio"].setAcceptSet(">=0<=1");
+
+  ap.add_argument("range", "--range", "Pair of integers",
+		  Argument::VAL_TYPE_INT, Argument::DEFAULT_ACTION,
+		  vector<string>(), 2);
+
+  ap.add_argument("offset", "--offset", "Integer", Argument::VAL_TYPE_INT);
+  ap.add_argument("verbose", "-v", "Verbose mode",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("color", "-c", "Color mode",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_FALSE);
+
+  const char * toks[] = {"test_alloc", "485", "--n-forms", "43", "-v",
+			 "--ratio", "0.25", "--range", "-8", "7",
+			 "--offset", "-3", "-c"};
+  const int ntoks = sizeof(toks) / sizeof(toks[0]);
+  vector<char *> targv(ntoks + 1, static_cast<char *>(0));
+  for (int i = 0; i < ntoks; ++i)
+    targv[i] = const_cast<char *>(toks[i]);
+
+  /* The first parse builds the switch index and sizes the values */
+  ap.parse_args(ntoks, &targv[0]);
+
+  unsigned long n0 = nAllocs;
+  ap.parse_args(ntoks, &targv[0]);
+  check("parse_args()", nAllocs - n0, true);
+
+  n0 = nAllocs;
+  for (int k = 0; k < 1000; ++k)
+    ap.parse_args(ntoks, &targv[0]);
+  check("parse_args() x 1000", nAllocs - n0, true);
+
+  ParseTrace trace(16);
+  ap.setTraceRecorder(&trace);
+  n0 = nAllocs;
+  for (int k = 0; k < 100; ++k)
+    ap.parse_args(ntoks, &targv[0]);
+  check("parse_args() x 100, recorded", nAllocs - n0, true);
+  ap.setTraceRecorder(0);
+
+  n0 = nAllocs;
+  int count = ap["count"];
+  int nForms = ap["nForms"];
+  float ratio = ap["ratio"];
+  int offset = ap["offset"];
+  bool bVerbose = ap["verbose"];
+  bool bColor = ap["color"];
+  check("scalar value access", nAllocs - n0, true);
+
+  string exported;
+  exported.reserve(4096);
+  n0 = nAllocs;
+  ap.export_json(exported);
+  ap.export_kv(exported);
+  check("export_json() and export_kv() into a buffer", nAllocs - n0, true);
+
+  const int fd = open("/dev/null", O_WRONLY);
+  n0 = nAllocs;
+  ap.export_json(fd);
+  check("export_json() to a file descriptor", nAllocs - n0, true);
+  close(fd);
+
+  /* Sanity check of the counting: vector getters return copies */
+  n0 = nAllocs;
+  vector<int> range = ap["range"].getIntVals();
+  check("vector value access (allocates)", nAllocs - n0, false);
+
+  if ( count != 485 || nForms != 43 || ratio != 0.25f || offset != -3 ||
+       !bVerbose || bColor || range.size() != 2 || range[0] != -8 ) {
+    cout << "FAIL: unexpected values" << endl;
+    nFailed++;
+  }
+
+  return (nFailed == 0) ? 0 : 1;
+}
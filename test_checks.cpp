@@ -0,0 +1,1174 @@
+/* Behavioural checks of argparse-cpp.
+
+   Each check exercises a feature through the public interface and
+   compares the outcome (values, errors and their text) with the expected
+   one. The help and error output of the parser for expected errors is
+   suppressed.
+
+   ./test_checks
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <csignal>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <utility>
+
+#include "argparse.h"
+
+using namespace std;
+
+static int nFailed = 0;
+
+/* Report the outcome of a check */
+static void check(const string & name, const bool bPass) {
+  cout << (bPass ? "PASS: " : "FAIL: ") << name << endl;
+  if ( !bPass )
+    nFailed++;
+}
+
+/* Silences cout and cerr while it exists; text() is what they received */
+class Quiet {
+  streambuf * outBuf;
+  streambuf * errBuf;
+  ostringstream sink;
+
+ public:
+  Quiet() : 
+    outBuf(cout.rdbuf(sink.rdbuf())), errBuf(cerr.rdbuf(sink.rdbuf())) {}
+  ~Quiet() {
+    cout.rdbuf(outBuf);
+    cerr.rdbuf(errBuf);
+  }
+  string text() const { return sink.str(); }
+};
+
+/* Parse the space-separated tokens of cmdLine (after the program name)
+   with ap. Return value: the error message of argParsingErr, or "" if the
+   parse succeeds. Values of optional arguments outside the acceptance set
+   are returned as "(valOutsideAcceptanceSet)", other exceptions as 
+   "(exception)". */
+static string parse(ArgumentParser & ap, const string & cmdLine) {
+  istringstream iss(cmdLine);
+  vector<string> toks(1, "test_checks");
+  string t;
+  while ( iss >> t )
+    toks.push_back(t);
+
+  vector<char *> targv(toks.size() + 1, static_cast<char *>(0));
+  for (unsigned int i = 0; i < toks.size(); ++i)
+    targv[i] = const_cast<char *>(toks[i].c_str());
+
+  Quiet q;
+  try {
+    ap.parse_args(toks.size(), &targv[0]);
+  }
+  catch (const ArgumentParser::argParsingErr & err) {
+    return err.getErrMsg().empty() ? "(argParsingErr)" : err.getErrMsg();
+  }
+  catch (Argument::valOutsideAcceptanceSet) {
+    return "(valOutsideAcceptanceSet)";
+  }
+  catch (...) {
+    return "(exception)";
+  }
+  return "";
+}
+
+/* Whether s contains sub */
+static bool contains(const string & s, const string & sub) {
+  return s.find(sub) != string::npos;
+}
+
+/* The strings of v, separated by spaces */
+static string join(const vector<string> & v) {
+  string s;
+  for (unsigned int i = 0; i < v.size(); ++i)
+    s += (i ? " " : "") + v[i];
+  return s;
+}
+
+/* Environment-variable fallbacks */
+static void check_env() {
+  ArgumentParser ap("test_checks", "Environment fallbacks");
+  ap.setEnvPrefix("TCHK_");
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  ap["nForms"].setAcceptSet(">0<=100");
+  ap.add_argument("mode", "--mode", "String");
+  ap["mode"].setEnvVar("TCHK_OTHER_MODE");
+  ap.add_argument("verbose", "-v", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+
+  setenv("TCHK_NFORMS", "42", 1);
+  setenv("TCHK_OTHER_MODE", "fast", 1);
+  setenv("TCHK_VERBOSE", "1", 1);
+  string err = parse(ap, "");
+  check("env: values from the environment", err.empty() &&
+	int(ap["nForms"]) == 42 && string(ap["mode"]) == "fast" &&
+	bool(ap["verbose"]));
+
+  err = parse(ap, "--n-forms 7");
+  check("env: argv takes precedence", err.empty() && int(ap["nForms"]) == 7);
+
+  setenv("TCHK_NFORMS", "420", 1);
+  ArgumentParser bp = ap;
+  err = parse(bp, "");
+  check("env: value outside acceptance set rejected",
+	contains(err, "acceptance set") && contains(err, "TCHK_NFORMS"));
+  unsetenv("TCHK_NFORMS");
+
+  /* Two arguments, one variable */
+  ArgumentParser cp("test_checks", "Clashing environment variables");
+  cp.setEnvPrefix("TCHK_");
+  cp.add_argument("n.forms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  cp.add_argument("n_forms", "--n_forms", "Integer", Argument::VAL_TYPE_INT);
+  err = parse(cp, "");
+  check("env: two arguments with the same variable rejected",
+	contains(err, "same environment variable TCHK_N_FORMS"));
+
+  unsetenv("TCHK_OTHER_MODE");
+  unsetenv("TCHK_VERBOSE");
+}
+
+/* Streaming parses: tokens written to a pipe in chunks, with a pause 
+   between the chunks so that they arrive in separate reads */
+struct streamRun_t {
+  vector<unsigned int> batchSizes;
+  vector<string> vals;
+};
+
+static void collect_batch(const vector<string> & vals, void * userData) {
+  streamRun_t & run = *static_cast<streamRun_t *>(userData);
+  run.batchSizes.push_back(vals.size());
+  run.vals.insert(run.vals.end(), vals.begin(), vals.end());
+}
+
+static void write_chunks(const int fd, const vector<string> * chunks) {
+  for (unsigned int i = 0; i < chunks->size(); ++i) {
+    if ( i > 0 )
+      this_thread::sleep_for(chrono::milliseconds(20));
+    const string & c = (*chunks)[i];
+    size_t off = 0;
+    while ( off < c.size() ) {
+      const ssize_t nw = write(fd, c.data() + off, c.size() - off);
+      if ( nw <= 0 )
+	break;
+      off += nw;
+    }
+  }
+  close(fd);
+}
+
+/* Parse the stream of chunks with ap; the error message as in parse() */
+static string parse_chunks(ArgumentParser & ap, const vector<string> & chunks,
+			   streamRun_t & run, const char delim='\0', 
+			   const unsigned int batchSize=1024) {
+  int fds[2];
+  if ( pipe(fds) != 0 )
+    return "(pipe)";
+  thread writer(write_chunks, fds[1], &chunks);
+
+  string err;
+  {
+    Quiet q;
+    try {
+      ap.parse_stream(fds[0], collect_batch, &run, delim, batchSize);
+    }
+    catch (const ArgumentParser::argParsingErr & e) {
+      err = e.getErrMsg();
+    }
+    catch (...) {
+      err = "(exception)";
+    }
+  }
+  close(fds[0]); /* The writer stops on a failed parse (SIGPIPE ignored) */
+  writer.join();
+  return err;
+}
+
+/* The space-separated tokens of text, separated by null characters */
+static string nul_separated(const string & text) {
+  string s(text);
+  replace(s.begin(), s.end(), ' ', '\0');
+  return s;
+}
+
+static void stream_parser(ArgumentParser & ap) {
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  ap.add_argument("range", "--range", "Range", Argument::VAL_TYPE_INT,
+		  Argument::DEFAULT_ACTION, vector<string>(), 2);
+  ap.add_argument("verbose", "-v", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  parse(ap, "");
+}
+
+static void check_stream() {
+  signal(SIGPIPE, SIG_IGN);
+
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    const string err = parse_chunks(ap, vector<string>(1, 
+      nul_separated("a --n-forms 7 b c -v d e")), run, '\0', 2);
+    const unsigned int sizes[] = {2, 2, 1};
+    check("stream: delimiters, switches and batches", err.empty() && 
+	  int(ap["nForms"]) == 7 && bool(ap["verbose"]) && 
+	  join(run.vals) == "a b c d e" && 
+	  run.batchSizes == vector<unsigned int>(sizes, sizes + 3));
+  }
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    const string err = parse_chunks(ap, 
+      vector<string>(1, "x y\n--range\n3\n4\nz\n"), run, '\n');
+    const vector<int> range = ap["range"].getIntVals();
+    check("stream: other delimiters, nargs > 1", err.empty() && 
+	  range.size() == 2 && range[0] == 3 && range[1] == 4 &&
+	  run.vals.size() == 2 && run.vals[0] == "x y" && run.vals[1] == "z");
+  }
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    vector<string> chunks;
+    chunks.push_back(nul_separated("a --ran"));
+    chunks.push_back(nul_separated("ge 1"));
+    chunks.push_back(nul_separated(" 2 b"));
+    const string err = parse_chunks(ap, chunks, run);
+    const vector<int> range = ap["range"].getIntVals();
+    check("stream: switch and values split across reads", err.empty() && 
+	  range.size() == 2 && range[0] == 1 && range[1] == 2 &&
+	  join(run.vals) == "a b");
+  }
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    const string err = parse_chunks(ap, 
+      vector<string>(1, nul_separated("a -- -v --n-forms")), run);
+    check("stream: no switches after --", err.empty() && 
+	  !bool(ap["verbose"]) && join(run.vals) == "a -v --n-forms");
+  }
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    const string err = parse_chunks(ap, 
+      vector<string>(1, nul_separated("a --range 1")), run);
+    check("stream: too few values at the end", 
+	  err == "ERROR: Too few arguments");
+  }
+  {
+    ArgumentParser ap("test_checks", "Streaming");
+    stream_parser(ap);
+    streamRun_t run;
+    const string err = parse_chunks(ap, 
+      vector<string>(1, nul_separated("a ") + string(70000, 'x')), run);
+    check("stream: token longer than the buffer", 
+	  contains(err, "exceeds 65536 characters"));
+  }
+}
+
+/* Validator rejecting values starting with "bad", counting its calls in 
+   *ctx (if given) */
+static bool reject_bad(const char * val, string & msg, void * ctx) {
+  if ( ctx != 0 )
+    (*static_cast<unsigned int *>(ctx))++;
+  if ( strncmp(val, "bad", 3) != 0 )
+    return true;
+  msg = "rejected";
+  return false;
+}
+
+/* Switches read from the stream are validated too, and path patterns 
+   expanded */
+static void check_stream_validation() {
+  unsigned int nCalls = 0;
+  ArgumentParser ap("test_checks", "Streaming");
+  ap.setValidatorThreads(1);
+  ap.add_argument("out", "--out", "Output");
+  ap["out"].setValidator(reject_bad, &nCalls);
+  ap.add_argument("tags", "-t", "Tags", Argument::VAL_TYPE_STRING, 
+		  Argument::APPEND);
+  ap["tags"].setValidator(reject_bad, &nCalls);
+  ap.add_argument("inputs", "--in", "Inputs", Argument::VAL_TYPE_PATH, 
+		  Argument::APPEND);
+  ap["inputs"].setPathOptions(Argument::PATH_GLOB | Argument::PATH_FILE);
+
+  string err = parse(ap, "-t a -t b --in test_checks.cpp");
+  streamRun_t run;
+  nCalls = 0;
+  err += parse_chunks(ap, vector<string>(1, 
+    nul_separated("x --out good -t c --in argparse.[ch]* y")), run);
+  check("stream: values validated, appended ones only", err.empty() && 
+	nCalls == 2 && join(ap["tags"].getStringVals()) == "a b c" &&
+	join(ap["inputs"].getStringVals()) == 
+	"test_checks.cpp argparse.cpp argparse.h");
+
+  ArgumentParser bp("test_checks", "Streaming");
+  bp.add_argument("out", "--out", "Output");
+  bp["out"].setValidator(reject_bad, &nCalls);
+  bp.add_argument("inputs", "--in", "Inputs", Argument::VAL_TYPE_PATH, 
+		  Argument::APPEND);
+  bp["inputs"].setPathOptions(Argument::PATH_GLOB | Argument::PATH_FILE);
+  parse(bp, "");
+  err = parse_chunks(bp, vector<string>(1, 
+    nul_separated("--out bad --in tchk-nosuch-* --in .")), run);
+  check("stream: failures reported", contains(err, "out: bad: rejected") &&
+	contains(err, "inputs: tchk-nosuch-*: No match") && 
+	contains(err, "inputs: .: Not a regular file"));
+}
+
+/* Schema snapshots: a parser loaded from a snapshot behaves as the one 
+   that has been dumped */
+static void build_schema(ArgumentParser & ap) {
+  ap.add_argument("formType", "formType", "Type of form");
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  ap["nForms"].setDefaultVal(100);
+  ap["nForms"].setAcceptSet(">0<=1000");
+  ap.add_argument("ratio", "-r", "Float", Argument::VAL_TYPE_FLOAT);
+  ap.add_argument("center", "--center", "String");
+  ap["center"].setAcceptSet("NSC,TSC");
+  ap.add_argument("labels", "-l", "Map", Argument::VAL_TYPE_MAP);
+  ap.add_argument("incDirs", "-I", "Directories", Argument::VAL_TYPE_STRING,
+		  Argument::APPEND);
+  ap.add_argument("verbose", "-v", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("quiet", "-q", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_conflicts("verbose", "quiet");
+  ap.add_requires("ratio", "center");
+}
+
+static void check_schema() {
+  ArgumentParser ap("test_checks", "Schema snapshots");
+  build_schema(ap);
+  const string snap = ap.dump_schema("v1");
+
+  ArgumentParser lp("test_checks", "Schema snapshots");
+  check("schema: snapshot loaded", 
+	lp.load_schema(snap.data(), snap.size(), "v1"));
+  check("schema: same help", 
+	lp.getHelpString(80, 24) == ap.getHelpString(80, 24));
+
+  const string cmdLine = 
+    "485 --n-forms 7 -r 0.5 --center TSC -l a=1,b=2 -I x -I y -v";
+  const string err = parse(ap, cmdLine);
+  const string lErr = parse(lp, cmdLine);
+  string kv, lKv;
+  ap.export_kv(kv);
+  lp.export_kv(lKv);
+  check("schema: same values", err.empty() && lErr.empty() && kv == lKv);
+
+  check("schema: acceptance set kept", 
+	parse(lp, "485 --center XSC") == "(valOutsideAcceptanceSet)" &&
+	parse(lp, "485 --n-forms 0") == "(valOutsideAcceptanceSet)");
+  check("schema: constraints kept", 
+	contains(parse(lp, "485 -v -q"), "-v conflicts with -q") &&
+	contains(parse(lp, "485 -r 0.5"), "-r requires --center"));
+
+  const string fileName = "test_checks.schema";
+  ap.save_schema(fileName, "v1");
+  ArgumentParser fp("test_checks", "Schema snapshots");
+  const bool bLoaded = fp.load_schema_file(fileName, "v1");
+  remove(fileName.c_str());
+  const string fErr = parse(fp, cmdLine);
+  string fKv;
+  fp.export_kv(fKv);
+  check("schema: file round trip", bLoaded && fErr.empty() && fKv == kv);
+
+  ArgumentParser sp("test_checks", "Schema snapshots");
+  check("schema: stale snapshot refused", 
+	!sp.load_schema(snap.data(), snap.size(), "v2"));
+  check("schema: truncated snapshot refused", 
+	!sp.load_schema(snap.data(), snap.size() / 2, "v1"));
+}
+
+/* Parse results blobs: round trips, and bad blobs refused without 
+   changing the parser */
+static string results_blob(const unsigned int nA, const unsigned int nB,
+			   const bool bRepeat) {
+  string blob("APRS");
+  pack_uint32(blob, 1);
+  pack_uint32(blob, 2);
+  const unsigned int nVals[] = {nA, nB};
+  for (unsigned int k = 0; k < 2; ++k) {
+    pack_string(blob, (k == 0 || bRepeat) ? "a" : "b");
+    pack_uint32(blob, 1);
+    pack_uint32(blob, Argument::VAL_TYPE_INT);
+    pack_uint32(blob, nVals[k]);
+    for (unsigned int i = 0; i < nVals[k]; ++i)
+      pack_uint32(blob, 5);
+  }
+  return blob;
+}
+
+static bool load_refused(ArgumentParser & ap, const string & blob) {
+  try {
+    ap.load_results(blob);
+  }
+  catch (ArgumentParser::resultsFormatErr) {
+    return true;
+  }
+  return false;
+}
+
+static void check_results() {
+  ArgumentParser ap("test_checks", "Parse results");
+  build_schema(ap);
+  string err = parse(ap, "485 --n-forms 7 -r 0.5 --center TSC -l a=1,b=2 "
+		     "-I x -I y -v");
+  const string blob = ap.dump_results();
+
+  /* The sources of the values (argv, environment) are not in the blob */
+  ArgumentParser lp("test_checks", "Parse results");
+  build_schema(lp);
+  lp.load_results(blob);
+  check("results: round trip", err.empty() && lp.dump_results() == blob &&
+	int(lp["nForms"]) == 7 && float(lp["ratio"]) == 0.5f && 
+	join(lp["incDirs"].getStringVals()) == "x y" && 
+	lp["labels"].getMapVal("b") == "2" && bool(lp["verbose"]));
+
+  ArgumentParser bp("test_checks", "Parse results");
+  bp.add_argument("a", "-a", "Integer", Argument::VAL_TYPE_INT);
+  bp.add_argument("b", "-b", "Integer", Argument::VAL_TYPE_INT);
+  err = parse(bp, "-a 1 -b 2");
+  const string good = results_blob(1, 1, false);
+  check("results: hand-made blob loaded", err.empty() && 
+	!load_refused(bp, good) && int(bp["a"]) == 5 && int(bp["b"]) == 5);
+
+  parse(bp, "-a 1 -b 2");
+  check("results: set argument without values refused", 
+	load_refused(bp, results_blob(1, 0, false)));
+  check("results: too many values refused", 
+	load_refused(bp, results_blob(1, 2, false)));
+  check("results: repeated argument refused", 
+	load_refused(bp, results_blob(1, 1, true)));
+  check("results: trailing bytes refused", load_refused(bp, good + "x"));
+  check("results: truncated blob refused", 
+	load_refused(bp, good.substr(0, good.size() - 1)));
+  check("results: refused blobs leave the values unchanged", 
+	int(bp["a"]) == 1 && int(bp["b"]) == 2);
+}
+
+/* Appended values of an earlier parse are replaced, whether the values 
+   come from argv or the environment, and under lazy conversion */
+static void check_append() {
+  for (int lazy = 0; lazy < 2; ++lazy) {
+    const string tag = lazy ? "append (lazy): " : "append: ";
+    ArgumentParser ap("test_checks", "Repeated parses");
+    ap.setLazyConversion(lazy != 0);
+    ap.add_argument("incDirs", "-I", "Directories", 
+		    Argument::VAL_TYPE_STRING, Argument::APPEND);
+    ap.add_argument("levels", "-L", "Levels", 
+		    Argument::VAL_TYPE_INT, Argument::APPEND);
+    ap["incDirs"].setEnvVar("TCHK_INC");
+
+    string err = parse(ap, "-I x -L 1");
+    err += parse(ap, "-I x -L 1");
+    check(tag + "second parse replaces the values", err.empty() &&
+	  join(ap["incDirs"].getStringVals()) == "x" && 
+	  ap["levels"].getNVals() == 1);
+
+    err = parse(ap, "-I x -I y -L 1 -L 2");
+    err += parse(ap, "-I z -L 3");
+    check(tag + "values of one parse only", err.empty() &&
+	  join(ap["incDirs"].getStringVals()) == "z" && 
+	  ap["levels"].getIntVals() == vector<int>(1, 3));
+
+    setenv("TCHK_INC", "a b", 1);
+    err = parse(ap, "");
+    err += parse(ap, "");
+    check(tag + "environment values of one parse only", err.empty() &&
+	  join(ap["incDirs"].getStringVals()) == "a b");
+    unsetenv("TCHK_INC");
+  }
+}
+
+/* Map values: each pair is inserted once, so that repeated keys are 
+   detected under DUP_KEY_ERROR */
+static void check_map() {
+  ArgumentParser ap("test_checks", "Map values");
+  ap.add_argument("labels", "-l", "Map", Argument::VAL_TYPE_MAP);
+  ap["labels"].setDupKeyPolicy(Argument::DUP_KEY_ERROR);
+
+  string err = parse(ap, "-l a=1,b=2");
+  check("map: distinct keys accepted", 
+	err.empty() && ap["labels"].getMapVals().size() == 2);
+  check("map: repeated key rejected", !parse(ap, "-l a=1,a=2").empty());
+
+  bool bThrown = false;
+  try {
+    ap["labels"].setVal(vector<string>(1, "c=3,d=4"));
+  }
+  catch (...) {
+    bThrown = true;
+  }
+  check("map: setVal(vector) inserts each pair once", !bThrown && 
+	ap["labels"].getMapVals().size() == 2 && 
+	ap["labels"].getMapVal("c") == "3");
+}
+
+/* Patterns: regular expressions and globs match whole strings */
+struct patternCase_t {
+  bool bGlob;
+  const char * pat;
+  const char * str;
+  bool bMatch;
+};
+
+static void check_pattern() {
+  const patternCase_t cases[] = {
+    {false, "ab", "ab", true},
+    {false, "ab", "abc", false},
+    {false, "ab", "xab", false},
+    {false, "a|bc", "a", true},
+    {false, "a|bc", "abc", false},
+    {false, "^ab$", "ab", true},
+    {false, "[a-z]{3}\\d+", "abc12", true},
+    {false, "[a-z]{3}\\d+", "abc", false},
+    {false, "[a-z]{3}\\d+", "abcd1", false},
+    {false, "(ab)*c?", "", true},
+    {false, "(ab)*c?", "ababc", true},
+    {false, "(ab)*c?", "aba", false},
+    {false, "[^0-9]+", "ab", true},
+    {false, "[^0-9]+", "a1", false},
+    {false, "\\.x", ".x", true},
+    {false, "\\.x", "ax", false},
+    {true, "s3-*-prod", "s3-eu-prod", true},
+    {true, "s3-*-prod", "s3-eu-prod2", false},
+    {true, "s3-*-prod", "xs3-eu-prod", false},
+    {true, "?", "a", true},
+    {true, "?", "", false},
+    {true, "?", "ab", false},
+    {true, "[!abc]x", "dx", true},
+    {true, "[!abc]x", "ax", false},
+    {true, "[!abc]x", "x", false},
+    {true, "[a-c]*", "b12", true},
+    {true, "[a-c]*", "d12", false},
+    {true, "a[b", "a[b", true},  /* No closing ']': literal '[' */
+    {true, "a[b", "ab", false},
+    {true, "*", "", true},
+  };
+  const unsigned int nCases = sizeof(cases) / sizeof(cases[0]);
+
+  bool bPass = true;
+  for (unsigned int i = 0; i < nCases; ++i) {
+    Pattern p;
+    if ( cases[i].bGlob )
+      p.compile_glob(cases[i].pat);
+    else
+      p.compile_regex(cases[i].pat);
+    if ( p.match(cases[i].str) != cases[i].bMatch ) {
+      cout << "  " << cases[i].pat << " vs \"" << cases[i].str << "\"" 
+	   << endl;
+      bPass = false;
+    }
+  }
+  check("pattern: whole-string matches", bPass);
+
+  bool bThrown = false;
+  try {
+    Pattern p;
+    p.compile_regex("a[bc");
+  }
+  catch (Pattern::patternErr) {
+    bThrown = true;
+  }
+  check("pattern: unclosed class in a regex rejected", bThrown);
+
+  ArgumentParser ap("test_checks", "Pattern acceptance sets");
+  ap.add_argument("bucket", "--bucket", "String");
+  ap["bucket"].setAcceptSet("glob:s3-*-prod");
+  check("pattern: acceptance set by glob", 
+	parse(ap, "--bucket s3-eu-prod").empty() && 
+	!parse(ap, "--bucket s3-eu-prod2").empty());
+}
+
+/* Constraints between optional arguments, and their error messages */
+static void check_constraints() {
+  ArgumentParser ap("test_checks", "Constraints");
+  ap.setEnvPrefix("TCHK_");
+  ap.add_argument("file", "file", "Positional");
+  const char * switches[] = {"--json", "--yaml", "--csv", "-v", "-q"};
+  const char * dests[] = {"json", "yaml", "csv", "verbose", "quiet"};
+  for (unsigned int i = 0; i < 5; ++i)
+    ap.add_argument(dests[i], switches[i], "Switch",
+		    Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("user", "--user", "String");
+  ap.add_argument("password", "--password", "String");
+  ap["password"].setDefaultVal(string("secret"));
+  ap.add_argument("out", "-o", "String");
+  ap.add_argument("format", "-f", "String");
+
+  vector<string> formats;
+  formats.push_back("json");
+  formats.push_back("yaml");
+  formats.push_back("csv");
+  ap.add_mutually_exclusive(formats);
+  vector<string> login;
+  login.push_back("user");
+  login.push_back("password");
+  ap.add_required_together(login);
+  ap.add_requires("out", "format");
+  ap.add_conflicts("verbose", "quiet");
+
+  check("constraints: satisfied", 
+	parse(ap, "f --json -o x -f y --user u --password p -v").empty());
+  check("constraints: mutually exclusive", 
+	parse(ap, "f --json --csv") == "ERROR: Mutually exclusive optional "
+	"arguments given together: --json, --csv");
+  check("constraints: required together (defaults do not count)", 
+	parse(ap, "f --user u") == "ERROR: Optional arguments --user must "
+	"be given together with --password");
+  check("constraints: requires", 
+	parse(ap, "f -o x") == "ERROR: Optional argument -o requires -f");
+  check("constraints: conflicts", 
+	parse(ap, "f -q -v") == "ERROR: Optional argument -v conflicts "
+	"with -q");
+
+  setenv("TCHK_PASSWORD", "p", 1);
+  check("constraints: environment values count", 
+	parse(ap, "f --user u").empty());
+  unsetenv("TCHK_PASSWORD");
+
+  bool bNotFound = false;
+  try {
+    ap.add_requires("out", "nonexistent");
+  }
+  catch (ArgumentParser::argNotFoundErr) {
+    bNotFound = true;
+  }
+  bool bPositional = false;
+  try {
+    ap.add_conflicts("file", "out");
+  }
+  catch (ArgumentParser::constraintErr) {
+    bPositional = true;
+  }
+  check("constraints: unknown and positional arguments rejected", 
+	bNotFound && bPositional);
+}
+
+/* parse_known_args(): the unrecognized tokens are moved to the front of
+   argv, in order, followed by a null pointer */
+static void check_known_args() {
+  ArgumentParser ap("test_checks", "Known arguments");
+  ap.add_argument("cmd", "cmd", "Positional");
+  ap.add_argument("verbose", "-v", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+
+  char t0[] = "test_checks", t1[] = "run", t2[] = "--foo", t3[] = "bar";
+  char t4[] = "-v", t5[] = "--n-forms", t6[] = "3", t7[] = "--x=y";
+  char * targv[] = {t0, t1, t2, t3, t4, t5, t6, t7, 0};
+  int n = -1;
+  {
+    Quiet q;
+    n = ap.parse_known_args(8, targv);
+  }
+  check("known args: recognized values", string(ap["cmd"]) == "run" && 
+	bool(ap["verbose"]) && int(ap["nForms"]) == 3);
+  check("known args: unrecognized tokens moved, in order", n == 3 && 
+	targv[0] == t0 && targv[1] == t2 && targv[2] == t3 && 
+	targv[3] == t7);
+  check("known args: null terminator", targv[n + 1] == 0);
+
+  /* A variadic positional argument after the unrecognized tokens */
+  ArgumentParser rp("test_checks", "Known arguments");
+  rp.add_argument("cmd", "cmd", "Positional");
+  rp.add_argument("files", "files", "Remainder", Argument::VAL_TYPE_STRING,
+		  Argument::DEFAULT_ACTION, vector<string>(), 
+		  Argument::NARGS_REMAINDER);
+  char r1[] = "--foo", r2[] = "run", r3[] = "a", r4[] = "b";
+  char * rargv[] = {t0, r1, r2, r3, r4, 0};
+  {
+    Quiet q;
+    n = rp.parse_known_args(5, rargv);
+  }
+  check("known args: variadic argument kept", n == 1 && 
+	rargv[1] == r1 && rargv[2] == 0 && string(rp["cmd"]) == "run" &&
+	join(rp["files"].getStringVals()) == "a b");
+
+  /* ... directly after them: moved up by one, into argv[argc] */
+  char * dargv[] = {t0, r2, r1, r3, r4, 0};
+  {
+    Quiet q;
+    n = rp.parse_known_args(5, dargv);
+  }
+  check("known args: variadic argument moved up", n == 1 && 
+	dargv[1] == r1 && dargv[2] == 0 && string(rp["cmd"]) == "run" &&
+	join(rp["files"].getStringVals()) == "a b");
+}
+
+/* BK-tree searches: the same hits as a brute-force scan with 
+   edit_distance() */
+typedef vector<pair<unsigned int, unsigned int> > hits_t;
+
+static void check_bktree() {
+  check("bktree: edit distances", edit_distance("kitten", "sitting") == 3 &&
+	edit_distance("", "abc") == 3 && edit_distance("abc", "abc") == 0 &&
+	edit_distance("flaw", "lawn") == 2);
+
+  /* Random strings over a small alphabet, so that many are close, and 
+     some duplicates */
+  unsigned int seed = 12345;
+  vector<string> strs;
+  for (unsigned int i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    string str((seed >> 16) % 9 + 1, 'a');
+    for (unsigned int c = 0; c < str.size(); ++c) {
+      seed = seed * 1103515245 + 12345;
+      str[c] = "abcde-"[(seed >> 16) % 6];
+    }
+    strs.push_back(str);
+  }
+  strs.push_back(strs[7]);
+  strs.push_back(strs[100]);
+
+  BKTree tree;
+  tree.build(strs);
+
+  bool bPass = true;
+  for (unsigned int q = 0; q < 200 && bPass; ++q) {
+    const string & query = (q % 2) ? strs[q * 7] : strs[q] + "x";
+    for (unsigned int k = 0; k <= 3; ++k) {
+      hits_t hits;
+      tree.search(query.data(), query.size(), k, hits);
+      sort(hits.begin(), hits.end());
+
+      /* Duplicates are reported once, under the lowest index */
+      hits_t expected;
+      for (unsigned int i = 0; i < strs.size(); ++i) {
+	const unsigned int d = edit_distance(query, strs[i]);
+	if ( d <= k && 
+	     find(strs.begin(), strs.begin() + i, strs[i]) == 
+	     strs.begin() + i )
+	  expected.push_back(make_pair(d, i));
+      }
+      sort(expected.begin(), expected.end());
+
+      if ( hits != expected ) {
+	cout << "  " << query << " within " << k << ": " << hits.size() 
+	     << " hits, " << expected.size() << " expected" << endl;
+	bPass = false;
+	break;
+      }
+    }
+  }
+  check("bktree: hits as by brute force", bPass);
+
+  ArgumentParser ap("test_checks", "Suggestions");
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  ap.add_argument("verbose", "--verbose", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  const vector<string> sugg = ap.suggest_switches("--n-form");
+  check("bktree: closest switch suggested", 
+	sugg.size() == 1 && sugg[0] == "--n-forms" &&
+	contains(parse(ap, "--verbos"), "(did you mean --verbose?)"));
+}
+
+/* Floats of the exports: the shortest decimal that reads back as the 
+   same float */
+static string float_text(const float f) {
+  string s;
+  OutputSink os(s);
+  os.putFloat(f);
+  os.flush();
+  return s;
+}
+
+static bool float_round_trip(const float f) {
+  const string s = float_text(f);
+  const float g = strtof(s.c_str(), 0);
+  if ( memcmp(&f, &g, sizeof(f)) != 0 )
+    return false;
+
+  /* No shorter "%.*g" string reads back */
+  char buf[32];
+  for (int prec = 1; prec < 9; ++prec) {
+    snprintf(buf, sizeof(buf), "%.*g", prec, f);
+    if ( strtof(buf, 0) == f )
+      return s.size() <= strlen(buf);
+  }
+  return true;
+}
+
+static void check_float() {
+  const float specials[] = {0.1f, 0.3f, 1.0f, -2.5f, 100.0f, 1e10f, 
+			    123456.7f, 16777216.0f, 3.4028235e38f, FLT_MIN,
+			    1e-45f, 1.4e-45f, 2e-40f, -0.0f, 0.0f};
+  bool bPass = true;
+  for (unsigned int i = 0; i < sizeof(specials) / sizeof(float); ++i)
+    if ( !float_round_trip(specials[i]) ) {
+      cout << "  " << float_text(specials[i]) << endl;
+      bPass = false;
+    }
+  check("float: selected values round-trip, shortest", bPass);
+  check("float: short forms", float_text(0.1f) == "0.1" && 
+	float_text(-2.5f) == "-2.5" && float_text(-0.0f) == "-0");
+  check("float: non-finite values", float_text(NAN) == "nan" &&
+	float_text(INFINITY) == "inf" && float_text(-INFINITY) == "-inf");
+
+  /* Bit patterns sampled over the whole range, non-finite ones skipped */
+  unsigned int seed = 2024;
+  unsigned int nFailedVals = 0;
+  for (unsigned int i = 0; i < 50000; ++i) {
+    seed = seed * 1664525 + 1013904223;
+    float f;
+    memcpy(&f, &seed, sizeof(f));
+    if ( !isfinite(f) )
+      continue;
+    if ( !float_round_trip(f) && nFailedVals++ < 5 )
+      cout << "  " << float_text(f) << endl;
+  }
+  check("float: sampled values round-trip, shortest", nFailedVals == 0);
+}
+
+/* Custom value types: durations such as 1m30s, held as seconds */
+static bool duration_parse(const char * s, const size_t n, void * val) {
+  unsigned int t = 0, cur = 0;
+  bool bDigit = false;
+  for (size_t i = 0; i < n; ++i) {
+    if ( s[i] >= '0' && s[i] <= '9' ) {
+      cur = cur * 10 + (s[i] - '0');
+      bDigit = true;
+    }
+    else if ( bDigit && (s[i] == 'h' || s[i] == 'm' || s[i] == 's') ) {
+      t += cur * ((s[i] == 'h') ? 3600 : (s[i] == 'm') ? 60 : 1);
+      cur = 0;
+      bDigit = false;
+    }
+    else
+      return false;
+  }
+  if ( n == 0 )
+    return false;
+  t += cur;
+  memcpy(val, &t, sizeof(t));
+  return true;
+}
+
+/* Acceptance sets of the form "<=limit" */
+static bool duration_accept(const void * val, const char * as, 
+			    const size_t n) {
+  unsigned int t, limit;
+  memcpy(&t, val, sizeof(t));
+  if ( n < 3 || as[0] != '<' || as[1] != '=' || 
+       !duration_parse(as + 2, n - 2, &limit) )
+    return false;
+  return t <= limit;
+}
+
+static size_t duration_format(const void * val, char * buf, const size_t n) {
+  unsigned int t;
+  memcpy(&t, val, sizeof(t));
+  const int len = snprintf(buf, n, "%um%us", t / 60, t % 60);
+  return (static_cast<size_t>(len) < n) ? len : n;
+}
+
+/* The exception of registering vt: "illegal", "duplicate" or "" */
+static string registration_err(const ValueType & vt) {
+  try {
+    Argument::registerValueType(vt);
+  }
+  catch (Argument::illegalValueTypeErr) {
+    return "illegal";
+  }
+  catch (Argument::duplicateValueTypeErr) {
+    return "duplicate";
+  }
+  return "";
+}
+
+static void check_custom() {
+  const ValueType vt = {"tchk_duration", sizeof(unsigned int), 
+			duration_parse, duration_accept, duration_format};
+  const ValueType * reg = Argument::registerValueType(vt);
+  check("custom: registration", reg != 0 && 
+	Argument::findValueType("tchk_duration") == reg && 
+	Argument::registerValueType(vt) == reg && 
+	Argument::findValueType("tchk_nosuch") == 0);
+
+  ValueType other = vt;
+  other.accept = 0;
+  ValueType noName = vt;
+  noName.name = 0;
+  ValueType noSize = vt;
+  noSize.name = "tchk_nosize";
+  noSize.size = 0;
+  ValueType noParse = vt;
+  noParse.name = "tchk_noparse";
+  noParse.parse = 0;
+  ValueType noFormat = vt;
+  noFormat.name = "tchk_noformat";
+  noFormat.format = 0;
+  check("custom: duplicate and incomplete tables refused", 
+	registration_err(other) == "duplicate" && 
+	registration_err(noName) == "illegal" && 
+	registration_err(noSize) == "illegal" && 
+	registration_err(noParse) == "illegal" && 
+	registration_err(noFormat) == "illegal");
+
+  ArgumentParser ap("test_checks", "Custom value types");
+  ap.add_argument("timeout", "--timeout", "Timeout", "tchk_duration");
+  ap["timeout"].setDefaultVal(string("1m"));
+  ap["timeout"].setAcceptSet("<=10m");
+  ap.add_argument("steps", "--step", "Steps", "tchk_duration", 
+		  Argument::APPEND);
+  bool bUnknown = false;
+  try {
+    ap.add_argument("x", "--x", "Unknown", "tchk_nosuch");
+  }
+  catch (ArgumentParser::unknownValueTypeErr) {
+    bUnknown = true;
+  }
+  check("custom: default value, unknown type names", bUnknown && 
+	ap["timeout"].getCustomVal<unsigned int>() == 60);
+
+  string err = parse(ap, "--timeout 1m30s --step 5 --step 2h");
+  const vector<unsigned int> steps = ap["steps"].getCustomVals<unsigned int>();
+  check("custom: values", err.empty() && 
+	ap["timeout"].getCustomVal<unsigned int>() == 90 && 
+	steps.size() == 2 && steps[0] == 5 && steps[1] == 7200);
+
+  string kv;
+  ap.export_kv(kv);
+  check("custom: exported text", contains(kv, "timeout=1m30s\n") && 
+	contains(kv, "steps=0m5s 120m0s\n"));
+
+  check("custom: rejected by the acceptance hook", 
+	parse(ap, "--timeout 11m") == "(valOutsideAcceptanceSet)" &&
+	parse(ap, "--timeout 10m").empty());
+  check("custom: malformed values rejected", 
+	!parse(ap, "--timeout 1x").empty());
+}
+
+/* Help text: words longer than a line are broken up, silently */
+static void check_help() {
+  ArgumentParser ap("test_checks", "Help with a " + string(120, 'y') + 
+		    " word");
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  string help, out;
+  {
+    Quiet q;
+    help = ap.getHelpString(80, 24);
+    out = q.text();
+  }
+  check("help: long words broken up without output", out.empty() && 
+	contains(help, string(60, 'y')) && !contains(help, string(81, 'y')));
+}
+
+/* Shell completion */
+static string complete_text(ArgumentParser & ap, const string & line) {
+  istringstream iss(line);
+  vector<string> words;
+  string w;
+  while ( iss >> w )
+    words.push_back(w);
+  if ( line.empty() || line[line.size() - 1] == ' ' )
+    words.push_back(""); /* Empty word under the cursor */
+  return join(ap.complete(words));
+}
+
+static void check_complete() {
+  ArgumentParser ap("test_checks", "Completion");
+  ap.add_argument("center", "center", "Processing center");
+  ap["center"].setAcceptSet("NSC,TSC");
+  ap.add_argument("mode", "--mode", "Mode");
+  ap["mode"].setAcceptSet("fast,slow,safe");
+  ap.add_argument("nForms", "--n-forms", "Integer", Argument::VAL_TYPE_INT);
+  ap.add_argument("name", "--name", "Name");
+  ap.add_argument("verbose", "-v", "Switch",
+		  Argument::VAL_TYPE_BOOL, Argument::STORE_TRUE);
+  ap.add_argument("incDirs", "-I", "Directories", 
+		  Argument::VAL_TYPE_STRING, Argument::APPEND);
+
+  check("complete: switch prefixes", 
+	complete_text(ap, "--n") == "--n-forms --name" &&
+	complete_text(ap, "--m") == "--mode");
+  check("complete: given switches left out unless repeatable", 
+	complete_text(ap, "-v -I x -") == 
+	"--mode --n-forms --name -I");
+  check("complete: acceptance values after a switch", 
+	complete_text(ap, "--mode ") == "fast safe slow" &&
+	complete_text(ap, "--mode s") == "safe slow" &&
+	complete_text(ap, "--n-forms ").empty());
+  check("complete: acceptance values of positional arguments", 
+	complete_text(ap, "") == "NSC TSC" && 
+	complete_text(ap, "-v T") == "TSC");
+  check("complete: no switches after --", 
+	complete_text(ap, "-- -").empty() && 
+	complete_text(ap, "-- N") == "NSC");
+
+  char c0[] = "test_checks", c1[] = "__complete", c2[] = "--mo";
+  char * cargv[] = {c0, c1, c2, 0};
+  bool bHandled = false;
+  string out;
+  {
+    Quiet q;
+    bHandled = ap.handle_completion(3, cargv);
+    out = q.text();
+  }
+  char * pargv[] = {c0, c2, 0};
+  check("complete: __complete query served", bHandled && 
+	out == "--mode\n" && !ap.handle_completion(2, pargv));
+
+  bool bThrown = false;
+  try {
+    ap.completion_script("tcsh");
+  }
+  catch (ArgumentParser::unsupportedShellErr) {
+    bThrown = true;
+  }
+  check("complete: scripts", bThrown && 
+	contains(ap.completion_script("bash"), "__complete") &&
+	contains(ap.completion_script("zsh"), "__complete") &&
+	contains(ap.completion_script("fish"), "__complete"));
+}
+
+/* Validators and path checks: all failures in one report, in the order 
+   of destination names and values, whatever the number of threads */
+static string validation_report(const string & cmdLine, 
+				const unsigned int nThreads) {
+  ArgumentParser ap("test_checks", "Validation");
+  ap.setValidatorThreads(nThreads);
+  ap.add_argument("b", "-b", "String");
+  ap["b"].setValidator(reject_bad);
+  ap.add_argument("a", "-a", "Strings", Argument::VAL_TYPE_STRING, 
+		  Argument::APPEND);
+  ap["a"].setValidator(reject_bad);
+  return parse(ap, cmdLine);
+}
+
+static void touch(const string & path) {
+  close(open(path.c_str(), O_WRONLY | O_CREAT, 0644));
+}
+
+static void check_validation() {
+  check("validation: failures together, in order", 
+	validation_report("-b bad0 -a x -a bad2 -a y -a bad1", 1) == 
+	"ERROR: Validation failed for 3 value(s):\n  a: bad2: rejected\n"
+	"  a: bad1: rejected\n  b: bad0: rejected" &&
+	validation_report("-a x -b y", 1).empty());
+
+  /* Many values: the report is the same on one thread and on several */
+  string cmdLine;
+  for (unsigned int i = 0; i < 300; ++i) {
+    ostringstream oss;
+    oss << " -a " << ((i % 7 == 0) ? "bad" : "ok") << i;
+    cmdLine += oss.str();
+  }
+  const string report = validation_report(cmdLine, 1);
+  check("validation: same report on 1 and 8 threads", 
+	contains(report, "failed for 43 value(s):\n  a: bad0: rejected\n"
+		 "  a: bad7: rejected") && 
+	contains(report, "\n  ... (23 more)") && 
+	validation_report(cmdLine, 8) == report);
+
+  /* Path checks and expansion, in a temporary directory:
+     day-1/part-1, day-1/part-2, day-2/part-3, day-3/ */
+  char dirTmpl[] = "/tmp/test_checks_XXXXXX";
+  if ( mkdtemp(dirTmpl) == 0 ) {
+    check("validation: temporary directory", false);
+    return;
+  }
+  const string dir(dirTmpl);
+  const char * subs[] = {"/day-1", "/day-2", "/day-3"};
+  for (unsigned int i = 0; i < 3; ++i)
+    mkdir((dir + subs[i]).c_str(), 0755);
+  const char * files[] = {"/day-1/part-1", "/day-1/part-2", "/day-2/part-3"};
+  for (unsigned int i = 0; i < 3; ++i)
+    touch(dir + files[i]);
+
+  for (unsigned int nThreads = 1; nThreads <= 4; nThreads += 3) {
+    ArgumentParser ap("test_checks", "Paths");
+    ap.setValidatorThreads(nThreads);
+    ap.add_argument("inputs", "--in", "Inputs", Argument::VAL_TYPE_PATH, 
+		    Argument::APPEND);
+    ap["inputs"].setPathOptions(Argument::PATH_GLOB | Argument::PATH_FILE);
+    ap.add_argument("outDir", "--out", "Output", Argument::VAL_TYPE_PATH);
+    ap["outDir"].setPathOptions(Argument::PATH_DIR);
+    ap.add_argument("config", "--config", "Config", Argument::VAL_TYPE_PATH);
+    ap["config"].setPathOptions(Argument::PATH_EXISTS);
+
+    const string tag = (nThreads == 1) ? "paths: " : "paths (4 threads): ";
+    string err = parse(ap, "--in " + dir + "/day-*/part-* --in " + dir + 
+		       files[0] + " --out " + dir + "/day-3 --config " + dir);
+    check(tag + "wildcards in two components expanded", err.empty() &&
+	  join(ap["inputs"].getStringVals()) == dir + files[0] + " " + 
+	  dir + files[1] + " " + dir + files[2] + " " + dir + files[0]);
+
+    err = parse(ap, "--in " + dir + "/day-*/nosuch-* --in " + dir + 
+		"/day-3 --out " + dir + files[2] + " --config " + dir + 
+		"/nosuch");
+    check(tag + "unmatched patterns, files and directories", err == 
+	  "ERROR: Validation failed for 4 value(s):\n  inputs: " + dir + 
+	  "/day-*/nosuch-*: No match\n  config: " + dir + 
+	  "/nosuch: No such file or directory\n  inputs: " + dir + 
+	  "/day-3: Not a regular file\n  outDir: " + dir + files[2] + 
+	  ": Not a directory");
+  }
+
+  bool bAction = false, bType = false;
+  try {
+    ArgumentParser ap("test_checks", "Paths");
+    ap.add_argument("input", "--in", "Input", Argument::VAL_TYPE_PATH);
+    ap["input"].setPathOptions(Argument::PATH_GLOB);
+  }
+  catch (Argument::illegalActionType) {
+    bAction = true;
+  }
+  try {
+    ArgumentParser ap("test_checks", "Paths");
+    ap.add_argument("input", "--in", "Input");
+    ap["input"].setPathOptions(Argument::PATH_FILE);
+  }
+  catch (Argument::valTypeErr) {
+    bType = true;
+  }
+  check("paths: options refused for other actions and types", 
+	bAction && bType);
+
+  for (unsigned int i = 0; i < 3; ++i)
+    unlink((dir + files[i]).c_str());
+  for (unsigned int i = 0; i < 3; ++i)
+    rmdir((dir + subs[i]).c_str());
+  rmdir(dirTmpl);
+}
+
+int main() {
+  check_env();
+  check_schema();
+  check_results();
+  check_stream();
+  check_stream_validation();
+  check_append();
+  check_map();
+  check_pattern();
+  check_constraints();
+  check_known_args();
+  check_bktree();
+  check_complete();
+  check_help();
+  check_custom();
+  check_validation();
+  check_float();
+
+  return (nFailed == 0) ? 0 : 1;
+}
@@ -1,70 +1,102 @@
-#include "utils.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-using namespace std;
+#include "utils.h"
 
 /* String utility functions */
-/* Find all instances of a sub-string in a string */
-std::vector<size_t> string_find(std::string s, std::string subs){
-  std::vector<size_t> matches;
-
-  size_t pos = 0;
-
-  while ((pos = s.find(subs, pos)) != std::string::npos) {
-    // cout << "pos = " << pos << endl;
-    matches.push_back(pos);
-    pos ++;
-  }
+/* Split string by any delimiter string */
+ARGPARSE_INLINE
+std::vector<std::string> split_string(const std::string & s, 
+				      const std::string & subs) {
+  std::vector<std::string> tokens;
 
-  return matches;
+  StringSplitter sp(s.data(), s.size(), subs.data(), subs.size());
+  const char * t;
+  size_t tl;
+  while ( sp.next(t, tl) )
+    tokens.push_back(std::string(t, tl));
 
+  return tokens;
 }
 
-/* Split string by any delimiter string */
-std::vector<std::string> split_string(std::string s, std::string subs) {
-  std::vector<std::string> tokens;
-  std::vector<size_t> dp; /* Delimiter positions */
+/* Class StringSplitter: Member functions */
+ARGPARSE_INLINE 
+StringSplitter :: StringSplitter(const char * s, const size_t n, 
+				 const char * t_delim, const size_t t_dl) :
+  p(s), end(s + n), delim(t_delim), dl(t_dl), dc('\0'), bDone(false) {
+}
 
-  size_t dl = subs.length(); /* Delimiter length */
-  std::string str;
-  size_t p = 0;
+ARGPARSE_INLINE 
+StringSplitter :: StringSplitter(const std::string & s, const char t_dc) :
+  p(s.data()), end(s.data() + s.size()), delim(0), dl(1), dc(t_dc), 
+  bDone(false) {
+  delim = &dc;
+}
 
-  // DEBUG
-  // cout << "split_string: dl = " << dl << endl;
+ARGPARSE_INLINE bool StringSplitter :: next(const char * & tok, size_t & tl) {
+  if ( bDone )
+    return false;
 
-  if (dl == 0) {
-    tokens.push_back(s);
+  tok = p;
+  if ( dl == 0 ) {
+    tl = end - p;
+    bDone = true;
+    return true;
   }
-  else {
-    dp = string_find(s, subs);
 
-    if (dp.size() == 0) {
-      tokens.push_back(s);
+  /* Candidate positions of the delimiter are found by its first character */
+  const char * q = p;
+  while ( true ) {
+    const size_t nLeft = end - q;
+    const char * c = (nLeft < dl) ? 0 : 
+      static_cast<const char *>(memchr(q, delim[0], nLeft - dl + 1));
+    if ( c == 0 ) {
+      tl = end - p;
+      bDone = true;
+      return true;
     }
-    else {
-      for (size_t i0 = 0; i0 <= dp.size(); i0++) {
-	// DEBUG
-	// cout << "split_sring: i0 = " << i0 << "; p = " << p << endl;
-
-	if (i0 < dp.size())
-	  str = s.substr(p, dp[i0] - p);
-	else
-	  str = s.substr(p, s.length() - p);
-	
-	p = dp[i0] + dl;
-
-	tokens.push_back(str);
-      }
+
+    if ( dl == 1 || memcmp(c + 1, delim + 1, dl - 1) == 0 ) {
+      tl = c - p;
+      p = c + dl;
+      return true;
     }
+    q = c + 1;
   }
+}
 
-  return tokens;
+/* Get the next white-space separated word */
+ARGPARSE_INLINE bool next_word(const char * & p, const char * end, 
+			       const char * & w, size_t & wl) {
+  while ( p < end && isspace(static_cast<unsigned char>(*p)) )
+    p++;
+  if ( p == end )
+    return false;
+
+  w = p;
+  while ( p < end && !isspace(static_cast<unsigned char>(*p)) )
+    p++;
+  wl = p - w;
+  return true;
 }
 
 /* Interpreting boolean strings. 
  Return values: -1: uninterpretable string
                  0: false
 		 1: true */
-int interpret_bool_string(const std::string inStr) {
+ARGPARSE_INLINE int interpret_bool_string(const std::string & inStr) {
   if ( inStr == "true" || inStr == "True" || inStr == "TRUE" 
        || inStr == "T" || inStr == "t" || inStr == "1" )
     return 1;
@@ -78,7 +110,7 @@ int interpret_bool_string(const std::string inStr) {
 /* Test if a string is a number, 
    e.g. -1, 0.0, 3, 3.14, .025.
    Limitatin cannot hanle scientific notations such as 1e2. */
-bool is_string_numeric(const std::string str) {
+ARGPARSE_INLINE bool is_string_numeric(const std::string & str) {
   if ( str.empty() )
     return false;
 
@@ -114,6 +146,43 @@ bool is_string_numeric(const std::string str) {
 
 }
 
+/* Error messages of check_number() */
+ARGPARSE_INLINE void report_check_number_err(const std::string & msg) {
+  std::cerr << msg << std::endl;
+}
+
+/* Classify a token */
+ARGPARSE_INLINE tokenKind_t classify_token(const char * t) {
+  if ( t[0] != '-' || t[1] == '\0' )
+    return TOKEN_VALUE;
+
+  if ( t[1] == '-' )
+    return (t[2] == '\0') ? TOKEN_TERMINATOR : TOKEN_LONG_SWITCH;
+
+  /* Negative numbers: digits and at most one '.', with at least one digit */
+  int nDot = 0;
+  int nDigit = 0;
+  const char * c = t + 1;
+  for ( ; *c != '\0'; ++c) {
+    if ( *c >= '0' && *c <= '9' )
+      nDigit++;
+    else if ( *c == '.' && nDot == 0 )
+      nDot++;
+    else
+      break;
+  }
+  if ( *c == '\0' && nDigit > 0 )
+    return TOKEN_NEGATIVE_NUMBER;
+
+  return (t[2] == '\0') ? TOKEN_SHORT_SWITCH : TOKEN_COMBINED_SWITCH;
+}
+
+/* Classify all tokens in one pass */
+ARGPARSE_INLINE
+void classify_tokens(const int argc, char ** argv, unsigned char * kinds) {
+  for (int i = 0; i < argc; ++i)
+    kinds[i] = static_cast<unsigned char>(classify_token(argv[i]));
+}
 
 /* lineFormat():
       Format a long string with multiple words into a line-broken string, 
@@ -123,7 +192,7 @@ bool is_string_numeric(const std::string str) {
        inStr: input string, unformatted
        w:     string width 
        lw:    left white-space width */
-std::string lineFormat(const std::string inStr, 
+ARGPARSE_INLINE std::string lineFormat(const std::string inStr, 
 		       const int w, 
 		       const int lw) {
   std::istringstream iss(inStr);
@@ -131,7 +200,7 @@ std::string lineFormat(const std::string inStr,
   /* Sanity check */
   if ( w <= 0 || lw < 0 || lw >= w ) {
     std::cerr << "ERROR occurred during lineFormat()" << std::endl;
-    return string("");
+    return std::string("");
   }
 
   std::string remStr; /* Remnant string from the previous line */
@@ -178,9 +247,6 @@ std::string lineFormat(const std::string inStr,
 	oss << word.substr(0, w - lc) << "\n";
 	word = word.substr(w - lc, word.size() - w + lc);
 
-	/* DEBUG */
-	cout << "word after break up = " << word << endl;
-	
 	state = 0;
 	lc = 0;	
       }
@@ -192,3 +258,877 @@ std::string lineFormat(const std::string inStr,
   return oss.str();
 }
 
+
+
+/* Binary packing utility functions */
+ARGPARSE_INLINE void pack_uint32(std::string & buf, const unsigned int u) {
+  for (int i = 0; i < 4; ++i)
+    buf += static_cast<char>((u >> (8 * i)) & 0xff);
+}
+
+ARGPARSE_INLINE void pack_float(std::string & buf, const float f) {
+  unsigned int u;
+  memcpy(&u, &f, sizeof(u));
+  pack_uint32(buf, u);
+}
+
+ARGPARSE_INLINE void pack_string(std::string & buf, const std::string & s) {
+  pack_uint32(buf, s.size());
+  buf += s;
+}
+
+ARGPARSE_INLINE
+unsigned int unpack_uint32(const char * buf, const size_t n, size_t & pos) {
+  if ( pos + 4 > n )
+    throw unpackErr();
+
+  unsigned int u = 0;
+  for (int i = 0; i < 4; ++i)
+    u |= static_cast<unsigned int>(static_cast<unsigned char>(buf[pos + i])) 
+      << (8 * i);
+  pos += 4;
+
+  return u;
+}
+
+ARGPARSE_INLINE
+float unpack_float(const char * buf, const size_t n, size_t & pos) {
+  unsigned int u = unpack_uint32(buf, n, pos);
+  float f;
+  memcpy(&f, &u, sizeof(f));
+
+  return f;
+}
+
+ARGPARSE_INLINE
+std::string unpack_string(const char * buf, const size_t n, size_t & pos) {
+  size_t len = unpack_uint32(buf, n, pos);
+  if ( len > n - pos )
+    throw unpackErr();
+
+  std::string s(buf + pos, len);
+  pos += len;
+
+  return s;
+}
+
+/* 32-bit FNV-1a hash of a byte string */
+ARGPARSE_INLINE unsigned int fnv1a_hash(const char * buf, const size_t n, 
+				       unsigned int h) {
+  for (size_t i = 0; i < n; ++i) {
+    h ^= static_cast<unsigned char>(buf[i]);
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+/* OutputSink: formatted text output into a string or a file descriptor */
+ARGPARSE_INLINE OutputSink :: OutputSink(std::string & t_str) :
+  str(&t_str), fd(-1), len(0), bFailed(false) {
+}
+
+ARGPARSE_INLINE OutputSink :: OutputSink(const int t_fd) :
+  str(0), fd(t_fd), len(0), bFailed(false) {
+}
+
+ARGPARSE_INLINE OutputSink :: ~OutputSink() {
+  flush();
+}
+
+ARGPARSE_INLINE bool OutputSink :: flush() {
+  if ( str != 0 ) {
+    str->append(buf, len);
+    len = 0;
+    return true;
+  }
+
+  size_t off = 0;
+  while ( off < len && !bFailed ) {
+    const ssize_t nw = write(fd, buf + off, len - off);
+    if ( nw < 0 && errno == EINTR )
+      continue;
+    if ( nw <= 0 )
+      bFailed = true;
+    else
+      off += nw;
+  }
+  len = 0;
+
+  return !bFailed;
+}
+
+ARGPARSE_INLINE void OutputSink :: put(const char * s, const size_t n) {
+  if ( len + n > sizeof(buf) ) {
+    flush();
+    /* Long pieces bypass the buffer */
+    if ( n > sizeof(buf) ) {
+      if ( str != 0 ) {
+	str->append(s, n);
+      }
+      else {
+	memcpy(buf, s, sizeof(buf));
+	len = sizeof(buf);
+	flush();
+	put(s + sizeof(buf), n - sizeof(buf));
+      }
+      return;
+    }
+  }
+
+  memcpy(buf + len, s, n);
+  len += n;
+}
+
+ARGPARSE_INLINE void OutputSink :: put(const char * s) {
+  put(s, strlen(s));
+}
+
+ARGPARSE_INLINE void OutputSink :: putInt(const long long i) {
+  char tmp[24];
+  char * p = tmp + sizeof(tmp);
+
+  /* Digits of the magnitude, from the last one (LLONG_MIN included) */
+  unsigned long long u = (i < 0) ? 0ULL - static_cast<unsigned long long>(i)
+    : static_cast<unsigned long long>(i);
+  do {
+    *--p = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while ( u != 0 );
+  if ( i < 0 )
+    *--p = '-';
+
+  put(p, tmp + sizeof(tmp) - p);
+}
+
+/* Shortest decimal digits of a positive, finite float af: af reads back
+   from D * 10^q. The candidates, by increasing number of digits, are the
+   nearest decimals D * 10^q to af, computed in double precision, in which
+   af, its neighbours and 10^|q| (|q| <= 22) are exact. A candidate reads
+   back as af if it is strictly between the midpoints to the neighbours of
+   af; its single rounding to double preserves that order, so that the test
+   is exact, except when the candidate rounds to a midpoint. Returns false
+   in that case and out of range (e.g., subnormals), for the slow path. */
+ARGPARSE_STATIC bool shortest_digits(const float af,
+				     unsigned long long & D, int & q) {
+  static const double p10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  unsigned int u;
+  memcpy(&u, &af, sizeof(u));
+  const int be = (u >> 23) & 0xff; /* Biased exponent */
+  if ( be == 0 || be >= 0xfe )
+    return false;
+
+  float fLo, fHi;
+  const unsigned int uLo = u - 1;
+  const unsigned int uHi = u + 1;
+  memcpy(&fLo, &uLo, sizeof(fLo));
+  memcpy(&fHi, &uHi, sizeof(fHi));
+  const double d = af;
+  const double lo = (d + fLo) / 2.0;
+  const double hi = (d + fHi) / 2.0;
+
+  /* af < 2^(be - 126): k is the number of integral digits of af, or one
+     more */
+  const int k = static_cast<int>(floor((be - 126) * 0.30102999566398120)) + 1;
+
+  for (int p = 1; p <= 10; ++p) {
+    q = k - p;
+    if ( q > 22 || q < -22 )
+      return false;
+
+    /* Rounded half to even, as by printf() */
+    const double sd = (q >= 0) ? d / p10[q] : d * p10[-q];
+    const double fl = floor(sd);
+    D = static_cast<unsigned long long>(fl);
+    if ( sd - fl > 0.5 || (sd - fl == 0.5 && (D & 1) != 0) )
+      D++;
+    if ( D == 0 )
+      continue;
+
+    const double c = (q >= 0) ? D * p10[q] : D / p10[-q];
+    if ( c > lo && c < hi )
+      return true;
+    if ( c == lo || c == hi )
+      return false;
+  }
+
+  return false;
+}
+
+/* Format D * 10^q as printf() does with "%.<n>g", n being the number of
+   digits of D. Returns the length. */
+ARGPARSE_STATIC size_t format_decimal(char * buf, const bool bNeg,
+				      unsigned long long D, int q) {
+  while ( D % 10 == 0 ) {
+    D /= 10;
+    q++;
+  }
+
+  char digits[24];
+  int nd = 0;
+  for (unsigned long long t = D; t != 0; t /= 10)
+    digits[sizeof(digits) - 1 - nd++] = static_cast<char>('0' + t % 10);
+  const char * ds = digits + sizeof(digits) - nd;
+
+  const int x = q + nd - 1; /* Exponent of the leading digit */
+  char * p = buf;
+  if ( bNeg )
+    *p++ = '-';
+
+  if ( x < -4 || x >= nd ) {
+    *p++ = ds[0];
+    if ( nd > 1 ) {
+      *p++ = '.';
+      memcpy(p, ds + 1, nd - 1);
+      p += nd - 1;
+    }
+    *p++ = 'e';
+    *p++ = (x < 0) ? '-' : '+';
+    const int ax = (x < 0) ? -x : x;
+    if ( ax >= 100 )
+      *p++ = static_cast<char>('0' + ax / 100);
+    *p++ = static_cast<char>('0' + ax / 10 % 10);
+    *p++ = static_cast<char>('0' + ax % 10);
+  }
+  else if ( x >= 0 ) {
+    memcpy(p, ds, x + 1);
+    p += x + 1;
+    if ( nd > x + 1 ) {
+      *p++ = '.';
+      memcpy(p, ds + x + 1, nd - x - 1);
+      p += nd - x - 1;
+    }
+  }
+  else {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = 0; i < -x - 1; ++i)
+      *p++ = '0';
+    memcpy(p, ds, nd);
+    p += nd;
+  }
+
+  return p - buf;
+}
+
+ARGPARSE_INLINE void OutputSink :: putFloat(const float f) {
+  if ( f != f ) {
+    put("nan", 3);
+    return;
+  }
+  if ( f - f != 0.0f ) {
+    if ( f > 0.0f )
+      put("inf", 3);
+    else
+      put("-inf", 4);
+    return;
+  }
+
+  /* Integral values in the exact range of float (but not -0) */
+  if ( f >= -16777216.0f && f <= 16777216.0f &&
+       f == static_cast<float>(static_cast<int>(f)) &&
+       (f != 0.0f || 1.0f / f > 0.0f) ) {
+    putInt(static_cast<int>(f));
+    return;
+  }
+
+  char tmp[32];
+  unsigned long long D;
+  int q;
+  if ( f != 0.0f && shortest_digits((f < 0.0f) ? -f : f, D, q) ) {
+    put(tmp, format_decimal(tmp, f < 0.0f, D, q));
+    return;
+  }
+
+  /* Slow path: fewest significant digits (up to 9, which always suffice)
+     that read back as f. A precision that reads back stays good for more
+     digits, so it is found by bisection. */
+  char best[32];
+  int bestLen = snprintf(best, sizeof(best), "%.9g", f);
+  int lo = 1;
+  int hi = 9;
+  while ( lo < hi ) {
+    const int mid = (lo + hi) / 2;
+    const int n = snprintf(tmp, sizeof(tmp), "%.*g", mid, f);
+    if ( strtof(tmp, 0) == f ) {
+      memcpy(best, tmp, n + 1);
+      bestLen = n;
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+
+  put(best, bestLen);
+}
+
+ARGPARSE_INLINE void OutputSink :: putJsonString(const char * s,
+						 const size_t n) {
+  static const char hex[] = "0123456789abcdef";
+
+  put('"');
+  size_t b = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+    if ( c >= 0x20 && c != '"' && c != '\\' )
+      continue;
+
+    /* Runs of plain characters are copied at once */
+    put(s + b, i - b);
+    b = i + 1;
+
+    put('\\');
+    if ( c == '"' || c == '\\' )
+      put(static_cast<char>(c));
+    else if ( c == '\n' )
+      put('n');
+    else if ( c == '\t' )
+      put('t');
+    else if ( c == '\r' )
+      put('r');
+    else {
+      put("u00", 3);
+      put(hex[c >> 4]);
+      put(hex[c & 0xf]);
+    }
+  }
+  put(s + b, n - b);
+  put('"');
+}
+
+ARGPARSE_INLINE void OutputSink :: putEscaped(const char * s, const size_t n) {
+  static const char hex[] = "0123456789abcdef";
+
+  size_t b = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+    if ( c > 0x20 && c != '\\' && c != 0x7f )
+      continue;
+
+    put(s + b, i - b);
+    b = i + 1;
+
+    put('\\');
+    if ( c == ' ' || c == '\\' )
+      put(static_cast<char>(c));
+    else if ( c == '\n' )
+      put('n');
+    else if ( c == '\t' )
+      put('t');
+    else if ( c == '\r' )
+      put('r');
+    else {
+      put('x');
+      put(hex[c >> 4]);
+      put(hex[c & 0xf]);
+    }
+  }
+  put(s + b, n - b);
+}
+
+/* StringTable: flat open-addressing hash table of strings */
+ARGPARSE_INLINE StringTable :: StringTable() {
+}
+
+/* Slot holding the key, or the empty slot where it would go. 
+   slots must not be empty. */
+ARGPARSE_INLINE
+unsigned int StringTable :: probe(const char * k, const size_t kl, 
+				  const unsigned int h) const {
+  const unsigned int mask = slots.size() - 1;
+  unsigned int s = h & mask;
+
+  while ( slots[s] != 0 ) {
+    const entry_t & e = entries[slots[s] - 1];
+    if ( e.hash == h && e.kLen == kl && 
+	 arena.compare(e.kOff, kl, k, kl) == 0 )
+      break;
+    s = (s + 1) & mask;
+  }
+
+  return s;
+}
+
+/* Rebuild the slot array with nSlots (a power of 2) slots */
+ARGPARSE_INLINE void StringTable :: rehash(const size_t nSlots) {
+  slots.assign(nSlots, 0);
+
+  const unsigned int mask = nSlots - 1;
+  for (unsigned int i = 0; i < entries.size(); ++i) {
+    unsigned int s = entries[i].hash & mask;
+    while ( slots[s] != 0 )
+      s = (s + 1) & mask;
+    slots[s] = i + 1;
+  }
+}
+
+ARGPARSE_INLINE bool StringTable :: insert(const char * k, const size_t kl, 
+			   const char * v, const size_t vl, 
+			   const bool bReplace) {
+  if ( 2 * (entries.size() + 1) > slots.size() )
+    rehash(slots.empty() ? 16 : 2 * slots.size());
+
+  const unsigned int h = fnv1a_hash(k, kl);
+  const unsigned int s = probe(k, kl, h);
+
+  if ( slots[s] != 0 ) {
+    /* Existing key */
+    if ( bReplace ) {
+      entry_t & e = entries[slots[s] - 1];
+      e.vOff = arena.size();
+      e.vLen = vl;
+      arena.append(v, vl);
+    }
+    return false;
+  }
+
+  entry_t e;
+  e.hash = h;
+  e.kOff = arena.size();
+  e.kLen = kl;
+  arena.append(k, kl);
+  e.vOff = arena.size();
+  e.vLen = vl;
+  arena.append(v, vl);
+
+  entries.push_back(e);
+  slots[s] = entries.size();
+
+  return true;
+}
+
+ARGPARSE_INLINE
+bool StringTable :: insert(const std::string & k, const std::string & v, 
+			   const bool bReplace) {
+  return insert(k.data(), k.size(), v.data(), v.size(), bReplace);
+}
+
+ARGPARSE_INLINE bool StringTable :: find(const char * k, const size_t kl, 
+			 const char * & v, size_t & vl) const {
+  if ( slots.empty() )
+    return false;
+
+  const unsigned int s = probe(k, kl, fnv1a_hash(k, kl));
+  if ( slots[s] == 0 )
+    return false;
+
+  const entry_t & e = entries[slots[s] - 1];
+  v = arena.data() + e.vOff;
+  vl = e.vLen;
+
+  return true;
+}
+
+ARGPARSE_INLINE
+bool StringTable :: contains(const char * k, const size_t kl) const {
+  const char * v;
+  size_t vl;
+
+  return find(k, kl, v, vl);
+}
+
+ARGPARSE_INLINE bool StringTable :: contains(const std::string & k) const {
+  return contains(k.data(), k.size());
+}
+
+ARGPARSE_INLINE std::string StringTable :: key(const size_t i) const {
+  return arena.substr(entries[i].kOff, entries[i].kLen);
+}
+
+ARGPARSE_INLINE std::string StringTable :: value(const size_t i) const {
+  return arena.substr(entries[i].vOff, entries[i].vLen);
+}
+
+ARGPARSE_INLINE
+void StringTable :: entry(const size_t i, const char * & k, size_t & kl,
+			  const char * & v, size_t & vl) const {
+  k = arena.data() + entries[i].kOff;
+  kl = entries[i].kLen;
+  v = arena.data() + entries[i].vOff;
+  vl = entries[i].vLen;
+}
+
+ARGPARSE_INLINE
+void StringTable :: reserve(const size_t nEntries, const size_t nChars) {
+  entries.reserve(nEntries);
+  arena.reserve(nChars);
+
+  size_t nSlots = slots.empty() ? 16 : slots.size();
+  while ( nSlots < 2 * nEntries )
+    nSlots *= 2;
+  if ( nSlots > slots.size() )
+    rehash(nSlots);
+}
+
+ARGPARSE_INLINE void StringTable :: clear() {
+  arena.clear();
+  entries.clear();
+  slots.clear();
+}
+
+ARGPARSE_INLINE size_t StringTable :: memUsage() const {
+  return string_heap_bytes(arena) 
+    + entries.capacity() * sizeof(entry_t) 
+    + slots.capacity() * sizeof(unsigned int);
+}
+
+/* Match masks of a pattern of up to 64 characters for edit_distance_bits():
+   bit i of peq[c] is set if p[i] == c */
+ARGPARSE_STATIC void edit_distance_masks(const char * p, const size_t m, 
+					 unsigned long long * peq) {
+  memset(peq, 0, 256 * sizeof(unsigned long long));
+  for (size_t i = 0; i < m; ++i)
+    peq[static_cast<unsigned char>(p[i])] |= 1ULL << i;
+}
+
+/* Levenshtein distance between a pattern of m (1 to 64) characters, given 
+   by its match masks, and t, with the bit-parallel algorithm of Myers in 
+   the formulation of Hyyro: the column of the DP matrix is held as bit 
+   vectors of vertical +1/-1 differences, and advanced over a character of
+   t with a few word operations. */
+ARGPARSE_STATIC unsigned int edit_distance_bits(const unsigned long long * peq,
+						const size_t m, 
+						const char * t, 
+						const size_t n) {
+  const unsigned long long hiBit = 1ULL << (m - 1);
+  unsigned long long vp = (m == 64) ? ~0ULL : (1ULL << m) - 1;
+  unsigned long long vn = 0;
+  unsigned int d = m;
+
+  for (size_t j = 0; j < n; ++j) {
+    const unsigned long long eq = peq[static_cast<unsigned char>(t[j])];
+    const unsigned long long xv = eq | vn;
+    const unsigned long long xh = (((eq & vp) + vp) ^ vp) | eq;
+    unsigned long long hp = vn | ~(xh | vp);
+    unsigned long long hn = vp & xh;
+    if ( hp & hiBit )
+      d++;
+    else if ( hn & hiBit )
+      d--;
+    /* The top row of the matrix grows by one per character of t */
+    hp = (hp << 1) | 1;
+    hn <<= 1;
+    vp = hn | ~(xv | hp);
+    vn = hp & xv;
+  }
+
+  return d;
+}
+
+/* Levenshtein distance: bit-parallel for strings of up to 64 characters, 
+   otherwise by dynamic programming over a single row */
+ARGPARSE_INLINE unsigned int edit_distance(const char * a, const size_t al, 
+					   const char * b, const size_t bl, 
+					   std::vector<unsigned int> & row) {
+  if ( al == 0 || bl == 0 )
+    return al + bl;
+
+  if ( al <= 64 ) {
+    unsigned long long peq[256];
+    edit_distance_masks(a, al, peq);
+    return edit_distance_bits(peq, al, b, bl);
+  }
+
+  row.resize(bl + 1);
+  for (size_t j = 0; j <= bl; ++j)
+    row[j] = j;
+
+  for (size_t i = 1; i <= al; ++i) {
+    unsigned int diag = row[0]; /* row[j - 1] of the previous row */
+    row[0] = i;
+    for (size_t j = 1; j <= bl; ++j) {
+      const unsigned int up = row[j];
+      unsigned int d = diag + ((a[i - 1] == b[j - 1]) ? 0 : 1);
+      if ( up + 1 < d )
+	d = up + 1;
+      if ( row[j - 1] + 1 < d )
+	d = row[j - 1] + 1;
+      row[j] = d;
+      diag = up;
+    }
+  }
+
+  return row[bl];
+}
+
+ARGPARSE_INLINE
+unsigned int edit_distance(const std::string & a, const std::string & b) {
+  std::vector<unsigned int> row;
+  return edit_distance(a.data(), a.size(), b.data(), b.size(), row);
+}
+
+/* BKTree: Burkhard-Keller tree of strings */
+ARGPARSE_STATIC unsigned int popcount_word(unsigned long w);
+
+/* Set of the characters of a string, folded into the bits of a word */
+ARGPARSE_STATIC unsigned long char_set(const char * s, const size_t n) {
+  unsigned long cs = 0;
+  for (size_t i = 0; i < n; ++i)
+    cs |= 1UL << (static_cast<unsigned char>(s[i]) % (8 * sizeof(cs)));
+  return cs;
+}
+
+ARGPARSE_INLINE void BKTree :: build(const std::vector<std::string> & strs) {
+  clear();
+  if ( strs.empty() )
+    return;
+
+  /* Insert the strings into a tree with linked lists of children */
+  struct tnode_t {
+    unsigned int dist;
+    int firstChild, nextSibling;
+  };
+  std::vector<tnode_t> tn(strs.size());
+  std::vector<unsigned int> row;
+  tn[0].dist = 0;
+  tn[0].firstChild = tn[0].nextSibling = -1;
+  std::vector<bool> bDup(strs.size(), false);
+
+  for (unsigned int i = 1; i < strs.size(); ++i) {
+    tn[i].firstChild = tn[i].nextSibling = -1;
+    unsigned int k = 0;
+    while ( true ) {
+      const unsigned int d = edit_distance(strs[i].data(), strs[i].size(), 
+					   strs[k].data(), strs[k].size(), row);
+      if ( d == 0 ) {
+	bDup[i] = true;
+	break;
+      }
+
+      /* Descend into the child at distance d, or add the string there */
+      int c = tn[k].firstChild;
+      while ( c != -1 && tn[c].dist != d )
+	c = tn[c].nextSibling;
+      if ( c == -1 ) {
+	tn[i].dist = d;
+	tn[i].nextSibling = tn[k].firstChild;
+	tn[k].firstChild = i;
+	break;
+      }
+      k = c;
+    }
+  }
+
+  /* Lay the nodes out breadth first, the children of each node by 
+     increasing distance */
+  std::vector<unsigned int> order(1, 0); /* Strings in layout order */
+  std::vector<std::pair<unsigned int, unsigned int> > kids;
+  nodes.reserve(strs.size());
+  for (unsigned int p = 0; p < order.size(); ++p) {
+    const unsigned int i = order[p];
+    node_t nd;
+    nd.off = arena.size();
+    nd.len = strs[i].size();
+    nd.dist = tn[i].dist;
+    nd.id = i;
+    nd.charSet = char_set(strs[i].data(), strs[i].size());
+    arena += strs[i];
+
+    kids.clear();
+    for (int c = tn[i].firstChild; c != -1; c = tn[c].nextSibling)
+      kids.push_back(std::make_pair(tn[c].dist, c));
+    std::sort(kids.begin(), kids.end());
+
+    nd.cBegin = order.size();
+    for (unsigned int k = 0; k < kids.size(); ++k)
+      order.push_back(kids[k].second);
+    nd.cEnd = order.size();
+    nodes.push_back(nd);
+  }
+}
+
+ARGPARSE_INLINE 
+void BKTree :: search(const char * s, const size_t n, 
+		      const unsigned int maxDist, 
+		      std::vector<std::pair<unsigned int, unsigned int> > & hits)
+  const {
+  if ( nodes.empty() )
+    return;
+
+  /* The match masks of the query are set up once for all nodes */
+  const bool bBits = (n > 0 && n <= 64);
+  unsigned long long peq[256];
+  if ( bBits )
+    edit_distance_masks(s, n, peq);
+  const unsigned long cs = char_set(s, n);
+
+  std::vector<unsigned int> row;
+  std::vector<unsigned int> stack(1, 0);
+  while ( !stack.empty() ) {
+    const node_t & nd = nodes[stack.back()];
+    stack.pop_back();
+
+    /* Lower bound of the distance: the length difference, and the number 
+       of characters (folded) of either string missing from the other, each
+       needing an edit of its own */
+    const unsigned int lenDiff = (n > nd.len) ? n - nd.len : nd.len - n;
+    const unsigned int nMiss1 = popcount_word(cs & ~nd.charSet);
+    const unsigned int nMiss2 = popcount_word(nd.charSet & ~cs);
+    unsigned int lb = (nMiss1 > nMiss2) ? nMiss1 : nMiss2;
+    if ( lenDiff > lb )
+      lb = lenDiff;
+
+    const unsigned int reach = maxDist + 
+      ((nd.cEnd > nd.cBegin) ? nodes[nd.cEnd - 1].dist : 0);
+    if ( lb > reach )
+      continue;
+
+    const unsigned int d = (bBits && nd.len > 0) ? 
+      edit_distance_bits(peq, n, arena.data() + nd.off, nd.len) : 
+      edit_distance(s, n, arena.data() + nd.off, nd.len, row);
+    if ( d <= maxDist )
+      hits.push_back(std::make_pair(d, nd.id));
+
+    const unsigned int lo = (d > maxDist) ? d - maxDist : 0;
+    for (unsigned int c = nd.cBegin; c < nd.cEnd; ++c) {
+      if ( nodes[c].dist > d + maxDist )
+	break;
+      if ( nodes[c].dist >= lo )
+	stack.push_back(c);
+    }
+  }
+}
+
+ARGPARSE_INLINE void BKTree :: clear() {
+  arena.clear();
+  nodes.clear();
+}
+
+ARGPARSE_INLINE size_t BKTree :: memUsage() const {
+  return string_heap_bytes(arena) + nodes.capacity() * sizeof(node_t);
+}
+
+/* Heap memory used by a string */
+ARGPARSE_INLINE size_t string_heap_bytes(const std::string & s) {
+  const char * d = s.data();
+  const char * o = reinterpret_cast<const char *>(&s);
+  if ( d >= o && d < o + sizeof(s) )
+    return 0; /* Short-string buffer */
+
+  return s.capacity() + 1;
+}
+
+/* Bit sets over small integer indices */
+static const unsigned int bitsPerWord = 8 * sizeof(unsigned long);
+
+ARGPARSE_STATIC unsigned int popcount_word(unsigned long w) {
+#ifdef __GNUC__
+  return __builtin_popcountl(w);
+#else
+  unsigned int c = 0;
+  for ( ; w != 0; w &= w - 1)
+    c++;
+  return c;
+#endif
+}
+
+ARGPARSE_INLINE void bits_set(bitWords_t & b, const unsigned int i) {
+  if ( i / bitsPerWord >= b.size() )
+    b.resize(i / bitsPerWord + 1, 0);
+  b[i / bitsPerWord] |= 1UL << (i % bitsPerWord);
+}
+
+ARGPARSE_INLINE bool bits_test(const bitWords_t & b, const unsigned int i) {
+  if ( i / bitsPerWord >= b.size() )
+    return false;
+  return (b[i / bitsPerWord] >> (i % bitsPerWord)) & 1UL;
+}
+
+ARGPARSE_INLINE unsigned int bits_count(const bitWords_t & b) {
+  unsigned int c = 0;
+  for (size_t k = 0; k < b.size(); ++k)
+    c += popcount_word(b[k]);
+  return c;
+}
+
+ARGPARSE_INLINE
+unsigned int bits_count_and(const bitWords_t & a, const bitWords_t & b) {
+  const size_t nw = (a.size() < b.size()) ? a.size() : b.size();
+  unsigned int c = 0;
+  for (size_t k = 0; k < nw; ++k)
+    c += popcount_word(a[k] & b[k]);
+  return c;
+}
+
+/* Parallel loop */
+struct parallelLoop_t {
+  size_t n;
+  size_t chunk;
+  parallelTask_t fn;
+  void * ctx;
+  std::atomic<size_t> next; /* First index of the next chunk */
+};
+
+ARGPARSE_STATIC void parallel_worker(parallelLoop_t * lp) {
+  while ( true ) {
+    const size_t i0 = lp->next.fetch_add(lp->chunk, std::memory_order_relaxed);
+    if ( i0 >= lp->n )
+      break;
+
+    const size_t i1 = (lp->n - i0 > lp->chunk) ? i0 + lp->chunk : lp->n;
+    for (size_t i = i0; i < i1; ++i)
+      lp->fn(i, lp->ctx);
+  }
+}
+
+ARGPARSE_INLINE void parallel_for(const size_t n, parallelTask_t fn, 
+				  void * ctx, const unsigned int nThreads, 
+				  const size_t chunk) {
+  parallelLoop_t lp;
+  lp.n = n;
+  lp.chunk = (chunk > 0) ? chunk : 1;
+  lp.fn = fn;
+  lp.ctx = ctx;
+  lp.next.store(0, std::memory_order_relaxed);
+
+  /* No more threads than chunks */
+  size_t nt = (nThreads > 0) ? nThreads : std::thread::hardware_concurrency();
+  const size_t nChunks = (n + lp.chunk - 1) / lp.chunk;
+  if ( nt > nChunks )
+    nt = nChunks;
+
+  std::vector<std::thread> threads;
+  for (size_t k = 1; k < nt; ++k) {
+    try {
+      threads.push_back(std::thread(parallel_worker, &lp));
+    }
+    catch (...) {
+      break; /* Fewer threads */
+    }
+  }
+
+  parallel_worker(&lp);
+  for (size_t k = 0; k < threads.size(); ++k)
+    threads[k].join();
+}
+
+/* File utility functions */
+/* Map a whole file read-only into memory */
+ARGPARSE_INLINE
+const char * map_file(const std::string & fileName, size_t & n) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if ( fd < 0 )
+    return 0;
+
+  struct stat st;
+  if ( fstat(fd, &st) != 0 || st.st_size == 0 ) {
+    close(fd);
+    return 0;
+  }
+
+  void * p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if ( p == MAP_FAILED )
+    return 0;
+
+  n = st.st_size;
+  return static_cast<const char *>(p);
+}
+
+ARGPARSE_INLINE void unmap_file(const char * p, const size_t n) {
+  munmap(const_cast<char *>(p), n);
+}
@@ -3,27 +3,96 @@
 
 #include <string>
 #include <vector>
-#include <iostream>
-#include <sstream>
 #include <cstdlib>
 
+/* Header-only mode: defining ARGPARSE_HEADER_ONLY before including argparse.h
+   compiles the whole library into the including translation unit, so that
+   the compiler can inline value accessors into the calling code. The 
+   library functions are then defined inline (ARGPARSE_INLINE) and the 
+   file-local helpers get inline instead of internal linkage 
+   (ARGPARSE_STATIC). */
+#ifdef ARGPARSE_HEADER_ONLY
+#define ARGPARSE_INLINE inline
+#define ARGPARSE_STATIC inline
+#else
+#define ARGPARSE_INLINE
+#define ARGPARSE_STATIC static
+#endif
+
 /* String utility functions */
-/* Find all instances of a sub-string in a string */
-std::vector<size_t> string_find(std::string s, std::string subs);
+/* Split string by any delimiter string. 
+   Copies the tokens; the library itself splits with StringSplitter. */
+std::vector<std::string> split_string(const std::string & s, 
+				      const std::string & subs);
+
+/* StringSplitter: 
+      Single-pass splitting of a character range by a delimiter string, 
+   without copying or allocating. The tokens are returned as pointers into 
+   the range (which must outlive the splitter) and lengths. The delimiter 
+   is searched for with memchr(), which scans long inputs a word or a 
+   vector register at a time. As for split_string(), n delimiters give 
+   n + 1 (possibly empty) tokens, and an empty delimiter gives the whole 
+   range as a single token.
+
+   e.g., 
+     StringSplitter sp(as, ',');
+     const char * t;
+     size_t tl;
+     while ( sp.next(t, tl) )
+       ...
+*/
+class StringSplitter {
+ private:
+  const char * p;   /* Start of the next token */
+  const char * end; /* End of the range */
+  const char * delim;
+  size_t dl;        /* Delimiter length */
+  char dc;          /* Storage of single-character delimiters */
+  bool bDone;
+
+ public:
+  StringSplitter(const char * s, const size_t n, 
+		 const char * t_delim, const size_t t_dl);
+  StringSplitter(const std::string & s, const char t_dc);
 
-/* Split string by any delimiter string */
-std::vector<std::string> split_string(std::string s, std::string subs);
+  /* Get the next token. Return value: false after the last token. */
+  bool next(const char * & tok, size_t & tl);
+};
+
+/* Get the next white-space separated word in [p, end), advancing p past 
+   it. Return value: false if there are no more words. */
+bool next_word(const char * & p, const char * end, 
+	       const char * & w, size_t & wl);
 
 /* Interpreting boolean strings. 
  Return values: -1: uninterpretable string
                  0: false
 		 1: true */
-int interpret_bool_string(const std::string inStr);
+int interpret_bool_string(const std::string & inStr);
 
 /* Test if a string is a number, 
    e.g. -1, 0.0, 3, 3.14, .025.
    Limitatin cannot hanle scientific notations such as 1e2. */
-bool is_string_numeric(const std::string str);
+bool is_string_numeric(const std::string & str);
+
+/* Kinds of command-line tokens */
+typedef enum {
+  TOKEN_VALUE,           /* Plain value, e.g., 485, -, or empty */
+  TOKEN_SHORT_SWITCH,    /* Single-dash switch with one letter, e.g., -v */
+  TOKEN_COMBINED_SWITCH, /* Single-dash switch with more letters, e.g., -cd 
+			    (combined single-letter switches or a single-dash
+			    multi-letter switch) */
+  TOKEN_LONG_SWITCH,     /* Double-dash switch, e.g., --verbose */
+  TOKEN_NEGATIVE_NUMBER, /* e.g., -8, -0.5 */
+  TOKEN_TERMINATOR,      /* -- */
+} tokenKind_t;
+
+/* Classify a token. Only the leading characters are examined, except for 
+   tokens that may be negative numbers. */
+tokenKind_t classify_token(const char * t);
+
+/* Classify all argc tokens of argv in one pass, into kinds[0..argc-1] */
+void classify_tokens(const int argc, char ** argv, unsigned char * kinds);
 
 /* Test if a number (int or float or other types) satisfies a certain
    condition specified in a string.
@@ -39,10 +108,12 @@ bool is_string_numeric(const std::string str);
 */
 class checkNumberErr {};
 
+/* Print an error message of check_number() to stderr. Defined out of line 
+   so that this header does not need <iostream>. */
+void report_check_number_err(const std::string & msg);
+
 template<class NT> 
 bool check_number(NT n, std::string conds) {
-  const bool bDebug=false;
-
   if ( conds.empty() )
     return true;
 
@@ -74,7 +145,7 @@ bool check_number(NT n, std::string conds) {
     }
 
     if ( bi == -1 ) {
-      std::cerr << "Illegal predicate string: " << conds << std::endl;
+      report_check_number_err("Illegal predicate string: " + conds);
       throw checkNumberErr();
     }
 
@@ -90,13 +161,9 @@ bool check_number(NT n, std::string conds) {
 
     std::string ps = (ci == -1) ? cs : cs.substr(0, bi + ci);
     std::string ns = ps.substr(bi, ps.size() - bi);
-        
-    if (bDebug)
-      std::cout << "Predicate: " << ps 
-		<< "; number = " << ns << std::endl;
 
     if ( !is_string_numeric(ns) ) {
-      std::cerr << "ERROR: Unrecognized number string: " << ns << std::endl;
+      report_check_number_err("ERROR: Unrecognized number string: " + ns);
       throw checkNumberErr();
     }
 
@@ -125,7 +192,213 @@ bool check_number(NT n, std::string conds) {
 
   return bPass;
 }
-#endif
+
+/* Binary packing utility functions. 
+   Integers are written as fixed-width 32-bit little-endian words, floats as 
+   their IEEE-754 bit patterns, and strings as a length word followed by the 
+   characters. The unpack functions read from buf (of size n) at position 
+   pos, advance pos and throw unpackErr on truncated input. */
+class unpackErr {};
+
+void pack_uint32(std::string & buf, const unsigned int u);
+void pack_float(std::string & buf, const float f);
+void pack_string(std::string & buf, const std::string & s);
+
+unsigned int unpack_uint32(const char * buf, const size_t n, size_t & pos);
+float unpack_float(const char * buf, const size_t n, size_t & pos);
+std::string unpack_string(const char * buf, const size_t n, size_t & pos);
+
+/* 32-bit FNV-1a hash of a byte string. Byte strings can be hashed in 
+   pieces by passing the hash of the preceding pieces as h. */
+unsigned int fnv1a_hash(const char * buf, const size_t n, 
+			const unsigned int h=2166136261u);
+
+/* OutputSink:
+      Formatted text output without intermediate strings. Text is appended
+   to a caller's string, or collected in a fixed buffer which is written to
+   a file descriptor whenever it fills up (and by flush(), which the
+   destructor calls). Numbers are formatted in place: integers by hand,
+   floats as the shortest decimal string that reads back as the same float
+   (e.g., 0.1f as "0.1"). Write errors are sticky: see failed(). */
+class OutputSink {
+  std::string * str; /* Destination string; 0: file descriptor */
+  int fd;
+  char buf[4096];
+  size_t len;        /* Bytes in buf */
+  bool bFailed;
+
+  OutputSink(const OutputSink &);
+  OutputSink & operator=(const OutputSink &);
+
+ public:
+  explicit OutputSink(std::string & t_str);
+  explicit OutputSink(const int t_fd);
+  ~OutputSink();
+
+  void put(const char * s, const size_t n);
+  void put(const char c) {
+    if ( len == sizeof(buf) ) flush();
+    buf[len++] = c;
+  }
+  void put(const char * s);
+  void putInt(const long long i);
+  /* Non-finite floats are written as "nan", "inf" and "-inf" */
+  void putFloat(const float f);
+  /* A JSON string literal, quoted and escaped */
+  void putJsonString(const char * s, const size_t n);
+  /* A string with backslash escapes of white space, control characters
+     and backslashes, for space-separated lists (e.g., "a\ b\\c\n") */
+  void putEscaped(const char * s, const size_t n);
+
+  /* Write out the buffered text; false on failure */
+  bool flush();
+  bool failed() const { return bFailed; }
+};
+
+/* StringTable: 
+      Flat open-addressing hash table of string keys and values. 
+   Keys and values are stored back to back in a single character arena and 
+   the entries refer to them by offset, so that insertion does not allocate 
+   per entry. Lookup is by linear probing; the slot array is kept at most 
+   half full. Entries are kept in insertion order. */
+class StringTable {
+ private:
+  struct entry_t {
+    unsigned int hash;
+    unsigned int kOff, kLen; /* Key offset and length in arena */
+    unsigned int vOff, vLen; /* Value offset and length in arena */
+  };
+
+  std::string arena;
+  std::vector<entry_t> entries;
+  std::vector<unsigned int> slots; /* Entry index + 1; 0: empty slot */
+
+  /* Slot holding the key, or the empty slot where it would go */
+  unsigned int probe(const char * k, const size_t kl, 
+		     const unsigned int h) const;
+  void rehash(const size_t nSlots);
+
+ public:
+  StringTable();
+
+  /* Insert a key-value pair. If the key exists, its value is replaced 
+     only if bReplace is true. Return value: true if the key is new. */
+  bool insert(const char * k, const size_t kl, 
+	      const char * v, const size_t vl, 
+	      const bool bReplace=true);
+  bool insert(const std::string & k, const std::string & v, 
+	      const bool bReplace=true);
+
+  /* Look up a key. On success, v and vl are set to the value in the 
+     arena, which remains valid until the next insertion. */
+  bool find(const char * k, const size_t kl, 
+	    const char * & v, size_t & vl) const;
+  bool contains(const char * k, const size_t kl) const;
+  bool contains(const std::string & k) const;
+
+  /* Access to the entries, in insertion order */
+  size_t size() const { return entries.size(); }
+  std::string key(const size_t i) const;
+  std::string value(const size_t i) const;
+  /* Same, without copying: pointers into the arena */
+  void entry(const size_t i, const char * & k, size_t & kl,
+	     const char * & v, size_t & vl) const;
+
+  /* Reserve room for nEntries entries and nChars characters */
+  void reserve(const size_t nEntries, const size_t nChars);
+  void clear();
+
+  /* Heap memory used (bytes) */
+  size_t memUsage() const;
+};
+
+/* Levenshtein distance between two strings (insertions, deletions and 
+   substitutions of single characters). row is a work buffer. */
+unsigned int edit_distance(const char * a, const size_t al, 
+			   const char * b, const size_t bl, 
+			   std::vector<unsigned int> & row);
+unsigned int edit_distance(const std::string & a, const std::string & b);
+
+/* BKTree: 
+      Burkhard-Keller tree of strings under edit_distance(), for finding 
+   all strings within a given distance of a query (e.g., for suggesting 
+   near misses of a mistyped name). The children of a node are keyed by 
+   their distance to it, so that by the triangle inequality a search for 
+   distance <= k from a node at distance d only descends into the children 
+   at distances d - k to d + k; with small k, a search visits a small part 
+   of the tree. Nodes that cannot be hits and have no children within 
+   reach are skipped without computing their distances, by a lower bound
+   from the lengths and the character sets of the strings. The tree is 
+   built in one go and laid out breadth first, with the children of every
+   node stored together by increasing distance and the strings in a single
+   arena in the same order. */
+class BKTree {
+ private:
+  struct node_t {
+    unsigned int off, len;     /* String in arena */
+    unsigned int dist;         /* Distance to the parent */
+    unsigned int id;           /* Index of the string in build() */
+    unsigned int cBegin, cEnd; /* Children: nodes[cBegin] to nodes[cEnd-1] */
+    unsigned long charSet;     /* Bit c % (bits per word) for characters c */
+  };
+
+  std::string arena;
+  std::vector<node_t> nodes; /* nodes[0]: root */
+
+ public:
+  /* Build the tree of strs (replacing any previous one). Duplicate 
+     strings are stored once, with the lowest index. */
+  void build(const std::vector<std::string> & strs);
+
+  /* Find the strings within maxDist of s. Appends (distance, index in 
+     build()) pairs to hits, in no particular order. */
+  void search(const char * s, const size_t n, const unsigned int maxDist,
+	      std::vector<std::pair<unsigned int, unsigned int> > & hits) 
+    const;
+
+  size_t size() const { return nodes.size(); }
+  void clear();
+
+  /* Heap memory used (bytes) */
+  size_t memUsage() const;
+};
+
+/* Heap memory used by a string (bytes): 0 for strings held in the 
+   short-string buffer inside the string object */
+size_t string_heap_bytes(const std::string & s);
+
+/* Bit sets over small integer indices (e.g., argument indices), stored as
+   vectors of machine words. The sets are grown as needed by bits_set(); 
+   missing words count as zeros. */
+typedef std::vector<unsigned long> bitWords_t;
+
+void bits_set(bitWords_t & b, const unsigned int i);
+bool bits_test(const bitWords_t & b, const unsigned int i);
+/* Number of set bits in b */
+unsigned int bits_count(const bitWords_t & b);
+/* Number of set bits in the intersection of a and b */
+unsigned int bits_count_and(const bitWords_t & a, const bitWords_t & b);
+
+/* File utility functions */
+/* Map a whole file read-only into memory. Sets n to the file size. 
+   Returns 0 on failure, including for empty files. 
+   The mapping is released with unmap_file(). */
+const char * map_file(const std::string & fileName, size_t & n);
+void unmap_file(const char * p, const size_t n);
+
+/* Parallel loop utility functions */
+/* Task of parallel_for(): the i-th call, with the ctx pointer given to 
+   parallel_for() */
+typedef void (*parallelTask_t)(const size_t i, void * ctx);
+
+/* Call fn(i, ctx) for i = 0 .. n - 1 on up to nThreads threads (0: one per 
+   CPU core), the calling thread included, and return when all calls have 
+   returned. The indices are taken in chunks of chunk from a shared 
+   counter, so that threads done early take over the remaining work. 
+   Calls with different i may run concurrently; fn must not throw. Runs in
+   the calling thread alone if threads cannot be started. */
+void parallel_for(const size_t n, parallelTask_t fn, void * ctx, 
+		  const unsigned int nThreads=0, const size_t chunk=1);
 
 /* lineFormat():
       Format a long string with multiple words into a line-broken string, 
@@ -138,3 +411,5 @@ bool check_number(NT n, std::string conds) {
 std::string lineFormat(const std::string inStr, 
 		       const int w, 
 		       const int lw);
+
+#endif